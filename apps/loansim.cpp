@@ -0,0 +1,766 @@
+// Command-line front end for the loansim library.
+
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/arena.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/instrument.hpp"
+#include "loansim/loan_store.hpp"
+#include "loansim/loan_tape.hpp"
+#include "loansim/monte_carlo.hpp"
+#include "loansim/parallel.hpp"
+#include "loansim/products.hpp"
+#include "loansim/rate_paths.hpp"
+#include "loansim/roll_rate.hpp"
+#include "loansim/scenario_grid.hpp"
+#include "loansim/schedule.hpp"
+#include "loansim/schedule_writer.hpp"
+#include "loansim/service.hpp"
+#include "loansim/shard.hpp"
+
+extern char** environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void usage() {
+  std::fputs(
+      "usage: loansim <command> [options]\n"
+      "\n"
+      "commands:\n"
+      "  convert <tape.csv> <tape.lsim>   convert a CSV tape to columnar binary\n"
+      "  info <tape>                      print loan count and balance totals\n"
+      "  store <tape.csv>                 load into the compact hot/cold store and print\n"
+      "                                   its footprint per column\n"
+      "  simulate <tape> [--paths N] [--seed S] [--threads T]\n"
+      "           [--precision float64|float32] [--sampler pseudo_random|sobol]\n"
+      "           [--replicates N] [--antithetic 0|1] [--control 0|1]\n"
+      "           [--checkpoint FILE] [--checkpoint-interval SECONDS] [rate options]\n"
+      "                                   run the Monte Carlo prepayment/default model;\n"
+      "                                   --checkpoint snapshots progress and resumes\n"
+      "                                   an interrupted run from it\n"
+      "  sharded <tape> --shards N [--by range|hash] [--dir D] [simulate options]\n"
+      "          [--cpr X] [--cdr X] [--severity X]\n"
+      "                                   split the tape, run one process per shard and\n"
+      "                                   merge their cash flows and Monte Carlo paths\n"
+      "  shard <tape> <dir> --shards N [--by range|hash]\n"
+      "                                   write shard tapes dir/shard-K.lsim\n"
+      "  run-shard <shard.lsim> <out.part> [simulate options]\n"
+      "                                   run one shard, writing its partial results\n"
+      "  merge <part>... [simulate options] [--cpr X] [--cdr X] [--severity X]\n"
+      "                                   merge shard results run with the same options\n"
+      "  cashflows <tape> [--cpr X] [--cdr X] [--severity X] [--threads T] [--index X]\n"
+      "            [rate options [--paths N] [--seed S] [--index-spread X]]\n"
+      "            [--day-count 30/360|act/360|act/365|act/act] [--roll RULE]\n"
+      "            [--holidays FILE]\n"
+      "                                   print per-period pool cash flows as CSV; with a\n"
+      "                                   rate model, ARM flows average over rate paths\n"
+      "  rollrates <tape> --matrices FILE [--severity X] [--threads T]\n"
+      "                                   print per-period cash flows and delinquency\n"
+      "                                   balances under cohort roll-rate matrices\n"
+      "  schedules <tape> <out.lsch> [--compress none|deflate] [--chunk N]\n"
+      "                                   stream full per-loan schedules to a binary file\n"
+      "  grid <tape> [--shocks BP,BP,..] [--speeds X,X,..] [--cdr X] [--severity X]\n"
+      "       [--price X] [--loans out.csv]\n"
+      "                                   evaluate a rate-shock x speed scenario grid;\n"
+      "                                   --loans writes per-loan yield/duration/WAL\n"
+      "  serve <tape> <socket> [--threads T] [--cpr X] [--market X]\n"
+      "                                   keep the pool resident and answer requests\n"
+      "  request <socket> <words...>      send one request to a running service, e.g.\n"
+      "                                   request /tmp/ls.sock grid shocks=-100,0,100\n"
+      "\n"
+      "  --report <file|->                write per-stage timings as JSON after the run\n"
+      "\n"
+      "rate options: --rate-model none|hull_white|cir [--rate-initial X]\n"
+      "              [--rate-reversion X] [--rate-long-run X] [--rate-vol X]\n"
+      "\n"
+      "CSV tapes need principal, annual_rate and term_months columns. A product\n"
+      "column (fixed, io, arm) selects the mixed-product engine; --index is the\n"
+      "annual ARM index rate. An origination_date column (YYYY-MM-DD, optional\n"
+      "day_count per loan) makes cashflows accrue interest on dated calendars;\n"
+      "--roll is unadjusted, following, modified_following or preceding.\n",
+      stderr);
+}
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// `--name value` pairs after the positional arguments.
+class Flags {
+ public:
+  Flags(const std::vector<std::string_view>& args, std::size_t first) {
+    for (std::size_t i = first; i < args.size(); i += 2) {
+      if (i + 1 >= args.size() || !args[i].starts_with("--")) {
+        throw std::invalid_argument("expected --flag value, got '" + std::string(args[i]) + "'");
+      }
+      pairs_.emplace_back(args[i].substr(2), args[i + 1]);
+    }
+  }
+
+  [[nodiscard]] unsigned long long get(std::string_view name,
+                                       unsigned long long fallback) const {
+    for (const auto& [key, value] : pairs_) {
+      if (key == name) return std::stoull(std::string(value));
+    }
+    return fallback;
+  }
+
+  [[nodiscard]] std::string_view get_text(std::string_view name,
+                                          std::string_view fallback) const {
+    for (const auto& [key, value] : pairs_) {
+      if (key == name) return value;
+    }
+    return fallback;
+  }
+
+  [[nodiscard]] double get_double(std::string_view name, double fallback) const {
+    for (const auto& [key, value] : pairs_) {
+      if (key == name) return std::stod(std::string(value));
+    }
+    return fallback;
+  }
+
+  /// Comma-separated numbers, e.g. `--speeds 0.5,1,2`.
+  [[nodiscard]] std::vector<double> get_list(std::string_view name,
+                                             std::vector<double> fallback) const {
+    for (const auto& [key, value] : pairs_) {
+      if (key != name) continue;
+      std::vector<double> out;
+      std::string_view rest = value;
+      while (!rest.empty()) {
+        const std::size_t cut = rest.find(',');
+        out.push_back(std::stod(std::string(rest.substr(0, cut))));
+        rest = cut == std::string_view::npos ? std::string_view{} : rest.substr(cut + 1);
+      }
+      return out;
+    }
+    return fallback;
+  }
+
+ private:
+  std::vector<std::pair<std::string_view, std::string_view>> pairs_;
+};
+
+int run_convert(const std::vector<std::string_view>& args) {
+  if (args.size() != 3) return usage(), 2;
+  const auto start = Clock::now();
+  const std::size_t loans = loansim::convert_csv_to_columnar(std::string(args[1]),
+                                                             std::string(args[2]));
+  std::printf("converted %zu loans in %.3f s\n", loans, seconds_since(start));
+  return 0;
+}
+
+int run_info(const std::vector<std::string_view>& args) {
+  if (args.size() != 2) return usage(), 2;
+  const auto start = Clock::now();
+  const loansim::LoanTape tape = loansim::LoanTape::open(std::string(args[1]));
+  const loansim::LoanColumns loans = tape.columns();
+  double balance = 0.0;
+  double weighted_rate = 0.0;
+  for (std::size_t i = 0; i < loans.size(); ++i) {
+    balance += loans.principal[i];
+    weighted_rate += loans.principal[i] * loans.annual_rate[i];
+  }
+  std::printf("format:   %s\n", tape.is_columnar() ? "columnar" : "csv");
+  std::printf("loans:    %zu\n", loans.size());
+  std::printf("balance:  %.2f\n", balance);
+  std::printf("wac:      %.6f\n", balance > 0.0 ? weighted_rate / balance : 0.0);
+  std::printf("load:     %.3f s\n", seconds_since(start));
+  return 0;
+}
+
+int run_store(const std::vector<std::string_view>& args) {
+  if (args.size() != 2) return usage(), 2;
+  const auto start = Clock::now();
+  const loansim::LoanStore store = loansim::LoanStore::read_csv(std::string(args[1]));
+  const double load = seconds_since(start);
+  const auto per_loan = [&](std::size_t bytes) {
+    return store.size() == 0 ? 0.0 : static_cast<double>(bytes) / static_cast<double>(store.size());
+  };
+  std::printf("loans:       %zu\n", store.size());
+  std::printf("hot:         %zu bytes (%.2f per loan; balances %s, %zu distinct rates)\n",
+              store.hot_bytes(), per_loan(store.hot_bytes()),
+              store.balances_in_cents() ? "in cents" : "raw", store.rate_dictionary_size());
+  std::printf("cold:        %zu bytes (%.2f per loan)\n", store.cold_bytes(),
+              per_loan(store.cold_bytes()));
+  static constexpr const char* kKinds[] = {"number", "category", "text"};
+  for (const loansim::ColdColumn& c : store.cold()) {
+    std::printf("  %-20s %-8s %zu B/row", c.name().c_str(), kKinds[static_cast<int>(c.kind())],
+                c.width());
+    if (c.kind() == loansim::ColdColumn::Kind::category) {
+      std::printf(", %zu values", c.categories().size());
+    }
+    std::printf(", %zu bytes\n", c.bytes());
+  }
+  std::printf("load:        %.3f s\n", load);
+  return 0;
+}
+
+loansim::ShortRateModel short_rate_model(const Flags& flags) {
+  loansim::ShortRateModel model;
+  model.kind = loansim::parse_rate_model(flags.get_text("rate-model", "none"));
+  model.initial = flags.get_double("rate-initial", model.initial);
+  model.mean_reversion = flags.get_double("rate-reversion", model.mean_reversion);
+  model.long_run = flags.get_double("rate-long-run", model.long_run);
+  model.volatility = flags.get_double("rate-vol", model.volatility);
+  return model;
+}
+
+loansim::MonteCarloConfig monte_carlo_config(const Flags& flags) {
+  loansim::MonteCarloConfig config;
+  config.paths = flags.get("paths", config.paths);
+  config.seed = flags.get("seed", config.seed);
+  config.threads = static_cast<unsigned>(flags.get("threads", config.threads));
+  config.precision = loansim::parse_precision(flags.get_text("precision", "float64"));
+  config.sampler = loansim::parse_sampler(flags.get_text("sampler", "pseudo_random"));
+  config.sobol_replicates = flags.get("replicates", config.sobol_replicates);
+  config.antithetic = flags.get("antithetic", 0) != 0;
+  config.control_variate = flags.get("control", 0) != 0;
+  config.checkpoint_path = flags.get_text("checkpoint", "");
+  config.checkpoint_interval =
+      flags.get_double("checkpoint-interval", config.checkpoint_interval);
+  config.rates = short_rate_model(flags);
+  return config;
+}
+
+void print_monte_carlo(const loansim::MonteCarloResult& r,
+                       const loansim::MonteCarloConfig& config) {
+  std::printf("paths:       %zu (%s, %s)\n", r.paths, loansim::to_string(config.precision),
+              loansim::to_string(config.sampler));
+  std::printf("samples:     %llu\n",
+              static_cast<unsigned long long>(r.present_value_estimate.samples));
+  // "plain se" is what independent paths would give for the same count.
+  std::printf("pv:          %.2f (se %.2f, plain se %.2f)\n", r.present_value_estimate.mean,
+              r.present_value_estimate.std_error, r.present_value.std_error());
+  std::printf("total loss:  %.2f (se %.2f, plain se %.2f)\n", r.total_loss_estimate.mean,
+              r.total_loss_estimate.std_error, r.total_loss.std_error());
+}
+
+int run_simulate(const std::vector<std::string_view>& args) {
+  if (args.size() < 2) return usage(), 2;
+  const Flags flags(args, 2);
+  const loansim::MonteCarloConfig config = monte_carlo_config(flags);
+
+  const auto start = Clock::now();
+  const loansim::LoanTape tape = loansim::LoanTape::open(std::string(args[1]));
+  const double load = seconds_since(start);
+  const auto sim_start = Clock::now();
+  loansim::RunArenas arenas;
+  const loansim::MonteCarloResult r = loansim::simulate_pool(tape.columns(), config, &arenas);
+  const double sim = seconds_since(sim_start);
+
+  const loansim::StageScope output(loansim::Stage::output, tape.size());
+  std::printf("loans:       %zu\n", tape.size());
+  print_monte_carlo(r, config);
+  std::printf("load:        %.3f s\n", load);
+  std::printf("simulate:    %.3f s (%.0f paths/s)\n", sim, static_cast<double>(r.paths) / sim);
+  return 0;
+}
+
+loansim::CashFlowAssumptions cash_flow_assumptions(const Flags& flags) {
+  loansim::CashFlowAssumptions assumptions;
+  assumptions.cpr = flags.get_double("cpr", assumptions.cpr);
+  assumptions.cdr = flags.get_double("cdr", assumptions.cdr);
+  assumptions.severity = flags.get_double("severity", assumptions.severity);
+  return assumptions;
+}
+
+std::string shard_tape_path(std::string_view dir, std::size_t shard) {
+  return std::string(dir) + "/shard-" + std::to_string(shard) + ".lsim";
+}
+
+/// Writes the shard tapes of `tape` into `dir`; returns their paths.
+std::vector<std::string> write_shards(std::string_view tape, std::string_view dir,
+                                      const Flags& flags) {
+  const std::size_t shards = flags.get("shards", 0);
+  const loansim::ShardKey key = loansim::parse_shard_key(flags.get_text("by", "range"));
+  const loansim::LoanTape source = loansim::LoanTape::open(std::string(tape));
+  const std::vector<loansim::LoanPool> pools =
+      loansim::partition_pool(source.columns(), shards, key);
+  std::vector<std::string> paths;
+  for (std::size_t s = 0; s < pools.size(); ++s) {
+    paths.push_back(shard_tape_path(dir, s));
+    loansim::write_columnar_tape(pools[s].columns(), paths.back());
+  }
+  return paths;
+}
+
+void print_merged(const loansim::MergedResult& merged, const loansim::MonteCarloConfig& config) {
+  double interest = 0.0, principal = 0.0, loss = 0.0;
+  const loansim::PoolCashFlows& f = merged.cash_flows;
+  for (std::size_t t = 0; t < f.periods(); ++t) {
+    interest += f.interest[t];
+    principal += f.scheduled_principal[t] + f.prepayment[t];
+    loss += f.loss[t];
+  }
+  std::printf("loans:       %llu\n", static_cast<unsigned long long>(merged.loans));
+  std::printf("cash flows:  interest %.2f, principal %.2f, loss %.2f\n", interest, principal,
+              loss);
+  print_monte_carlo(merged.monte_carlo, config);
+}
+
+int run_shard_tapes(const std::vector<std::string_view>& args) {
+  if (args.size() < 3) return usage(), 2;
+  const Flags flags(args, 3);
+  const std::vector<std::string> paths = write_shards(args[1], args[2], flags);
+  for (const std::string& p : paths) {
+    std::printf("%s: %zu loans\n", p.c_str(), loansim::LoanTape::open(p).size());
+  }
+  return 0;
+}
+
+int run_run_shard(const std::vector<std::string_view>& args) {
+  if (args.size() < 3) return usage(), 2;
+  const Flags flags(args, 3);
+  const loansim::MonteCarloConfig config = monte_carlo_config(flags);
+  const loansim::LoanTape tape = loansim::LoanTape::open(std::string(args[1]));
+  loansim::RunArenas arenas;
+  const loansim::ShardResult result = loansim::run_shard(tape.columns(), config, &arenas);
+  loansim::write_shard_result(result, std::string(args[2]));
+  return 0;
+}
+
+int run_merge(const std::vector<std::string_view>& args) {
+  std::size_t first_flag = 1;
+  while (first_flag < args.size() && !args[first_flag].starts_with("--")) ++first_flag;
+  if (first_flag == 1) return usage(), 2;
+  const Flags flags(args, first_flag);
+  std::vector<loansim::ShardResult> shards;
+  for (std::size_t i = 1; i < first_flag; ++i) {
+    shards.push_back(loansim::read_shard_result(std::string(args[i])));
+  }
+  const loansim::MonteCarloConfig config = monte_carlo_config(flags);
+  print_merged(loansim::merge_shards(shards, cash_flow_assumptions(flags), config), config);
+  return 0;
+}
+
+/// Splits the tape, runs `run-shard` in one child process per shard (this
+/// executable, re-run through /proc/self/exe) and merges the results.
+int run_sharded(const std::vector<std::string_view>& args) {
+  if (args.size() < 2) return usage(), 2;
+  const Flags flags(args, 2);
+  const std::size_t shards = flags.get("shards", 0);
+  const std::string dir(flags.get_text("dir", "."));
+  const auto start = Clock::now();
+  const std::vector<std::string> tapes = write_shards(args[1], dir, flags);
+
+  // Children get the parent's options, minus the sharding ones, and an
+  // even share of the cores unless --threads was given.
+  std::vector<std::string> options;
+  for (std::size_t i = 2; i + 1 < args.size(); i += 2) {
+    const std::string_view key = args[i].substr(2);
+    if (key == "shards" || key == "by" || key == "dir" || key == "cpr" || key == "cdr" ||
+        key == "severity") {
+      continue;
+    }
+    options.emplace_back(args[i]);
+    options.emplace_back(args[i + 1]);
+  }
+  if (flags.get("threads", 0) == 0) {
+    options.emplace_back("--threads");
+    options.push_back(std::to_string(std::max<std::size_t>(
+        1, loansim::default_thread_count() / std::max<std::size_t>(shards, 1))));
+  }
+
+  std::vector<std::string> parts;
+  std::vector<pid_t> children;
+  for (std::size_t s = 0; s < tapes.size(); ++s) {
+    parts.push_back(dir + "/shard-" + std::to_string(s) + ".part");
+    std::vector<std::string> words = {"loansim", "run-shard", tapes[s], parts.back()};
+    words.insert(words.end(), options.begin(), options.end());
+    std::vector<char*> argv;
+    for (std::string& w : words) argv.push_back(w.data());
+    argv.push_back(nullptr);
+    pid_t pid = 0;
+    const int error = posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, argv.data(), environ);
+    if (error != 0) {
+      throw std::system_error(error, std::generic_category(), "cannot start shard process");
+    }
+    children.push_back(pid);
+  }
+  int failed = 0;
+  for (const pid_t pid : children) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ++failed;
+  }
+  if (failed != 0) {
+    std::fprintf(stderr, "loansim: %d of %zu shard processes failed\n", failed, children.size());
+    return 1;
+  }
+
+  std::vector<loansim::ShardResult> results;
+  for (const std::string& p : parts) results.push_back(loansim::read_shard_result(p));
+  const loansim::MonteCarloConfig config = monte_carlo_config(flags);
+  print_merged(loansim::merge_shards(results, cash_flow_assumptions(flags), config), config);
+  std::printf("shards:      %zu processes (%s), %.3f s\n", children.size(),
+              std::string(flags.get_text("by", "range")).c_str(), seconds_since(start));
+  return 0;
+}
+
+/// Accrual tables for a CSV tape with an `origination_date` column and an
+/// optional per-loan `day_count`; `table` receives each loan's table id.
+loansim::AccrualTables accrual_tables(const std::string& path, const loansim::LoanColumns& loans,
+                                      const Flags& flags, std::vector<std::uint32_t>& table) {
+  const std::string holidays(flags.get_text("holidays", ""));
+  loansim::AccrualTables tables(
+      loansim::max_term(loans),
+      holidays.empty() ? loansim::BusinessCalendar() : loansim::BusinessCalendar::read(holidays));
+  loansim::AccrualConvention fallback;
+  fallback.day_count = loansim::parse_day_count(flags.get_text("day-count", "30/360"));
+  fallback.roll = loansim::parse_business_day_rule(flags.get_text("roll", "unadjusted"));
+
+  const loansim::CsvTapeReader reader(path);
+  const std::vector<std::string> names = reader.column_names();
+  const auto index = [&](std::string_view name) {
+    const auto it = std::find(names.begin(), names.end(), name);
+    return static_cast<std::size_t>(it - names.begin());
+  };
+  const std::size_t date_index = index("origination_date");
+  const std::size_t day_count_index = index("day_count");
+  table.reserve(loans.size());
+  reader.for_each_row([&](std::size_t, std::span<const std::string_view> fields) {
+    loansim::AccrualConvention convention = fallback;
+    if (day_count_index < fields.size() && !fields[day_count_index].empty()) {
+      convention.day_count = loansim::parse_day_count(fields[day_count_index]);
+    }
+    const std::string_view date =
+        date_index < fields.size() ? fields[date_index] : std::string_view{};
+    table.push_back(tables.intern(loansim::parse_date(date), convention));
+  });
+  return tables;
+}
+
+int run_cashflows(const std::vector<std::string_view>& args) {
+  if (args.size() < 2) return usage(), 2;
+  const Flags flags(args, 2);
+  const loansim::CashFlowAssumptions assumptions = cash_flow_assumptions(flags);
+  const auto threads = static_cast<unsigned>(flags.get("threads", 0));
+
+  const std::string path(args[1]);
+  loansim::RunArenas arenas;
+  loansim::PoolCashFlows flows;
+  std::size_t loans = 0;
+  if (!loansim::ColumnarTape::is_columnar(path) &&
+      loansim::CsvTapeReader(path).has_column("product")) {
+    // Mixed-product tape: ARMs reset against a flat index, or against each
+    // simulated rate path in turn.
+    const loansim::ProductBook book = loansim::CsvTapeReader(path).read_products();
+    const loansim::ShortRateModel model = short_rate_model(flags);
+    if (model.enabled()) {
+      const std::size_t periods =
+          std::max<std::size_t>(1, loansim::max_term(book.arm().loans.columns()));
+      const loansim::RatePaths rates(model, flags.get("seed", 1), flags.get("paths", 256),
+                                     periods, threads);
+      flows = loansim::aggregate_book_paths(book, assumptions, rates,
+                                            flags.get_double("index-spread", 0.0), threads,
+                                            &arenas);
+    } else {
+      const double index[] = {flags.get_double("index", 0.04)};
+      flows = loansim::aggregate_book(book, assumptions, index, threads, &arenas);
+    }
+    loans = book.size();
+  } else {
+    const loansim::LoanTape tape = loansim::LoanTape::open(path);
+    if (!tape.is_columnar() && loansim::CsvTapeReader(path).has_column("origination_date")) {
+      // Dated tape: interest accrues by day count from each origination.
+      std::vector<std::uint32_t> table;
+      const loansim::AccrualTables tables = accrual_tables(path, tape.columns(), flags, table);
+      const loansim::LoanAccrual accrual{&tables, table};
+      flows = loansim::aggregate_pool(tape.columns(), accrual, assumptions, threads, &arenas);
+    } else {
+      flows = loansim::aggregate_pool(tape.columns(), assumptions, threads, &arenas);
+    }
+    loans = tape.size();
+  }
+  const loansim::StageScope output(loansim::Stage::output, loans);
+  std::printf("period,interest,scheduled_principal,prepayment,defaults,loss,balance\n");
+  for (std::size_t t = 0; t < flows.periods(); ++t) {
+    std::printf("%zu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", t + 1, flows.interest[t],
+                flows.scheduled_principal[t], flows.prepayment[t], flows.defaults[t],
+                flows.loss[t], flows.balance[t]);
+  }
+  return 0;
+}
+
+int run_rollrates(const std::vector<std::string_view>& args) {
+  if (args.size() < 2) return usage(), 2;
+  const Flags flags(args, 2);
+  loansim::RollRateConfig config;
+  config.matrices = loansim::read_transition_matrices(std::string(flags.get_text("matrices", "")));
+  config.severity = flags.get_double("severity", config.severity);
+  config.threads = static_cast<unsigned>(flags.get("threads", 0));
+
+  // CSV tapes may carry `cohort` (an index into the matrices) and
+  // `dq_status` (a live state) per loan; otherwise every loan is a current
+  // member of cohort 0.
+  const std::string path(args[1]);
+  const loansim::LoanTape tape = loansim::LoanTape::open(path);
+  std::vector<std::uint32_t> cohorts;
+  std::vector<loansim::DelinquencyState> initial;
+  if (!tape.is_columnar()) {
+    const loansim::CsvTapeReader reader(path);
+    const std::vector<std::string> names = reader.column_names();
+    const auto index = [&](std::string_view name) {
+      const auto it = std::find(names.begin(), names.end(), name);
+      return it == names.end() ? names.size() : static_cast<std::size_t>(it - names.begin());
+    };
+    const std::size_t cohort_index = index("cohort");
+    const std::size_t state_index = index("dq_status");
+    if (cohort_index < names.size() || state_index < names.size()) {
+      reader.for_each_row([&](std::size_t, std::span<const std::string_view> fields) {
+        if (cohort_index < names.size()) {
+          cohorts.push_back(static_cast<std::uint32_t>(std::stoul(std::string(
+              cohort_index < fields.size() ? fields[cohort_index] : std::string_view("0")))));
+        }
+        if (state_index < names.size()) {
+          const std::string_view field =
+              state_index < fields.size() ? fields[state_index] : std::string_view{};
+          initial.push_back(field.empty() ? loansim::DelinquencyState::current
+                                          : loansim::parse_delinquency_state(field));
+        }
+      });
+    }
+  }
+  loansim::RunArenas arenas;
+  const loansim::RollRateResult r =
+      loansim::run_roll_rates(tape.columns(), cohorts, initial, config, &arenas);
+
+  const loansim::StageScope output(loansim::Stage::output, tape.size());
+  const loansim::PoolCashFlows& f = r.flows;
+  std::printf("period,interest,scheduled_principal,prepayment,defaults,loss,balance,"
+              "current,dpd30,dpd60,dpd90\n");
+  for (std::size_t t = 0; t < f.periods(); ++t) {
+    std::printf("%zu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", t + 1, f.interest[t],
+                f.scheduled_principal[t], f.prepayment[t], f.defaults[t], f.loss[t],
+                f.balance[t], r.state_balance[0][t], r.state_balance[1][t],
+                r.state_balance[2][t], r.state_balance[3][t]);
+  }
+  return 0;
+}
+
+int run_schedules(const std::vector<std::string_view>& args) {
+  if (args.size() < 3) return usage(), 2;
+  const Flags flags(args, 3);
+  loansim::ScheduleWriterOptions options;
+  options.chunk_loans = flags.get("chunk", options.chunk_loans);
+  const std::string_view compress = flags.get_text("compress", "none");
+  if (compress == "deflate") {
+    options.compression = loansim::ScheduleCompression::delta_deflate;
+  } else if (compress != "none") {
+    throw std::invalid_argument("--compress must be none or deflate");
+  }
+
+  const auto start = Clock::now();
+  const loansim::LoanTape tape = loansim::LoanTape::open(std::string(args[1]));
+  const loansim::ScheduleWriteStats stats =
+      loansim::write_schedules(tape.columns(), std::string(args[2]), options);
+  const double elapsed = seconds_since(start);
+  std::printf("loans:       %zu in %zu chunks\n", stats.loans, stats.chunks);
+  std::printf("compression: %s\n", loansim::to_string(options.compression));
+  std::printf("raw:         %.1f MB\n", static_cast<double>(stats.raw_bytes) / 1e6);
+  std::printf("stored:      %.1f MB (%.2fx)\n", static_cast<double>(stats.stored_bytes) / 1e6,
+              static_cast<double>(stats.raw_bytes) / static_cast<double>(stats.stored_bytes));
+  std::printf("elapsed:     %.3f s (%.0f MB/s raw)\n", elapsed,
+              static_cast<double>(stats.raw_bytes) / 1e6 / elapsed);
+  return 0;
+}
+
+int run_grid(const std::vector<std::string_view>& args) {
+  if (args.size() < 2) return usage(), 2;
+  const Flags flags(args, 2);
+  std::vector<double> shocks = flags.get_list("shocks", {-100.0, 0.0, 100.0});
+  for (double& bp : shocks) bp *= 1e-4;
+  const std::vector<double> speeds = flags.get_list("speeds", {0.5, 1.0, 2.0});
+  const std::vector<loansim::Scenario> grid = loansim::make_scenario_grid(
+      shocks, speeds, flags.get_double("cdr", 0.0), flags.get_double("severity", 0.0));
+  loansim::ScenarioGridConfig config;
+  config.threads = static_cast<unsigned>(flags.get("threads", 0));
+  config.price = flags.get_double("price", 1.0);
+  const std::string_view loans_path = flags.get_text("loans", "");
+  config.loan_analytics = !loans_path.empty();
+
+  const auto start = Clock::now();
+  const loansim::LoanTape tape = loansim::LoanTape::open(std::string(args[1]));
+  const loansim::PreparedPool pool(tape.columns());
+  const double prepare = seconds_since(start);
+  const auto run_start = Clock::now();
+  loansim::RunArenas arenas;
+  const std::vector<loansim::ScenarioResult> results = pool.run(grid, config, &arenas);
+  const double run = seconds_since(run_start);
+
+  const loansim::StageScope output(loansim::Stage::output, pool.size());
+
+  std::printf("%-28s %20s %20s %18s %8s %8s %8s\n", "scenario", "pv", "prepaid", "loss",
+              "yield", "mod_dur", "wal");
+  for (const loansim::ScenarioResult& r : results) {
+    double prepaid = 0.0;
+    double loss = 0.0;
+    for (std::size_t t = 0; t < r.flows.periods(); ++t) {
+      prepaid += r.flows.prepayment[t];
+      loss += r.flows.loss[t];
+    }
+    std::printf("%-28s %20.2f %20.2f %18.2f %7.3f%% %8.3f %8.3f\n", r.scenario.name.c_str(),
+                r.present_value, prepaid, loss, 100.0 * r.analytics.yield,
+                r.analytics.modified_duration, r.analytics.wal);
+  }
+  if (config.loan_analytics) {
+    std::FILE* out = std::fopen(std::string(loans_path).c_str(), "w");
+    if (out == nullptr) throw std::runtime_error("cannot create " + std::string(loans_path));
+    std::fputs("scenario,loan,yield,macaulay_duration,modified_duration,convexity,wal\n", out);
+    for (const loansim::ScenarioResult& r : results) {
+      const loansim::LoanAnalytics& a = r.loan_analytics;
+      for (std::size_t i = 0; i < a.size(); ++i) {
+        std::fprintf(out, "%s,%zu,%.8f,%.6f,%.6f,%.4f,%.6f\n", r.scenario.name.c_str(), i,
+                     a.yield[i], a.macaulay_duration[i], a.modified_duration[i],
+                     a.convexity[i], a.wal[i]);
+      }
+    }
+    if (std::fclose(out) != 0) throw std::runtime_error("error writing " + std::string(loans_path));
+  }
+  std::printf("load+prepare: %.3f s, %zu scenarios: %.3f s\n", prepare, results.size(), run);
+  return 0;
+}
+
+int run_serve(const std::vector<std::string_view>& args) {
+  if (args.size() < 3) return usage(), 2;
+  const Flags flags(args, 3);
+  loansim::ServiceConfig config;
+  config.socket_path = std::string(args[2]);
+  config.threads_per_request = static_cast<unsigned>(flags.get("threads", 0));
+  config.grid.base_cpr = flags.get_double("cpr", config.grid.base_cpr);
+  config.grid.market_rate = flags.get_double("market", config.grid.market_rate);
+  config.on_request = [](const loansim::RequestRecord& r) {
+    std::fprintf(stderr, "%-8s %s %4zu scenarios %10.3f ms\n", r.command.c_str(),
+                 r.ok ? "ok   " : "error", r.scenarios, r.latency_seconds * 1e3);
+  };
+
+  // SIGINT/SIGTERM are taken by a watcher thread, which stops the service
+  // cleanly; every other thread inherits the blocked mask.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  const auto start = Clock::now();
+  std::optional<loansim::SimulationService> service;
+  {
+    const loansim::LoanTape tape = loansim::LoanTape::open(std::string(args[1]));
+    service.emplace(tape.columns(), std::move(config));
+  }
+  std::fprintf(stderr, "serving %zu loans on %s (loaded in %.3f s)\n", service->pool().size(),
+               std::string(args[2]).c_str(), seconds_since(start));
+
+  std::thread watcher([&] {
+    int signal = 0;
+    sigwait(&signals, &signal);
+    service->stop();
+  });
+  try {
+    service->serve();
+  } catch (...) {
+    pthread_kill(watcher.native_handle(), SIGTERM);
+    watcher.join();
+    throw;
+  }
+  pthread_kill(watcher.native_handle(), SIGTERM);  // no-op stop if a signal came first
+  watcher.join();
+
+  const loansim::ServiceStats stats = service->stats();
+  std::fprintf(stderr, "served %llu requests (%llu failed), mean %.3f ms, max %.3f ms\n",
+               static_cast<unsigned long long>(stats.requests),
+               static_cast<unsigned long long>(stats.failed), stats.latency.mean * 1e3,
+               stats.max_latency * 1e3);
+  return 0;
+}
+
+int run_request(const std::vector<std::string_view>& args) {
+  if (args.size() < 3) return usage(), 2;
+  std::string request;
+  for (std::size_t i = 2; i < args.size(); ++i) {
+    if (!request.empty()) request += ' ';
+    request += args[i];
+  }
+  const std::string reply = loansim::service_request(std::string(args[1]), request);
+  std::fputs(reply.c_str(), stdout);
+  const std::size_t last = reply.rfind('\n', reply.size() - 2);
+  return reply.compare(last == std::string::npos ? 0 : last + 1, 2, "ok") == 0 ? 0 : 1;
+}
+
+int run_command(const std::vector<std::string_view>& args) {
+  if (args[0] == "convert") return run_convert(args);
+  if (args[0] == "info") return run_info(args);
+  if (args[0] == "store") return run_store(args);
+  if (args[0] == "simulate") return run_simulate(args);
+  if (args[0] == "sharded") return run_sharded(args);
+  if (args[0] == "shard") return run_shard_tapes(args);
+  if (args[0] == "run-shard") return run_run_shard(args);
+  if (args[0] == "merge") return run_merge(args);
+  if (args[0] == "cashflows") return run_cashflows(args);
+  if (args[0] == "rollrates") return run_rollrates(args);
+  if (args[0] == "schedules") return run_schedules(args);
+  if (args[0] == "grid") return run_grid(args);
+  if (args[0] == "serve") return run_serve(args);
+  if (args[0] == "request") return run_request(args);
+  usage();
+  return 2;
+}
+
+void write_report(std::string_view path) {
+  const std::string json = loansim::stage_report_json() + "\n";
+  if (path == "-") {
+    std::fputs(json.c_str(), stdout);
+    return;
+  }
+  std::FILE* out = std::fopen(std::string(path).c_str(), "w");
+  if (out == nullptr) throw std::runtime_error("cannot create " + std::string(path));
+  std::fputs(json.c_str(), out);
+  if (std::fclose(out) != 0) throw std::runtime_error("error writing " + std::string(path));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string_view> args(argv + 1, argv + argc);
+  // `--report` applies to every command, so it is taken out before dispatch.
+  std::string_view report;
+  for (std::size_t i = 0; i + 1 < args.size(); ++i) {
+    if (args[i] == "--report") {
+      report = args[i + 1];
+      args.erase(args.begin() + static_cast<std::ptrdiff_t>(i),
+                 args.begin() + static_cast<std::ptrdiff_t>(i + 2));
+      break;
+    }
+  }
+  if (args.empty()) return usage(), 2;
+  try {
+    const int status = run_command(args);
+    if (status == 0 && !report.empty()) write_report(report);
+    return status;
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "loansim: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,75 @@
+// Loan-tape ingest throughput: CSV parse and columnar open, in bytes/s.
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+
+#include "loansim/loan_tape.hpp"
+#include "loansim/synthetic.hpp"
+
+namespace {
+
+/// Synthetic tapes written once per process to the temp directory.
+struct Tapes {
+  std::string csv;
+  std::string columnar;
+
+  Tapes() {
+    const auto dir = std::filesystem::temp_directory_path();
+    csv = (dir / "loansim_bench_tape.csv").string();
+    columnar = (dir / "loansim_bench_tape.lsim").string();
+    const loansim::LoanPool pool = loansim::make_synthetic_pool(1 << 20, 3);
+    loansim::write_csv_tape(pool.columns(), csv);
+    loansim::convert_csv_to_columnar(csv, columnar);
+  }
+  ~Tapes() {
+    std::filesystem::remove(csv);
+    std::filesystem::remove(columnar);
+  }
+};
+
+const Tapes& tapes() {
+  static const Tapes t;
+  return t;
+}
+
+void BM_CsvIngest(benchmark::State& state) {
+  const std::string& path = tapes().csv;
+  const auto bytes = static_cast<std::int64_t>(std::filesystem::file_size(path));
+  for (auto _ : state) {
+    const loansim::CsvTapeReader reader(path);
+    double sum = 0.0;
+    reader.for_each_chunk([&](const loansim::LoanColumns& chunk) {
+      for (const double p : chunk.principal) sum += p;
+    });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_CsvIngest)->Unit(benchmark::kMillisecond);
+
+void BM_CsvToColumnar(benchmark::State& state) {
+  const std::string& path = tapes().csv;
+  const std::string out = path + ".convert";
+  const auto bytes = static_cast<std::int64_t>(std::filesystem::file_size(path));
+  for (auto _ : state) benchmark::DoNotOptimize(loansim::convert_csv_to_columnar(path, out));
+  state.SetBytesProcessed(state.iterations() * bytes);
+  std::filesystem::remove(out);
+}
+BENCHMARK(BM_CsvToColumnar)->Unit(benchmark::kMillisecond);
+
+void BM_ColumnarScan(benchmark::State& state) {
+  const std::string& path = tapes().columnar;
+  const auto bytes = static_cast<std::int64_t>(std::filesystem::file_size(path));
+  for (auto _ : state) {
+    const loansim::ColumnarTape tape = loansim::ColumnarTape::open(path);
+    double sum = 0.0;
+    for (const double p : tape.columns().principal) sum += p;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_ColumnarScan)->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,185 @@
+// Payment kernel, schedule and aggregation throughput on synthetic pools.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/loan_store.hpp"
+#include "loansim/payment_kernel.hpp"
+#include "loansim/roll_rate.hpp"
+#include "loansim/scenario_grid.hpp"
+#include "loansim/schedule.hpp"
+#include "loansim/synthetic.hpp"
+
+namespace {
+
+constexpr std::uint64_t kSeed = 20240601;
+
+void BM_LevelPayments(benchmark::State& state) {
+  const auto level = static_cast<loansim::SimdLevel>(state.range(0));
+  const auto previous = loansim::simd_level();
+  try {
+    loansim::set_simd_level(level);
+  } catch (const std::invalid_argument&) {
+    state.SkipWithError("SIMD tier not supported on this CPU");
+    return;
+  }
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(1 << 16, kSeed);
+  std::vector<double> payment(pool.size());
+  for (auto _ : state) {
+    loansim::level_payments(pool.columns(), payment);
+    benchmark::DoNotOptimize(payment.data());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * pool.size()));
+  state.SetLabel(loansim::to_string(level));
+  loansim::set_simd_level(previous);
+}
+BENCHMARK(BM_LevelPayments)
+    ->Arg(static_cast<int>(loansim::SimdLevel::scalar))
+    ->Arg(static_cast<int>(loansim::SimdLevel::avx2))
+    ->Arg(static_cast<int>(loansim::SimdLevel::avx512));
+
+void BM_BuildSchedules(benchmark::State& state) {
+  const loansim::LoanPool pool =
+      loansim::make_synthetic_pool(static_cast<std::size_t>(state.range(0)), kSeed);
+  loansim::RunArenas arenas;
+  for (auto _ : state) {
+    loansim::ScheduleBuffers schedules(&arenas.shared());
+    loansim::build_schedules(pool.columns(), schedules, &arenas);
+    benchmark::DoNotOptimize(schedules.balance_column().data());
+    arenas.reset();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * pool.size()));
+}
+BENCHMARK(BM_BuildSchedules)->Arg(1 << 10)->Arg(1 << 14);
+
+void BM_AggregatePool(benchmark::State& state) {
+  const loansim::LoanPool pool =
+      loansim::make_synthetic_pool(static_cast<std::size_t>(state.range(0)), kSeed);
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::aggregate_pool(pool.columns(), assumptions));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * pool.size()));
+}
+BENCHMARK(BM_AggregatePool)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// The synthetic pool, seasoned and interleaved, with the term kernels on
+// (argument 1) or every period comparing terms (0).
+void BM_TermKernels(benchmark::State& state) {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(1 << 16, kSeed);
+  const bool specialized = state.range(0) != 0;
+  const bool previous = loansim::term_kernels();
+  loansim::set_term_kernels(specialized);
+  for (auto _ : state) {
+    loansim::ScheduledTotals totals;
+    loansim::accumulate_scheduled(pool.columns(), totals);
+    benchmark::DoNotOptimize(totals.closing_balance.data());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * pool.size()));
+  state.SetLabel(specialized ? "specialized" : "generic");
+  loansim::set_term_kernels(previous);
+}
+BENCHMARK(BM_TermKernels)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Dated accrual: loans spread over 240 monthly origination dates, half
+// Actual/360 and half Actual/Actual with modified-following rolls. Tables
+// are built once outside the loop, as a run would.
+void BM_AggregateDated(benchmark::State& state) {
+  const loansim::LoanPool pool =
+      loansim::make_synthetic_pool(static_cast<std::size_t>(state.range(0)), kSeed);
+  loansim::AccrualTables tables(loansim::max_term(pool.columns()));
+  std::vector<std::uint32_t> table(pool.size());
+  const loansim::Date first = loansim::parse_date("2005-01-01");
+  for (std::size_t i = 0; i < pool.size(); ++i) {
+    const loansim::AccrualConvention convention{
+        i % 2 == 0 ? loansim::DayCount::actual_360 : loansim::DayCount::actual_actual,
+        loansim::BusinessDayRule::modified_following};
+    table[i] = tables.intern(loansim::add_months(first, static_cast<int>(i % 240)), convention);
+  }
+  const loansim::LoanAccrual accrual{&tables, table};
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::aggregate_pool(pool.columns(), accrual, assumptions));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * pool.size()));
+  state.counters["tables"] = static_cast<double>(tables.size());
+}
+BENCHMARK(BM_AggregateDated)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// Roll rates over 64 cohorts, loans spread across cohorts and starting states.
+void BM_RollRates(benchmark::State& state) {
+  const loansim::LoanPool pool =
+      loansim::make_synthetic_pool(static_cast<std::size_t>(state.range(0)), kSeed);
+  constexpr std::uint32_t kCohorts = 64;
+  loansim::RollRateConfig config;
+  for (std::uint32_t c = 0; c < kCohorts; ++c) {
+    const double prepay = 0.005 + 0.0002 * c;
+    loansim::TransitionMatrix m;
+    m.rows[0] = {0.98 - prepay, 0.02, 0.0, 0.0, 0.0, prepay};
+    m.rows[1] = {0.45, 0.20, 0.35, 0.0, 0.0, 0.0};
+    m.rows[2] = {0.20, 0.10, 0.20, 0.50, 0.0, 0.0};
+    m.rows[3] = {0.05, 0.0, 0.05, 0.60, 0.30, 0.0};
+    config.matrices.push_back(m);
+  }
+  std::vector<std::uint32_t> cohorts(pool.size());
+  std::vector<loansim::DelinquencyState> initial(pool.size());
+  for (std::size_t i = 0; i < pool.size(); ++i) {
+    cohorts[i] = static_cast<std::uint32_t>(i % kCohorts);
+    initial[i] = static_cast<loansim::DelinquencyState>(i / kCohorts % loansim::kLiveStates);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::run_roll_rates(pool.columns(), cohorts, initial, config));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * pool.size()));
+}
+BENCHMARK(BM_RollRates)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// The same reduction over the compact store, decoding each chunk on the fly.
+void BM_AggregateStore(benchmark::State& state) {
+  const loansim::LoanStore store = loansim::LoanStore::from_columns(
+      loansim::make_synthetic_pool(static_cast<std::size_t>(state.range(0)), kSeed).columns());
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::aggregate_store(store, assumptions));
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * store.size()));
+  state.counters["hot_bytes/loan"] =
+      static_cast<double>(store.hot_bytes()) / static_cast<double>(store.size());
+}
+BENCHMARK(BM_AggregateStore)->Arg(1 << 16)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+void BM_ScenarioGrid(benchmark::State& state) {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(1 << 15, kSeed);
+  const loansim::PreparedPool prepared(pool.columns());
+  const std::vector<double> shocks = {-0.02, -0.01, 0.0, 0.01, 0.02};
+  const std::vector<double> speeds = {0.5, 1.0, 1.5, 2.0};
+  const auto grid = loansim::make_scenario_grid(shocks, speeds, 0.01, 0.35);
+  loansim::ScenarioGridConfig config;
+  config.scenario_batch = static_cast<std::size_t>(state.range(0));
+  for (auto _ : state) benchmark::DoNotOptimize(prepared.run(grid, config));
+  state.SetItemsProcessed(
+      static_cast<std::int64_t>(state.iterations() * pool.size() * grid.size()));
+}
+BENCHMARK(BM_ScenarioGrid)->Arg(1)->Arg(4)->Arg(8)->Arg(20)->Unit(benchmark::kMillisecond);
+
+// The same grid with per-loan yield, duration, convexity and WAL computed
+// in the pass; compare against BM_ScenarioGrid/8.
+void BM_ScenarioGridAnalytics(benchmark::State& state) {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(1 << 15, kSeed);
+  const loansim::PreparedPool prepared(pool.columns());
+  const std::vector<double> shocks = {-0.02, -0.01, 0.0, 0.01, 0.02};
+  const std::vector<double> speeds = {0.5, 1.0, 1.5, 2.0};
+  const auto grid = loansim::make_scenario_grid(shocks, speeds, 0.01, 0.35);
+  loansim::ScenarioGridConfig config;
+  config.loan_analytics = true;
+  for (auto _ : state) benchmark::DoNotOptimize(prepared.run(grid, config));
+  state.SetItemsProcessed(
+      static_cast<std::int64_t>(state.iterations() * pool.size() * grid.size()));
+}
+BENCHMARK(BM_ScenarioGridAnalytics)->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,118 @@
+// Monte Carlo paths per second as a function of thread count.
+
+#include <benchmark/benchmark.h>
+
+#include "loansim/monte_carlo.hpp"
+#include "loansim/rate_paths.hpp"
+#include "loansim/synthetic.hpp"
+
+#include "scaling.hpp"
+
+namespace {
+
+void BM_MonteCarlo(benchmark::State& state) {
+  // Enough path blocks for 16 per thread at the top of the sweep.
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(64, 7);
+  loansim::MonteCarloConfig config;
+  config.paths = loansim::bench::sweep_tasks() * loansim::kMonteCarloPathsPerBlock;
+  config.seed = 11;
+  config.threads = static_cast<unsigned>(state.range(0));
+  loansim::RunArenas arenas;
+  loansim::bench::WallTimer timer;
+  for (auto _ : state) {
+    timer.start();
+    benchmark::DoNotOptimize(loansim::simulate_pool(pool.columns(), config, &arenas));
+    timer.stop();
+    arenas.reset();
+  }
+  state.counters["paths/s"] =
+      static_cast<double>(state.iterations() * config.paths) / timer.seconds();
+}
+
+BENCHMARK(BM_MonteCarlo)->Apply(loansim::bench::thread_sweep)->Unit(benchmark::kMillisecond);
+
+// Single-threaded paths/s per path precision (0 = float64, 1 = float32).
+void BM_MonteCarloPrecision(benchmark::State& state) {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(4'096, 7);
+  loansim::MonteCarloConfig config;
+  config.paths = 256;
+  config.seed = 11;
+  config.threads = 1;
+  config.precision =
+      state.range(0) == 0 ? loansim::Precision::float64 : loansim::Precision::float32;
+  loansim::RunArenas arenas;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::simulate_pool(pool.columns(), config, &arenas));
+    arenas.reset();
+  }
+  state.SetLabel(loansim::to_string(config.precision));
+  state.counters["paths/s"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * config.paths), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_MonteCarloPrecision)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Paths/s and PV standard error per variance-reduction scheme at a fixed
+// path count: 0 plain, 1 antithetic, 2 control variate, 3 Sobol', 4 all.
+void BM_MonteCarloVarianceReduction(benchmark::State& state) {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(2'048, 7);
+  loansim::MonteCarloConfig config;
+  config.paths = 512;
+  config.seed = 11;
+  config.threads = 1;
+  config.precision = loansim::Precision::float32;
+  const auto mode = state.range(0);
+  config.antithetic = mode == 1 || mode == 4;
+  config.control_variate = mode == 2 || mode == 4;
+  if (mode >= 3) config.sampler = loansim::Sampler::sobol;
+  loansim::RunArenas arenas;
+  double se = 0.0;
+  for (auto _ : state) {
+    const loansim::MonteCarloResult r = loansim::simulate_pool(pool.columns(), config, &arenas);
+    se = r.present_value_estimate.std_error;
+    arenas.reset();
+  }
+  state.counters["paths/s"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * config.paths), benchmark::Counter::kIsRate);
+  state.counters["pv_se"] = se;
+}
+
+BENCHMARK(BM_MonteCarloVarianceReduction)->DenseRange(0, 4)->Unit(benchmark::kMillisecond);
+
+// Single-threaded rate-path generation, 360 months per path, per model
+// (1 = Hull-White, 2 = CIR).
+void BM_RatePaths(benchmark::State& state) {
+  loansim::ShortRateModel model;
+  model.kind = static_cast<loansim::RateModel>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::RatePaths(model, 11, 4'096, 360, 1));
+  }
+  state.SetLabel(loansim::to_string(model.kind));
+  state.counters["paths/s"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * 4'096), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_RatePaths)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+// Single-threaded Monte Carlo paths/s per rate model (0 none, 1 Hull-White,
+// 2 CIR): the cost of a shared rate path on top of the loan kernel.
+void BM_MonteCarloRates(benchmark::State& state) {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(4'096, 7);
+  loansim::MonteCarloConfig config;
+  config.paths = 256;
+  config.seed = 11;
+  config.threads = 1;
+  config.rates.kind = static_cast<loansim::RateModel>(state.range(0));
+  loansim::RunArenas arenas;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loansim::simulate_pool(pool.columns(), config, &arenas));
+    arenas.reset();
+  }
+  state.SetLabel(loansim::to_string(config.rates.kind));
+  state.counters["paths/s"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * config.paths), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_MonteCarloRates)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,73 @@
+// Parallel scaling at 16 tasks per thread at the top of the sweep. The
+// aggregate run uses deliberately uneven work: a tape sorted by term (12 to
+// 480 months), so equal-sized chunks differ in cost by up to 40x and a
+// static split would leave most threads idle at the end. Monte Carlo path
+// blocks each cover every loan, so they cost the same on any tape.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/monte_carlo.hpp"
+#include "loansim/synthetic.hpp"
+
+#include "scaling.hpp"
+
+namespace {
+
+loansim::LoanPool uneven_pool(std::size_t loans) {
+  loansim::LoanPool pool = loansim::make_synthetic_pool(loans, 17);
+  for (std::size_t i = 0; i < loans; ++i) {
+    pool.term_months[i] = 12 + static_cast<std::int32_t>((i * 7919) % 469);
+  }
+  std::sort(pool.term_months.begin(), pool.term_months.end());
+  return pool;
+}
+
+void BM_AggregateScaling(benchmark::State& state) {
+  static const loansim::LoanPool pool =
+      uneven_pool(loansim::bench::sweep_tasks() * loansim::kAggregateChunkLoans);
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  static const double one = loansim::bench::single_thread_seconds(
+      [&] { benchmark::DoNotOptimize(loansim::aggregate_pool(pool.columns(), assumptions, 1)); });
+  const auto threads = static_cast<unsigned>(state.range(0));
+  loansim::bench::WallTimer timer;
+  for (auto _ : state) {
+    timer.start();
+    benchmark::DoNotOptimize(loansim::aggregate_pool(pool.columns(), assumptions, threads));
+    timer.stop();
+  }
+  loansim::bench::report_scaling(state, one, timer, threads);
+}
+BENCHMARK(BM_AggregateScaling)
+    ->Apply(loansim::bench::thread_sweep)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_MonteCarloScaling(benchmark::State& state) {
+  static const loansim::LoanPool pool = loansim::make_synthetic_pool(32, 17);
+  loansim::MonteCarloConfig config;
+  config.paths = loansim::bench::sweep_tasks() * loansim::kMonteCarloPathsPerBlock;
+  config.seed = 5;
+  config.threads = 1;
+  static const double one = loansim::bench::single_thread_seconds(
+      [&] { benchmark::DoNotOptimize(loansim::simulate_pool(pool.columns(), config)); });
+  const auto threads = static_cast<unsigned>(state.range(0));
+  config.threads = threads;
+  loansim::RunArenas arenas;
+  loansim::bench::WallTimer timer;
+  for (auto _ : state) {
+    timer.start();
+    benchmark::DoNotOptimize(loansim::simulate_pool(pool.columns(), config, &arenas));
+    timer.stop();
+    arenas.reset();
+  }
+  loansim::bench::report_scaling(state, one, timer, threads);
+}
+BENCHMARK(BM_MonteCarloScaling)
+    ->Apply(loansim::bench::thread_sweep)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,70 @@
+#pragma once
+
+// Thread-count sweeps with parallel efficiency for the scaling benchmarks.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "loansim/parallel.hpp"
+
+namespace loansim::bench {
+
+/// Largest thread count thread_sweep() runs.
+inline unsigned sweep_top() { return std::max(64u, default_thread_count()); }
+
+/// Parallel tasks (chunks, path blocks) a swept workload needs: 16 per
+/// thread at the top of the sweep, so efficiency there measures the
+/// scheduler's balancing rather than a shortage of tasks.
+inline std::size_t sweep_tasks() { return std::size_t{16} * sweep_top(); }
+
+/// 1, 2, 4, ... up to at least 64 and at least every hardware thread, so
+/// results from large machines and oversubscribed small ones line up.
+inline void thread_sweep(benchmark::internal::Benchmark* b) {
+  const unsigned top = sweep_top();
+  unsigned t = 1;
+  for (; t < top; t *= 2) b->Arg(t);
+  b->Arg(top);
+  b->UseRealTime();
+}
+
+/// Wall seconds of `run()` on one thread: the best of three after a warm-up.
+template <class Run>
+double single_thread_seconds(Run&& run) {
+  run();
+  double best = 1e300;
+  for (int i = 0; i < 3; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                              .count());
+  }
+  return best;
+}
+
+/// Wall time of the timed loop, for report_scaling(). (Rate counters are
+/// divided by the main thread's CPU time, which is wrong for pooled work.)
+class WallTimer {
+ public:
+  void start() { start_ = std::chrono::steady_clock::now(); }
+  void stop() { total_ += std::chrono::steady_clock::now() - start_; }
+  [[nodiscard]] double seconds() const { return std::chrono::duration<double>(total_).count(); }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::duration total_{};
+};
+
+/// Reports `speedup` = T(1) / T(threads) and `efficiency` = speedup /
+/// threads, where 1.0 is linear scaling.
+inline void report_scaling(benchmark::State& state, double one_thread_seconds,
+                           const WallTimer& timer, unsigned threads) {
+  const double per_run = timer.seconds() / static_cast<double>(state.iterations());
+  const double speedup = one_thread_seconds / per_run;
+  state.counters["speedup"] = speedup;
+  state.counters["efficiency"] = speedup / threads;
+}
+
+}  // namespace loansim::bench
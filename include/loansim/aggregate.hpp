@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#include "loansim/arena.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+
+namespace loansim {
+
+/// Constant prepayment and default speeds applied to a whole pool.
+struct CashFlowAssumptions {
+  double cpr = 0.0;       ///< Annual conditional prepayment rate, in [0, 1).
+  double cdr = 0.0;       ///< Annual conditional default rate, in [0, 1).
+  double severity = 0.0;  ///< Loss given default, in [0, 1].
+
+  /// Throws std::invalid_argument on out-of-range values.
+  void validate() const;
+};
+
+/// Scheduled (no prepayment, no default) pool totals per period.
+///
+/// Under pool-wide constant speeds every loan keeps the same surviving
+/// fraction of its scheduled balance, so pool flows are these sums scaled
+/// per period. They are therefore the only quantity that has to be reduced
+/// over loans, and they are additive across any partition of the pool.
+struct ScheduledTotals {
+  std::pmr::vector<double> interest;
+  std::pmr::vector<double> principal;
+  std::pmr::vector<double> opening_balance;
+  std::pmr::vector<double> closing_balance;
+
+  ScheduledTotals() = default;
+  explicit ScheduledTotals(std::pmr::memory_resource* resource)
+      : interest(resource),
+        principal(resource),
+        opening_balance(resource),
+        closing_balance(resource) {}
+
+  [[nodiscard]] std::size_t periods() const noexcept { return interest.size(); }
+  /// Resizes every series, zero-filling new periods.
+  void resize(std::size_t periods);
+  /// Element-wise `*this += other`, growing to `other.periods()` if needed.
+  void add(const ScheduledTotals& other);
+};
+
+/// Adds the scheduled totals of `loans` into `out`, growing it to the
+/// longest term. Loans are walked in small cache-resident blocks, one
+/// period at a time, so no per-loan schedule is ever stored; blocks are
+/// filled in term order within windows of a few thousand loans.
+void accumulate_scheduled(const LoanColumns& loans, ScheduledTotals& out);
+/// As above, with each loan's interest accrued by its `accrual` table.
+void accumulate_scheduled(const LoanColumns& loans, const LoanAccrual& accrual,
+                          ScheduledTotals& out);
+
+/// Whether blocks are stepped by term kernels (on by default): periods
+/// before a block's shortest term skip the per-lane term compare, and
+/// blocks that all run 180 or 360 months use copies compiled for that
+/// term. Either way the totals are bit-identical; the switch exists to
+/// measure the gain.
+[[nodiscard]] bool term_kernels() noexcept;
+void set_term_kernels(bool enabled) noexcept;
+
+/// Pool cash flows implied by scheduled totals under `assumptions`.
+[[nodiscard]] PoolCashFlows apply_assumptions(const ScheduledTotals& scheduled,
+                                              const CashFlowAssumptions& assumptions);
+
+/// Loans per reduction chunk in aggregate_pool(). Chunks are the unit of
+/// parallel work and are folded in index order, so results do not depend
+/// on the thread count.
+inline constexpr std::size_t kAggregateChunkLoans = 16'384;
+
+/// Scheduled totals of `loans`, reduced in parallel over chunks of
+/// kAggregateChunkLoans folded in index order. This is aggregate_pool()
+/// before assumptions, for callers that combine totals across parts of a
+/// pool (see shard.hpp). The result uses the default memory resource;
+/// only chunk partials come from `arenas`.
+[[nodiscard]] ScheduledTotals scheduled_totals(const LoanColumns& loans, unsigned threads = 0,
+                                               RunArenas* arenas = nullptr);
+/// scheduled_totals() with dated accrual. Throws std::invalid_argument if
+/// `accrual` does not cover `loans` (LoanAccrual::validate()).
+[[nodiscard]] ScheduledTotals scheduled_totals(const LoanColumns& loans,
+                                               const LoanAccrual& accrual,
+                                               unsigned threads = 0,
+                                               RunArenas* arenas = nullptr);
+
+/// Period-by-period pool totals (scheduled principal, interest, prepayment,
+/// defaults, losses, balance) computed with a parallel reduction over loan
+/// chunks. Memory is proportional to chunks x periods, never loans x periods.
+/// Chunk partials are taken from `arenas` when given.
+[[nodiscard]] PoolCashFlows aggregate_pool(const LoanColumns& loans,
+                                           const CashFlowAssumptions& assumptions,
+                                           unsigned threads = 0,
+                                           RunArenas* arenas = nullptr);
+
+/// aggregate_pool() with each loan's interest accrued by its dated table
+/// (see AccrualTables). Tables whose factors are all 1 give
+/// aggregate_pool()'s bits.
+[[nodiscard]] PoolCashFlows aggregate_pool(const LoanColumns& loans, const LoanAccrual& accrual,
+                                           const CashFlowAssumptions& assumptions,
+                                           unsigned threads = 0,
+                                           RunArenas* arenas = nullptr);
+
+}  // namespace loansim
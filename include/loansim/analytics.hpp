@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace loansim {
+
+/// Price/yield measures of one stream of monthly cash flows.
+///
+/// Yields are annual rates compounded monthly (the mortgage convention);
+/// durations and weighted-average life are in years, convexity in years².
+struct CashFlowAnalytics {
+  double yield = 0.0;
+  double macaulay_duration = 0.0;
+  double modified_duration = 0.0;  ///< -dP/dy / P.
+  double convexity = 0.0;          ///< d²P/dy² / P.
+  double wal = 0.0;                ///< Principal-weighted average life.
+};
+
+/// Per-loan analytics for one scenario, structure-of-arrays in pool order.
+struct LoanAnalytics {
+  std::vector<double> yield;
+  std::vector<double> macaulay_duration;
+  std::vector<double> modified_duration;
+  std::vector<double> convexity;
+  std::vector<double> wal;
+
+  [[nodiscard]] std::size_t size() const noexcept { return yield.size(); }
+  void resize(std::size_t loans);
+};
+
+/// Solves for the yield at which `cash` is worth `price` and derives the
+/// other measures at that yield. `cash[t]` and `principal[t]` (the balance
+/// paid down, which weights WAL) are received at the end of month t + 1.
+/// Newton's method on the exact price, starting from `guess`.
+/// Throws std::invalid_argument if the spans differ in length, `price` is
+/// not positive or there is no positive cash flow to price.
+[[nodiscard]] CashFlowAnalytics analyze_cash_flows(std::span<const double> cash,
+                                                   std::span<const double> principal,
+                                                   double price, double guess = 0.05);
+
+}  // namespace loansim
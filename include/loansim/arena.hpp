@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace loansim {
+
+/// Monotonic bump allocator for one run's short-lived buffers.
+///
+/// Allocations are carved from large blocks obtained from `upstream`;
+/// deallocation is a no-op and everything is reclaimed at once by reset().
+/// reset() keeps the blocks, so a process that runs the same workload
+/// repeatedly stops touching the system allocator after the first run and
+/// does not fragment its heap. Not thread-safe: give each thread its own
+/// arena (see RunArenas).
+class Arena final : public std::pmr::memory_resource {
+ public:
+  static constexpr std::size_t kDefaultBlockSize = std::size_t{1} << 20;
+
+  explicit Arena(std::size_t block_size = kDefaultBlockSize,
+                 std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+  ~Arena() override;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// Makes every block available again. Memory handed out before the call
+  /// must no longer be used.
+  void reset() noexcept;
+  /// reset(), then returns all blocks to the upstream resource.
+  void release() noexcept;
+
+  /// Bytes handed out since the last reset.
+  [[nodiscard]] std::size_t bytes_allocated() const noexcept { return allocated_; }
+  /// Bytes held from upstream, used or not.
+  [[nodiscard]] std::size_t bytes_reserved() const noexcept { return reserved_; }
+
+ private:
+  struct Block {
+    std::byte* data;
+    std::size_t size;
+  };
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::size_t block_size_;
+  std::pmr::memory_resource* upstream_;
+  std::vector<Block> blocks_;
+  std::size_t current_ = 0;  // block being carved
+  std::size_t offset_ = 0;   // first free byte in blocks_[current_]
+  std::size_t allocated_ = 0;
+  std::size_t reserved_ = 0;
+};
+
+/// The arenas backing one simulation run: one per worker thread, so
+/// workers never contend on an allocator, plus one for run-level buffers
+/// touched only by the coordinating thread. Engines take an optional
+/// RunArenas* and fall back to the default memory resource without one;
+/// passing a long-lived instance and calling reset() between runs reuses
+/// its memory.
+class RunArenas {
+ public:
+  explicit RunArenas(std::size_t block_size = Arena::kDefaultBlockSize);
+
+  /// Grows to at least `workers` worker arenas. Call before workers start.
+  void ensure_workers(unsigned workers);
+  [[nodiscard]] unsigned workers() const noexcept {
+    return static_cast<unsigned>(workers_.size());
+  }
+
+  [[nodiscard]] Arena& worker(unsigned index) { return *workers_.at(index); }
+  [[nodiscard]] Arena& shared() noexcept { return shared_; }
+
+  /// Resets every arena; all memory from the previous run becomes invalid.
+  void reset() noexcept;
+  /// Returns all memory to the system.
+  void release() noexcept;
+
+  [[nodiscard]] std::size_t bytes_allocated() const noexcept;
+  [[nodiscard]] std::size_t bytes_reserved() const noexcept;
+  /// Whether `resource` is one of these arenas, i.e. whether memory taken
+  /// from it already shows up in bytes_allocated().
+  [[nodiscard]] bool owns(const std::pmr::memory_resource* resource) const noexcept;
+
+ private:
+  std::size_t block_size_;
+  Arena shared_;
+  std::vector<std::unique_ptr<Arena>> workers_;
+};
+
+/// `&arenas->shared()`, or the default resource when `arenas` is null.
+[[nodiscard]] inline std::pmr::memory_resource* shared_resource(RunArenas* arenas) noexcept {
+  return arenas != nullptr ? &arenas->shared() : std::pmr::get_default_resource();
+}
+
+/// The arena of `worker`, or the default resource when `arenas` is null.
+[[nodiscard]] inline std::pmr::memory_resource* worker_resource(RunArenas* arenas,
+                                                                unsigned worker) {
+  return arenas != nullptr ? &arenas->worker(worker) : std::pmr::get_default_resource();
+}
+
+}  // namespace loansim
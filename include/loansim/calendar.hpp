@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace loansim {
+
+/// A calendar date (days since 1970-01-01).
+using Date = std::chrono::sys_days;
+
+/// Parses an ISO date, "YYYY-MM-DD"; throws std::invalid_argument.
+[[nodiscard]] Date parse_date(std::string_view text);
+[[nodiscard]] std::string to_string(Date date);
+
+/// `date` moved by `months` calendar months, its day clamped to the end of
+/// the target month (Jan 31 + 1 month = Feb 28 or 29).
+[[nodiscard]] Date add_months(Date date, int months) noexcept;
+
+/// How a period's interest accrues.
+enum class DayCount : std::uint8_t {
+  thirty_360,     ///< 30/360 bond basis: day 31 counts as 30 (at the end, if the start is).
+  actual_360,     ///< Actual days / 360.
+  actual_365,     ///< Actual days / 365 (fixed).
+  actual_actual,  ///< ISDA: days in each calendar year / that year's length.
+};
+
+[[nodiscard]] const char* to_string(DayCount day_count) noexcept;
+/// Parses "30/360", "act/360", "act/365" or "act/act" (or the enumerator
+/// names); throws std::invalid_argument.
+[[nodiscard]] DayCount parse_day_count(std::string_view name);
+
+/// Accrual from `start` to `end` in standard months (one twelfth of a
+/// year): 30/360 counts a whole month as exactly 1, Actual/360 counts a
+/// 31-day month as 31/30, and so on.
+[[nodiscard]] double accrual_months(Date start, Date end, DayCount day_count) noexcept;
+
+/// How a payment date that is not a business day moves.
+enum class BusinessDayRule : std::uint8_t {
+  unadjusted,
+  following,           ///< To the next business day.
+  modified_following,  ///< Following, unless that crosses into the next month.
+  preceding,           ///< To the previous business day.
+};
+
+[[nodiscard]] const char* to_string(BusinessDayRule rule) noexcept;
+/// Parses "unadjusted", "following", "modified_following" or
+/// "preceding"; throws std::invalid_argument.
+[[nodiscard]] BusinessDayRule parse_business_day_rule(std::string_view name);
+
+/// Business days: every weekday that is not a listed holiday.
+class BusinessCalendar {
+ public:
+  BusinessCalendar() = default;
+  /// Holidays in any order; duplicates are ignored.
+  explicit BusinessCalendar(std::vector<Date> holidays);
+  /// Reads one ISO date per line; blank lines and `#` comments are
+  /// skipped. Throws std::runtime_error naming the line on bad input.
+  [[nodiscard]] static BusinessCalendar read(const std::string& path);
+
+  [[nodiscard]] bool is_business_day(Date date) const noexcept;
+  [[nodiscard]] Date adjust(Date date, BusinessDayRule rule) const noexcept;
+  [[nodiscard]] std::span<const Date> holidays() const noexcept { return holidays_; }
+
+ private:
+  std::vector<Date> holidays_;  // sorted, unique
+};
+
+/// Day count and payment-date roll of a loan.
+struct AccrualConvention {
+  DayCount day_count = DayCount::thirty_360;
+  BusinessDayRule roll = BusinessDayRule::unadjusted;
+
+  bool operator==(const AccrualConvention&) const = default;
+};
+
+/// Payment dates and accrual factors, built once per distinct
+/// (origination date, convention) and shared by every loan that has it.
+///
+/// Period t of a loan originated on `o` pays on add_months(o, t + 1),
+/// moved by the roll rule, and accrues over `accrual(id)[t]` standard
+/// months: between adjusted dates, except under 30/360, which counts from
+/// one nominal payment date (o's day of the month, before clamping to the
+/// month's end) to the next. A loan's interest for the period is its
+/// balance times annual_rate / 12 times that factor. Under 30/360 every
+/// period is a whole month and every factor exactly 1, whatever the day of
+/// origination, so the plain monthly schedule is reproduced bit for bit.
+///
+/// Tables are stored back to back, `periods()` entries each, so a kernel
+/// finds loan i's factor for period t at one offset per loan plus t. A
+/// pool originated on a few hundred distinct dates needs a few hundred
+/// rows, not one per loan.
+class AccrualTables {
+ public:
+  explicit AccrualTables(std::size_t periods, BusinessCalendar calendar = {});
+
+  /// The id of the table for (origination, convention), building it on
+  /// first use. Not thread-safe; tables are read-only once built.
+  std::uint32_t intern(Date origination, const AccrualConvention& convention);
+
+  [[nodiscard]] std::size_t periods() const noexcept { return periods_; }
+  /// Number of distinct tables.
+  [[nodiscard]] std::size_t size() const noexcept { return origination_.size(); }
+  [[nodiscard]] std::size_t bytes() const noexcept;
+  [[nodiscard]] const BusinessCalendar& calendar() const noexcept { return calendar_; }
+
+  [[nodiscard]] Date origination(std::uint32_t id) const noexcept { return origination_[id]; }
+  /// Standard months accrued in each period.
+  [[nodiscard]] std::span<const double> accrual(std::uint32_t id) const noexcept {
+    return std::span<const double>(accrual_).subspan(id * periods_, periods_);
+  }
+  /// Adjusted payment date of each period.
+  [[nodiscard]] std::span<const Date> payment_dates(std::uint32_t id) const noexcept {
+    return std::span<const Date>(dates_).subspan(id * periods_, periods_);
+  }
+  /// All tables, table-major.
+  [[nodiscard]] std::span<const double> accrual_data() const noexcept { return accrual_; }
+
+ private:
+  std::size_t periods_;
+  BusinessCalendar calendar_;
+  std::unordered_map<std::uint64_t, std::uint32_t> index_;
+  std::vector<Date> origination_;
+  std::vector<double> accrual_;
+  std::vector<Date> dates_;
+};
+
+/// Per-loan accrual for a pool: loan i accrues by `tables->accrual(table[i])`.
+struct LoanAccrual {
+  const AccrualTables* tables = nullptr;
+  std::span<const std::uint32_t> table;
+
+  [[nodiscard]] LoanAccrual slice(std::size_t begin, std::size_t end) const noexcept {
+    return {tables, table.subspan(begin, end - begin)};
+  }
+  /// Throws std::invalid_argument unless there is one valid table id per
+  /// loan and the tables span `periods`.
+  void validate(std::size_t loans, std::size_t periods) const;
+};
+
+}  // namespace loansim
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace loansim {
+
+/// Period-by-period totals for a pool (or the mean over simulated paths).
+/// Index `t` is the t-th monthly period; every vector has `periods()` entries.
+///
+/// Series allocate from the memory resource given at construction (the
+/// default resource otherwise); copies always use the default resource.
+struct PoolCashFlows {
+  std::pmr::vector<double> interest;             ///< Interest collected.
+  std::pmr::vector<double> scheduled_principal;  ///< Amortization per the schedule.
+  std::pmr::vector<double> prepayment;           ///< Voluntary principal prepaid.
+  std::pmr::vector<double> defaults;             ///< Balance that defaulted.
+  std::pmr::vector<double> loss;                 ///< Defaulted balance not recovered.
+  std::pmr::vector<double> balance;              ///< Performing balance at period end.
+
+  PoolCashFlows() = default;
+  explicit PoolCashFlows(std::size_t periods,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : interest(resource),
+        scheduled_principal(resource),
+        prepayment(resource),
+        defaults(resource),
+        loss(resource),
+        balance(resource) {
+    resize(periods);
+  }
+
+  [[nodiscard]] std::size_t periods() const noexcept { return interest.size(); }
+
+  /// Resizes every series, zero-filling new periods.
+  void resize(std::size_t periods);
+  /// Zeros every series without changing its length.
+  void clear() noexcept;
+  /// Element-wise `*this += other`; `other` may have fewer periods.
+  void add(const PoolCashFlows& other);
+  /// Multiplies every series by `factor`.
+  void scale(double factor) noexcept;
+
+  /// Cash received by the investor in period t: interest, scheduled and
+  /// prepaid principal, and recoveries on defaults.
+  [[nodiscard]] double total_cash(std::size_t t) const noexcept {
+    return interest[t] + scheduled_principal[t] + prepayment[t] + (defaults[t] - loss[t]);
+  }
+};
+
+}  // namespace loansim
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+
+namespace loansim {
+
+/// A loan pool whose aggregates are kept current under small edits.
+///
+/// Scheduled totals are held per chunk of kAggregateChunkLoans loan slots.
+/// Edits mark their chunk dirty; refresh() recomputes only dirty chunks and
+/// re-folds the chunk totals, which costs one chunk per touched chunk plus a
+/// pass over chunks x periods, independent of pool size. Chunking and fold
+/// order match aggregate_pool(), so the patched totals are bit-identical to
+/// a full rerun over the same loans.
+///
+/// Loans live in slots addressed by index. Paying a loan off zeros its
+/// balance; the slot stays (and contributes nothing) so indices are stable.
+/// Not thread-safe: callers serialize edits and reads.
+class IncrementalPool {
+ public:
+  explicit IncrementalPool(const LoanColumns& loans, unsigned threads = 0);
+
+  [[nodiscard]] std::size_t size() const noexcept { return loans_.size(); }
+  [[nodiscard]] const LoanPool& loans() const noexcept { return loans_; }
+
+  /// Appends a loan and returns its slot index.
+  std::size_t add(double principal, double annual_rate, std::int32_t term_months);
+  /// Replaces the loan in `index`.
+  void modify(std::size_t index, double principal, double annual_rate,
+              std::int32_t term_months);
+  /// Removes the loan's balance from the pool.
+  void pay_off(std::size_t index);
+
+  /// Chunks waiting to be recomputed.
+  [[nodiscard]] std::size_t dirty_chunks() const noexcept;
+
+  /// Recomputes dirty chunks and returns the current pool totals.
+  const ScheduledTotals& scheduled();
+  /// Current pool cash flows under `assumptions` (refreshes first).
+  [[nodiscard]] PoolCashFlows cash_flows(const CashFlowAssumptions& assumptions);
+
+ private:
+  void mark(std::size_t index);
+  void refresh();
+
+  unsigned threads_;
+  LoanPool loans_;
+  std::vector<ScheduledTotals> chunk_totals_;
+  std::vector<std::uint8_t> dirty_;
+  ScheduledTotals total_;
+  bool stale_ = false;
+};
+
+}  // namespace loansim
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "loansim/arena.hpp"
+
+// Set by the LOANSIM_ENABLE_INSTRUMENTATION CMake option. With 0, StageScope
+// is an empty inline type and the engines' scopes compile to nothing.
+#ifndef LOANSIM_INSTRUMENTATION
+#define LOANSIM_INSTRUMENTATION 1
+#endif
+
+namespace loansim {
+
+/// Pipeline stages the engines report against.
+enum class Stage : int { load = 0, schedule, simulate, aggregate, output };
+inline constexpr std::size_t kStageCount = 5;
+
+[[nodiscard]] const char* to_string(Stage stage) noexcept;
+
+/// Whether this build records stage statistics.
+inline constexpr bool kInstrumentationEnabled = LOANSIM_INSTRUMENTATION != 0;
+
+/// Totals for one stage since the last reset_stage_report().
+struct StageStats {
+  std::uint64_t calls = 0;
+  double seconds = 0.0;     // wall time
+  std::uint64_t loans = 0;  // loans processed, summed over calls
+  std::uint64_t bytes = 0;  // bytes allocated: arena growth plus stage buffers
+};
+
+using StageReport = std::array<StageStats, kStageCount>;
+
+/// Process-wide totals. Safe to call while engines are running on other
+/// threads; each stage's fields are read individually, not as a snapshot.
+[[nodiscard]] StageReport stage_report();
+void reset_stage_report();
+
+/// stage_report() as a JSON object, one member per stage:
+/// `{"enabled":true,"stages":{"load":{"calls":1,"seconds":0.25,...},...}}`.
+[[nodiscard]] std::string stage_report_json();
+
+#if LOANSIM_INSTRUMENTATION
+
+/// Times the enclosing scope and adds it to `stage`'s totals on exit.
+///
+/// Only the outermost scope per stage and thread counts a call and its
+/// time, so an entry point that calls another of the same stage
+/// (LoanTape::open() reading a columnar tape, say) is timed once; nested
+/// scopes still add their loans and bytes. When `arenas` is given, the
+/// growth of its bytes_allocated() over the scope is added to the bytes.
+class StageScope {
+ public:
+  StageScope(Stage stage, std::size_t loans, const RunArenas* arenas = nullptr) noexcept;
+  ~StageScope();
+  StageScope(const StageScope&) = delete;
+  StageScope& operator=(const StageScope&) = delete;
+
+  void add_loans(std::size_t n) noexcept { loans_ += n; }
+  void add_bytes(std::size_t n) noexcept { bytes_ += n; }
+
+ private:
+  Stage stage_;
+  bool outermost_;
+  const RunArenas* arenas_;
+  std::size_t arena_start_ = 0;
+  std::uint64_t loans_;
+  std::uint64_t bytes_ = 0;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#else
+
+class StageScope {
+ public:
+  StageScope(Stage, std::size_t, const RunArenas* = nullptr) noexcept {}
+  StageScope(const StageScope&) = delete;
+  StageScope& operator=(const StageScope&) = delete;
+
+  void add_loans(std::size_t) noexcept {}
+  void add_bytes(std::size_t) noexcept {}
+};
+
+#endif
+
+}  // namespace loansim
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace loansim {
+
+/// Non-owning, column-oriented view of a pool of level-payment loans.
+///
+/// Every column has one entry per loan; all columns must have the same
+/// length. Kernels walk these columns with unit stride, so callers should
+/// keep them in contiguous storage (a `LoanPool`, a mapped tape, ...).
+struct LoanColumns {
+  std::span<const double> principal;          ///< Balance to amortize.
+  std::span<const double> annual_rate;        ///< Note rate, e.g. 0.065.
+  std::span<const std::int32_t> term_months;  ///< Remaining term, > 0.
+
+  [[nodiscard]] std::size_t size() const noexcept { return principal.size(); }
+  [[nodiscard]] bool empty() const noexcept { return principal.empty(); }
+
+  /// Loans [begin, end) as a view of the same columns.
+  [[nodiscard]] LoanColumns slice(std::size_t begin, std::size_t end) const;
+
+  /// Throws std::invalid_argument if column lengths differ or a loan has a
+  /// negative or non-finite balance or rate, or a non-positive term.
+  void validate() const;
+};
+
+/// Owning column storage for a loan pool.
+struct LoanPool {
+  std::vector<double> principal;
+  std::vector<double> annual_rate;
+  std::vector<std::int32_t> term_months;
+
+  [[nodiscard]] std::size_t size() const noexcept { return principal.size(); }
+
+  void reserve(std::size_t n);
+  void push_back(double balance, double rate, std::int32_t term);
+
+  [[nodiscard]] LoanColumns columns() const noexcept;
+};
+
+}  // namespace loansim
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/arena.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/loan_tape.hpp"
+
+namespace loansim {
+
+/// One attribute column of a LoanStore's cold set, encoded as narrowly as
+/// its values allow.
+///
+/// - `number`: every non-blank value is a plain decimal with no '+', no
+///   exponent and no leading zeros, so number() loses nothing but trailing
+///   fractional zeros. With at most six fractional digits the values are
+///   stored as fixed-point integers offset from the column minimum, in 1,
+///   2, 4 or 8 bytes; otherwise as raw doubles, when every value has at
+///   most 15 significant digits.
+/// - `category`: text with at most kMaxCategories distinct values. Each row
+///   holds a 1, 2 or 4 byte code into a sorted dictionary.
+/// - `text`: anything else (zero-padded IDs and ZIP codes, free text), as
+///   offsets into one character buffer.
+class ColdColumn {
+ public:
+  enum class Kind : std::uint8_t { number, category, text };
+
+  /// Above this many distinct values a text column is stored as `text`.
+  static constexpr std::size_t kMaxCategories = 65'536;
+
+  [[nodiscard]] const std::string& name() const noexcept { return name_; }
+  [[nodiscard]] Kind kind() const noexcept { return kind_; }
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+  /// Bytes per row of the packed values (0 for `text`).
+  [[nodiscard]] std::size_t width() const noexcept { return width_; }
+  /// Encoded size, including the dictionary or character buffer.
+  [[nodiscard]] std::size_t bytes() const noexcept;
+
+  /// True for a blank field.
+  [[nodiscard]] bool missing(std::size_t row) const noexcept;
+  /// Value of a `number` row, NaN when missing.
+  [[nodiscard]] double number(std::size_t row) const noexcept;
+  /// Value of a `category` or `text` row (empty when missing).
+  [[nodiscard]] std::string_view text(std::size_t row) const noexcept;
+  /// Dictionary code of a `category` row.
+  [[nodiscard]] std::uint32_t code(std::size_t row) const noexcept;
+  /// Sorted distinct values of a `category` column.
+  [[nodiscard]] std::span<const std::string> categories() const noexcept { return categories_; }
+
+ private:
+  friend class ColdColumnBuilder;
+
+  [[nodiscard]] std::uint64_t packed(std::size_t row) const noexcept;
+
+  std::string name_;
+  Kind kind_ = Kind::text;
+  std::size_t size_ = 0;
+  std::size_t width_ = 0;
+  std::vector<std::uint8_t> packed_;  // number / category: width_ bytes per row
+  bool raw_ = false;                  // number: packed_ holds doubles, NaN when missing
+  std::int64_t base_ = 0;             // number: row = (base_ + packed - 1) / scale_; 0 = missing
+  double scale_ = 1.0;                // number: 10^fractional digits
+  std::vector<std::string> categories_;
+  std::vector<std::uint64_t> offsets_;  // text: size_ + 1 offsets into chars_
+  std::string chars_;
+};
+
+/// A resident loan pool split into hot and cold fields.
+///
+/// The hot set is what the engines read every period (balance, rate,
+/// remaining term), stored in narrow encodings that decode exactly:
+///
+/// - balances as uint32 cents when every balance is a whole number of
+///   cents below $42.9M, raw doubles otherwise;
+/// - rates as uint16 codes into a sorted dictionary when the pool has at
+///   most 65,536 distinct rates (note rates come in small steps, so a book
+///   usually has a few hundred), raw doubles otherwise;
+/// - terms as uint16 months.
+///
+/// That is 8 bytes per loan against 20 in a LoanPool, about 80 MB for 10M
+/// loans. Engines run on decoded chunks (decode(), for_each_chunk()),
+/// which are small enough to stay in cache. Decoding is exact, so results
+/// match the LoanPool bit for bit.
+///
+/// The cold set is every other tape column (IDs, origination data,
+/// borrower attributes), kept as ColdColumns and never touched by the
+/// engines.
+class LoanStore {
+ public:
+  /// Encodes validated `loans` (no cold columns). Throws
+  /// std::invalid_argument for a term above 65,535 months.
+  [[nodiscard]] static LoanStore from_columns(const LoanColumns& loans);
+
+  /// Reads a CSV tape from its mapping in streaming passes: the first
+  /// choose each column's encoding, the next fill it, so nothing is held
+  /// in decoded form. The three loan columns named in `options` form the
+  /// hot set; every other column goes to the cold set.
+  [[nodiscard]] static LoanStore read_csv(const std::string& path,
+                                          const CsvTapeOptions& options = {});
+
+  [[nodiscard]] std::size_t size() const noexcept { return term_.size(); }
+  /// Longest remaining term, in months.
+  [[nodiscard]] std::size_t max_term() const noexcept;
+
+  /// Decodes loans [begin, end) into `out`, replacing its contents.
+  void decode(std::size_t begin, std::size_t end, LoanPool& out) const;
+  [[nodiscard]] LoanPool decode_all() const;
+
+  /// Calls `fn` for consecutive chunks of up to `chunk_loans` decoded loans,
+  /// in order, reusing one buffer. The columns die with the call.
+  void for_each_chunk(std::size_t chunk_loans,
+                      const std::function<void(const LoanColumns& chunk)>& fn) const;
+
+  [[nodiscard]] bool balances_in_cents() const noexcept { return !balance_cents_.empty(); }
+  /// Distinct rates in the dictionary; 0 if rates are stored raw.
+  [[nodiscard]] std::size_t rate_dictionary_size() const noexcept { return rates_.size(); }
+
+  [[nodiscard]] std::size_t hot_bytes() const noexcept;
+  [[nodiscard]] std::size_t cold_bytes() const noexcept;
+
+  [[nodiscard]] std::span<const ColdColumn> cold() const noexcept { return cold_; }
+  /// The cold column called `name`, or nullptr.
+  [[nodiscard]] const ColdColumn* cold(std::string_view name) const noexcept;
+
+ private:
+  friend class HotSetBuilder;
+
+  std::vector<std::uint32_t> balance_cents_;  // one of these two holds the balances
+  std::vector<double> balance_;
+  std::vector<std::uint16_t> rate_code_;  // codes into rates_, or
+  std::vector<double> rates_;
+  std::vector<double> rate_;  // raw rates
+  std::vector<std::uint16_t> term_;
+  std::vector<ColdColumn> cold_;
+};
+
+/// aggregate_pool() over a store: each worker decodes its chunk and
+/// reduces it exactly as aggregate_pool() would, so the result is
+/// bit-identical to aggregating store.decode_all().
+[[nodiscard]] PoolCashFlows aggregate_store(const LoanStore& store,
+                                            const CashFlowAssumptions& assumptions,
+                                            unsigned threads = 0, RunArenas* arenas = nullptr);
+
+}  // namespace loansim
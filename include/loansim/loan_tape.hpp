@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "loansim/loan.hpp"
+#include "loansim/mapped_file.hpp"
+#include "loansim/products.hpp"
+
+namespace loansim {
+
+struct CsvTapeOptions {
+  char delimiter = ',';
+  std::string principal_column = "principal";
+  std::string rate_column = "annual_rate";
+  std::string term_column = "term_months";
+  double rate_scale = 1.0;          ///< Applied to parsed rates, e.g. 0.01 for percent.
+  std::size_t chunk_rows = 65'536;  ///< Loans per chunk handed to callbacks.
+};
+
+/// Streaming reader for delimited loan tapes.
+///
+/// The file is memory-mapped and parsed in place: the first line names the
+/// columns, the three numeric columns named in the options are decoded with
+/// std::from_chars into reusable chunk buffers, and all other columns are
+/// skipped. No allocation happens per row. Malformed input throws
+/// std::runtime_error naming the line.
+class CsvTapeReader {
+ public:
+  explicit CsvTapeReader(const std::string& path, CsvTapeOptions options = {});
+
+  /// Number of data rows (non-blank lines after the header).
+  [[nodiscard]] std::size_t count_rows() const;
+
+  /// Calls `fn` once per chunk of up to `chunk_rows` loans, in file order.
+  /// The columns are only valid for the duration of the call.
+  void for_each_chunk(const std::function<void(const LoanColumns& chunk)>& fn) const;
+
+  /// Parses the whole tape into owned storage.
+  [[nodiscard]] LoanPool read_all() const;
+
+  /// Parses the whole tape into per-product groups. Besides the three loan
+  /// columns it reads, when present: `product` (`fixed`, `io` or `arm`;
+  /// blank means fixed), `io_months`, and the ARM terms `first_reset`,
+  /// `reset_months`, `margin`, `periodic_cap`, `lifetime_cap` and
+  /// `rate_floor` (rates scaled by `rate_scale`). Missing or blank ARM
+  /// fields take the ArmTerms defaults.
+  [[nodiscard]] ProductBook read_products() const;
+
+  /// Whether the header names a column `name`.
+  [[nodiscard]] bool has_column(std::string_view name) const;
+
+  /// Header column names, trimmed, in file order.
+  [[nodiscard]] std::vector<std::string> column_names() const;
+
+  /// Calls `fn` with each data row's line number and its fields, split on
+  /// the delimiter but not trimmed, in file order. For readers of the
+  /// columns other than the three loan fields; the views are only valid
+  /// for the duration of the call.
+  void for_each_row(
+      const std::function<void(std::size_t line, std::span<const std::string_view> fields)>& fn)
+      const;
+
+ private:
+  std::string path_;
+  CsvTapeOptions options_;
+  MappedFile file_;
+  std::size_t body_offset_ = 0;  // first byte after the header line
+  int principal_index_ = -1;
+  int rate_index_ = -1;
+  int term_index_ = -1;
+  int field_count_ = 0;
+};
+
+/// Read-only view of a binary columnar tape (see write_columnar_tape()).
+///
+/// Opening maps the file and validates its header; the columns then point
+/// straight into the mapping, so there is nothing to parse.
+class ColumnarTape {
+ public:
+  [[nodiscard]] static ColumnarTape open(const std::string& path);
+
+  [[nodiscard]] std::size_t size() const noexcept { return columns_.size(); }
+  [[nodiscard]] const LoanColumns& columns() const noexcept { return columns_; }
+
+  /// True if the file starts with the columnar tape magic.
+  [[nodiscard]] static bool is_columnar(const std::string& path);
+
+ private:
+  MappedFile file_;
+  LoanColumns columns_;
+};
+
+/// Writes `loans` as a binary columnar tape: a 64-byte header followed by
+/// each column as a raw little-endian array, 64-byte aligned.
+void write_columnar_tape(const LoanColumns& loans, const std::string& path);
+
+/// Writes `loans` as a CSV tape with the default column names.
+void write_csv_tape(const LoanColumns& loans, const std::string& path);
+
+/// Streams a CSV tape into a columnar tape. The output is sized from a row
+/// count pass, mapped, and filled chunk by chunk, so memory use does not
+/// grow with the tape. It is written to `out_path` + ".tmp" and renamed
+/// into place once complete, so on failure `out_path` is left as it was.
+/// Returns the number of loans written.
+std::size_t convert_csv_to_columnar(const std::string& csv_path, const std::string& out_path,
+                                    const CsvTapeOptions& options = {});
+
+/// A loan tape of either format, detected from its first bytes.
+class LoanTape {
+ public:
+  [[nodiscard]] static LoanTape open(const std::string& path,
+                                     const CsvTapeOptions& options = {});
+
+  [[nodiscard]] LoanColumns columns() const;
+  [[nodiscard]] std::size_t size() const { return columns().size(); }
+  [[nodiscard]] bool is_columnar() const noexcept {
+    return std::holds_alternative<ColumnarTape>(storage_);
+  }
+
+ private:
+  std::variant<LoanPool, ColumnarTape> storage_;
+};
+
+}  // namespace loansim
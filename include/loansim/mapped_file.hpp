@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace loansim {
+
+/// RAII memory mapping of a whole file (POSIX mmap).
+///
+/// `open()` maps read-only; `create()` sizes a new file and maps it
+/// read-write so it can be filled in place. Move-only. Errors throw
+/// std::system_error carrying errno and the path.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /// Maps an existing file read-only and advises sequential access.
+  [[nodiscard]] static MappedFile open(const std::string& path);
+  /// Creates (or truncates) `path` to `size` bytes and maps it writable.
+  [[nodiscard]] static MappedFile create(const std::string& path, std::size_t size);
+
+  [[nodiscard]] std::span<const std::byte> bytes() const noexcept { return {data_, size_}; }
+  /// Writable view; empty unless the mapping came from create().
+  [[nodiscard]] std::span<std::byte> writable_bytes() noexcept {
+    return writable_ ? std::span<std::byte>{data_, size_} : std::span<std::byte>{};
+  }
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+  /// Writes a writable mapping's dirty pages back to the file and waits
+  /// for them to reach the device.
+  void sync();
+
+ private:
+  void reset() noexcept;
+
+  std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool writable_ = false;
+};
+
+}  // namespace loansim
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loansim/arena.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/rate_paths.hpp"
+#include "loansim/stats.hpp"
+
+namespace loansim {
+
+/// Floating-point type of the per-loan path state in simulate_pool().
+///
+/// The path kernel is a template over its element type; this selects the
+/// instantiation. `float32` halves the memory streamed per loan-period and
+/// doubles the SIMD width. Model inputs are derived in double and rounded
+/// once, path factors are computed in double, scheduled balances are reset
+/// to the double schedule every 32 periods, and per-loan sums are folded
+/// into double every 1,024 loans, so results stay deterministic for a seed
+/// and within kFloat32Tolerance of the `float64` run (see
+/// tools/precision_check and tools/reference_check).
+enum class Precision : std::uint8_t { float64, float32 };
+
+/// Relative difference from a `float64` run, on the same seed, that a
+/// `float32` run stays within for mean present value, mean loss and every
+/// period's mean cash flows. Periods whose flows are below 1e-6 of the
+/// period's largest are skipped.
+inline constexpr double kFloat32Tolerance = 1e-4;
+
+[[nodiscard]] const char* to_string(Precision precision) noexcept;
+/// Parses "float64"/"double" or "float32"/"float"; throws std::invalid_argument.
+[[nodiscard]] Precision parse_precision(std::string_view name);
+
+/// How simulate_pool() draws each path's normals.
+enum class Sampler : std::uint8_t {
+  pseudo_random,  ///< An independent Philox NormalStream per path.
+  /// Digitally shifted Sobol' points, one coordinate per factor and month
+  /// (see MonteCarloConfig::sobol_replicates).
+  sobol,
+};
+
+[[nodiscard]] const char* to_string(Sampler sampler) noexcept;
+/// Parses "pseudo_random"/"philox" or "sobol"; throws std::invalid_argument.
+[[nodiscard]] Sampler parse_sampler(std::string_view name);
+
+/// Paths per block in simulate_pool(). Blocks are the unit of parallel
+/// work and are folded in a fixed order, so results do not depend on the
+/// thread count.
+inline constexpr std::size_t kMonteCarloPathsPerBlock = 64;
+
+/// Prepayment and default model for simulate_pool().
+///
+/// Each path draws two systematic factors per month, one for prepayment
+/// speed and one for default rate. Each factor is a stationary AR(1) of
+/// standard normals, x_t = phi x_{t-1} + sqrt(1 - phi^2) z_t, mapped to a
+/// mean-one lognormal multiplier exp(vol x_t - vol^2 / 2). A loan's monthly
+/// prepayment rate (SMM) is its base SMM times the speed multiplier; the
+/// base SMM comes from `base_cpr` scaled by the loan's refinance incentive,
+/// exp(refi_sensitivity * (note_rate - market_rate)).
+///
+/// With a short-rate model (`rates`), each path also carries a rate path,
+/// generated once per path and read by every loan. The mortgage rate moves
+/// one for one with the short rate, so the incentive scales every loan's
+/// SMM by exp(-refi_sensitivity * (r_t - r_0)), and flows are discounted
+/// along the path at r_t + discount_rate - r_0. A path that stays at r_0
+/// reproduces the run without a rate model bit for bit.
+struct MonteCarloConfig {
+  std::size_t paths = 10'000;
+  std::uint64_t seed = 1;
+  unsigned threads = 0;  ///< 0 = default_thread_count().
+  Precision precision = Precision::float64;
+
+  // Variance reduction. The options combine freely; the estimates in
+  // MonteCarloResult report the standard error of whatever was chosen.
+  Sampler sampler = Sampler::pseudo_random;
+  /// Independent digital shifts for Sampler::sobol. Paths are split into
+  /// this many equal runs of the sequence, one shift each, and the spread
+  /// of the run means gives the standard error. Must divide the draw count
+  /// (paths, or paths / 2 when antithetic).
+  std::size_t sobol_replicates = 16;
+  /// Path 2k + 1 reuses path 2k's normals with the sign flipped, and each
+  /// pair counts as one sample. Needs an even path count.
+  bool antithetic = false;
+  /// Regresses PV and loss on a control with a known mean of zero: their
+  /// first-order response to the speed and default multipliers, weighted
+  /// by sensitivities taken in closed form from the scheduled cash flows
+  /// at the base (multiplier one) path. The coefficient is estimated from
+  /// the run's own paths.
+  bool control_variate = false;
+
+  /// Checkpoint file; empty disables checkpointing. The run snapshots its
+  /// progress here (the next path to simulate and the partial sums folded
+  /// so far) between waves of paths, replacing the file atomically. A run
+  /// that finds a snapshot from the same configuration and pool resumes
+  /// from it, and the result is bit-identical to an uninterrupted run at
+  /// any thread count. The file is removed when the run completes.
+  std::string checkpoint_path;
+  /// Minimum seconds between snapshots; 0 writes one after every wave.
+  double checkpoint_interval = 60.0;
+
+  double base_cpr = 0.06;           ///< Annual prepayment rate at zero incentive.
+  double refi_sensitivity = 25.0;   ///< Per unit of rate incentive (25 => e^0.25 per 1%).
+  double market_rate = 0.05;        ///< Prevailing mortgage rate.
+  double cpr_volatility = 0.30;
+  double base_cdr = 0.005;          ///< Annual default rate.
+  double cdr_volatility = 0.60;
+  double factor_persistence = 0.9;  ///< AR(1) coefficient phi, in [0, 1).
+  double severity = 0.35;           ///< Loss given default, in [0, 1].
+  double discount_rate = 0.05;      ///< Annual rate for path present values.
+  /// Short-rate dynamics; RateModel::none keeps market and discount rates
+  /// fixed. Rate shocks come from their own Philox streams of `seed`, also
+  /// under Sampler::sobol, and follow `antithetic`.
+  ShortRateModel rates;
+
+  /// Throws std::invalid_argument on out-of-range parameters, including
+  /// those of `rates`.
+  void validate() const;
+};
+
+/// A Monte Carlo estimate of a mean, with its standard error.
+struct Estimate {
+  double mean = 0.0;
+  double std_error = 0.0;
+  /// Independent samples behind std_error: paths, antithetic pairs or
+  /// Sobol' replicates.
+  std::uint64_t samples = 0;
+};
+
+struct MonteCarloResult {
+  std::size_t paths = 0;
+  PoolCashFlows mean;         ///< Per-period pool flows averaged over paths.
+  RunningStats present_value; ///< Discounted pool cash flow per path.
+  RunningStats total_loss;    ///< Undiscounted pool loss per path.
+  /// Mean PV and loss under the configured variance reduction. Without any,
+  /// these match the means and std_error() of the per-path stats above;
+  /// those always describe the raw paths, so their std_error() is what
+  /// plain sampling would report for the same path count.
+  Estimate present_value_estimate;
+  Estimate total_loss_estimate;
+};
+
+/// Simulates `config.paths` prepayment/default paths for the pool.
+///
+/// With the default sampler, path p draws its factors from
+/// NormalStream(seed, p); Sobol' shifts also derive from `seed`. Paths are
+/// grouped into fixed-size blocks whose partial results are folded in block
+/// order, so the result is bit-identical for a given seed at any thread
+/// count. Model inputs and block partials come from `arenas.shared()` and
+/// each worker's path state from its own arena when `arenas` is given.
+///
+/// With `config.checkpoint_path` set, throws std::runtime_error if the
+/// file there is not a snapshot of this run (other settings, seed or
+/// loans), and std::system_error if it cannot be written.
+[[nodiscard]] MonteCarloResult simulate_pool(const LoanColumns& loans,
+                                             const MonteCarloConfig& config,
+                                             RunArenas* arenas = nullptr);
+
+/// One path's pool totals: its present value and loss, and their controls
+/// (zero without MonteCarloConfig::control_variate).
+struct PathValues {
+  double present_value = 0.0;
+  double total_loss = 0.0;
+  double pv_control = 0.0;
+  double loss_control = 0.0;
+};
+
+/// A Monte Carlo run over part of a pool, kept at path level.
+///
+/// Every path's factors depend only on the seed and the path index, so
+/// the same path sees the same economy in every part, and its pool totals
+/// are the sums of its totals over the parts. Per-path statistics are not
+/// additive that way; path values are, so runs over disjoint parts of a
+/// pool merge into the whole-pool result (merge_partials()).
+struct MonteCarloPartial {
+  /// Identifies the settings the part ran with; merging checks it.
+  std::uint64_t settings = 0;
+  PoolCashFlows sum;              ///< Per-period flows summed (not averaged) over paths.
+  std::vector<PathValues> paths;  ///< Indexed by path.
+};
+
+/// simulate_pool() over part of a pool, keeping path values (32 bytes per
+/// path). Throws std::invalid_argument if checkpointing is enabled.
+[[nodiscard]] MonteCarloPartial simulate_partial(const LoanColumns& loans,
+                                                 const MonteCarloConfig& config,
+                                                 RunArenas* arenas = nullptr);
+
+/// The whole-pool result from partials over disjoint parts of it, all run
+/// with `config`. Path values are summed over `parts` in order and then
+/// folded exactly as simulate_pool() folds them, so a single part merges
+/// to simulate_pool()'s bits; over several parts the result differs from
+/// a one-process run only in the order loans were summed. Throws
+/// std::invalid_argument if a part ran with other settings.
+[[nodiscard]] MonteCarloResult merge_partials(std::span<const MonteCarloPartial> parts,
+                                              const MonteCarloConfig& config);
+
+}  // namespace loansim
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace loansim {
+
+/// Threads to use when a caller passes 0: the hardware concurrency, or 1 if
+/// the platform cannot report it.
+[[nodiscard]] unsigned default_thread_count() noexcept;
+
+/// Runs `fn(task, worker)` for every task in [0, tasks) on up to `threads`
+/// workers (0 = default_thread_count()); `worker` is in [0, threads) and
+/// identifies per-worker scratch. The first exception thrown by a task is
+/// rethrown after all workers finish, and tasks not yet started are
+/// skipped.
+///
+/// The calling thread is worker 0; the rest come from a process-wide pool
+/// that is started on first use and kept, so calls cost no thread creation.
+/// Each worker starts on its own contiguous range of tasks, held in a
+/// Chase-Lev deque, and on running out steals single tasks from the far end
+/// of the others' ranges. Uneven tasks (long-term loan chunks, slow paths)
+/// therefore balance out without any tuning. Safe to call from several
+/// threads at once, and from inside a task.
+void parallel_for(std::size_t tasks, unsigned threads,
+                  const std::function<void(std::size_t task, unsigned worker)>& fn);
+
+}  // namespace loansim
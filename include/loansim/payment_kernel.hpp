@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "loansim/loan.hpp"
+
+namespace loansim {
+
+/// Instruction-set tiers for the vectorized kernels.
+enum class SimdLevel : int { scalar = 0, avx2 = 1, avx512 = 2 };
+
+[[nodiscard]] const char* to_string(SimdLevel level) noexcept;
+
+/// Best tier supported by both this build and the running CPU.
+[[nodiscard]] SimdLevel detect_simd_level() noexcept;
+
+/// Tier the kernels currently dispatch to. Defaults to detect_simd_level(),
+/// or to the `LOANSIM_SIMD` environment variable (`scalar`, `avx2`,
+/// `avx512`) when it names a supported tier.
+[[nodiscard]] SimdLevel simd_level() noexcept;
+
+/// Forces dispatch to `level`. Throws std::invalid_argument if the build or
+/// the CPU cannot run it.
+void set_simd_level(SimdLevel level);
+
+/// Level monthly payment of every loan, computed in closed form:
+/// `P * r / (1 - (1 + r)^-n)` with `r = annual_rate / 12`, or `P / n` for a
+/// zero rate. `(1 + r)^n` is evaluated by repeated squaring on the integer
+/// term, so no `pow` call is made and every SIMD tier returns bit-identical
+/// results to the scalar path.
+///
+/// Loans are assumed valid (see LoanColumns::validate). Throws
+/// std::invalid_argument if `payment` is not `loans.size()` long.
+void level_payments(const LoanColumns& loans, std::span<double> payment);
+
+/// Balance outstanding after `elapsed[i]` level payments of `payment[i]`:
+/// `P (1 + r)^k - A ((1 + r)^k - 1) / r`, or `P - A k` for a zero rate.
+/// Loans with `elapsed[i] >= term_months[i]` report zero.
+///
+/// Throws std::invalid_argument if any span is not `loans.size()` long.
+void remaining_balances(const LoanColumns& loans, std::span<const double> payment,
+                        std::span<const std::int32_t> elapsed,
+                        std::span<double> balance);
+
+}  // namespace loansim
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/arena.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/rate_paths.hpp"
+
+namespace loansim {
+
+/// Amortization products the batch engine specializes for.
+enum class Product : std::uint8_t {
+  fixed = 0,          ///< Level payment at the note rate for the whole term.
+  interest_only = 1,  ///< Interest only for `io_months`, then level payment.
+  arm = 2,            ///< Adjustable rate: index + margin, reset periodically.
+};
+
+[[nodiscard]] const char* to_string(Product product) noexcept;
+
+/// Parses `fixed`, `io` / `interest_only` or `arm`; throws
+/// std::invalid_argument otherwise.
+[[nodiscard]] Product parse_product(std::string_view name);
+
+/// Reset terms of an adjustable-rate loan. Rates are annual decimals.
+///
+/// The note rate applies until period `first_reset` (0-based, so 60 means
+/// the 61st payment). At each reset the rate becomes index + margin,
+/// limited to within `periodic_cap` of the previous rate and to
+/// [floor, lifetime_cap], and the payment is recast to amortize the
+/// current balance over the remaining term. Later resets follow every
+/// `reset_months`.
+struct ArmTerms {
+  std::int32_t first_reset = 60;
+  std::int32_t reset_months = 12;
+  double margin = 0.0275;
+  double periodic_cap = 0.02;
+  double lifetime_cap = std::numeric_limits<double>::infinity();
+  double floor = 0.0;
+
+  /// Throws std::invalid_argument on a non-positive reset schedule,
+  /// negative caps or a floor above the lifetime cap.
+  void validate() const;
+};
+
+/// Interest-only loans: columns of the loans plus their IO periods.
+struct InterestOnlyLoans {
+  LoanPool loans;
+  std::vector<std::int32_t> io_months;  ///< In [0, term_months).
+
+  [[nodiscard]] std::size_t size() const noexcept { return loans.size(); }
+};
+
+/// Adjustable-rate loans: columns of the loans plus their reset terms.
+struct ArmLoans {
+  LoanPool loans;  ///< `annual_rate` is the initial (pre-reset) rate.
+  std::vector<std::int32_t> first_reset;
+  std::vector<std::int32_t> reset_months;
+  std::vector<double> margin;
+  std::vector<double> periodic_cap;
+  std::vector<double> lifetime_cap;
+  std::vector<double> floor;
+
+  [[nodiscard]] std::size_t size() const noexcept { return loans.size(); }
+};
+
+/// A mixed book held as one column group per product.
+///
+/// Loans are routed to their product's group as they are added (normally
+/// while a tape is read, see CsvTapeReader::read_products()), so the
+/// engines run each group through a kernel instantiated for that product
+/// and the per-loan loops never branch on product type. Order within a
+/// group is insertion order; order across groups is not kept.
+class ProductBook {
+ public:
+  void add_fixed(double principal, double annual_rate, std::int32_t term_months);
+  void add_interest_only(double principal, double annual_rate, std::int32_t term_months,
+                         std::int32_t io_months);
+  void add_arm(double principal, double annual_rate, std::int32_t term_months,
+               const ArmTerms& terms);
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    return fixed_.size() + interest_only_.size() + arm_.size();
+  }
+  [[nodiscard]] std::size_t size(Product product) const noexcept;
+
+  [[nodiscard]] const LoanPool& fixed() const noexcept { return fixed_; }
+  [[nodiscard]] const InterestOnlyLoans& interest_only() const noexcept {
+    return interest_only_;
+  }
+  [[nodiscard]] const ArmLoans& arm() const noexcept { return arm_; }
+
+ private:
+  LoanPool fixed_;
+  InterestOnlyLoans interest_only_;
+  ArmLoans arm_;
+};
+
+/// aggregate_pool() over a mixed book. Each product group is reduced in
+/// kAggregateChunkLoans chunks with its own kernel; chunks are folded in
+/// a fixed order (fixed, interest-only, ARM, each in index order), so
+/// results do not depend on the thread count, and a book of fixed loans
+/// only matches aggregate_pool() bit for bit.
+///
+/// `index_path[t]` is the ARM index (annual) in effect at period t; the
+/// last value is held beyond its end. It may be empty only when the book
+/// has no ARMs.
+[[nodiscard]] PoolCashFlows aggregate_book(const ProductBook& book,
+                                           const CashFlowAssumptions& assumptions,
+                                           std::span<const double> index_path = {},
+                                           unsigned threads = 0,
+                                           RunArenas* arenas = nullptr);
+
+/// Mean of aggregate_book() over simulated rate paths, with each path's
+/// short rate plus `index_spread` as the ARM index. Fixed and
+/// interest-only groups do not depend on the index and are reduced once;
+/// ARM chunks run once per path, many paths at a time. Results do not
+/// depend on the thread count. Throws std::invalid_argument if `rates` is
+/// empty.
+[[nodiscard]] PoolCashFlows aggregate_book_paths(const ProductBook& book,
+                                                 const CashFlowAssumptions& assumptions,
+                                                 const RatePaths& rates,
+                                                 double index_spread = 0.0,
+                                                 unsigned threads = 0,
+                                                 RunArenas* arenas = nullptr);
+
+}  // namespace loansim
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace loansim {
+
+/// Dynamics of a one-factor short-rate model.
+enum class RateModel : std::uint8_t {
+  none,        ///< No simulated rates.
+  /// Hull-White with a flat target, dr = a (theta - r) dt + sigma dW,
+  /// stepped with its exact Gaussian transition.
+  hull_white,
+  /// Cox-Ingersoll-Ross, dr = kappa (theta - r) dt + sigma sqrt(r) dW,
+  /// stepped by full-truncation Euler; reported rates are never negative.
+  cir,
+};
+
+[[nodiscard]] const char* to_string(RateModel model) noexcept;
+/// Parses "none", "hull_white"/"hw" or "cir"; throws std::invalid_argument.
+[[nodiscard]] RateModel parse_rate_model(std::string_view name);
+
+/// A short-rate model and its parameters, all annual.
+struct ShortRateModel {
+  RateModel kind = RateModel::none;
+  double initial = 0.04;        ///< r_0, the rate in effect in period 0.
+  double mean_reversion = 0.1;  ///< a (Hull-White) or kappa (CIR).
+  double long_run = 0.04;       ///< theta, the level rates revert to.
+  double volatility = 0.01;     ///< sigma; scales sqrt(r) under CIR.
+
+  [[nodiscard]] bool enabled() const noexcept { return kind != RateModel::none; }
+
+  /// Throws std::invalid_argument on negative reversion or volatility, or
+  /// on a negative initial or long-run rate under CIR.
+  void validate() const;
+};
+
+/// Writes the monthly short rates of paths [first, first + count) to `out`,
+/// path-major: path first + k occupies out[k * periods, (k + 1) * periods),
+/// and its entry t is the annual rate in effect during period t (entry 0 is
+/// `model.initial`).
+///
+/// Path p draws its shocks from its own NormalStream of `seed`, disjoint
+/// from the streams simulate_pool() draws its factors from, so a path's
+/// rates depend only on (model, seed, p). With `antithetic`, path 2k + 1
+/// uses path 2k's shocks negated. Paths are stepped several at a time,
+/// one per vector lane, in `scratch` (at least rate_path_scratch(periods)
+/// doubles, e.g. from the worker's arena), so the call does not allocate.
+/// Throws std::invalid_argument if `out` or `scratch` is too small.
+void generate_rate_paths(const ShortRateModel& model, std::uint64_t seed, std::size_t first,
+                         std::size_t count, std::size_t periods, bool antithetic,
+                         std::span<double> out, std::span<double> scratch);
+
+/// Doubles of scratch generate_rate_paths() needs for `periods` months.
+[[nodiscard]] std::size_t rate_path_scratch(std::size_t periods) noexcept;
+
+/// Rate paths generated once and read by every loan that depends on them.
+class RatePaths {
+ public:
+  RatePaths() = default;
+  /// Generates `paths` paths of `periods` months (see
+  /// generate_rate_paths()), in parallel over `threads` (0 =
+  /// default_thread_count()). Throws std::invalid_argument if the model
+  /// is invalid or disabled.
+  RatePaths(const ShortRateModel& model, std::uint64_t seed, std::size_t paths,
+            std::size_t periods, unsigned threads = 0);
+
+  [[nodiscard]] std::size_t paths() const noexcept { return paths_; }
+  [[nodiscard]] std::size_t periods() const noexcept { return periods_; }
+  /// Path p's rate in each period.
+  [[nodiscard]] std::span<const double> path(std::size_t p) const noexcept {
+    return std::span<const double>(rates_).subspan(p * periods_, periods_);
+  }
+  /// Mean rate in each period across paths.
+  [[nodiscard]] std::vector<double> mean() const;
+
+ private:
+  std::size_t paths_ = 0;
+  std::size_t periods_ = 0;
+  std::vector<double> rates_;  // path-major
+};
+
+}  // namespace loansim
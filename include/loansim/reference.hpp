@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/monte_carlo.hpp"
+
+namespace loansim {
+
+/// A slow, extended-precision reference for the fast engines.
+///
+/// Everything here is computed one loan at a time in `long double`, in a
+/// single fixed order, with none of the engines' shortcuts: level payments
+/// use `powl`, and prepayments and defaults are applied to each loan's own
+/// balance (its payment recast in proportion) instead of scaling pool
+/// totals by a surviving fraction. It exists to be compared against; see
+/// tools/reference_check.
+
+/// Monthly level payment of one loan, `P r / (1 - (1 + r)^-n)` or `P / n`
+/// for a zero rate.
+[[nodiscard]] long double reference_level_payment(double principal, double annual_rate,
+                                                  std::int32_t term) noexcept;
+
+/// One loan's schedule, indexed by period.
+struct ReferenceSchedule {
+  std::vector<long double> payment;
+  std::vector<long double> interest;
+  std::vector<long double> principal;
+  std::vector<long double> balance;  ///< End of period.
+
+  [[nodiscard]] std::size_t periods() const noexcept { return interest.size(); }
+};
+
+/// The level-payment schedule of one loan over its `term`, the last
+/// payment retiring the balance. With `accrual` (one factor per period, as
+/// in AccrualTables::accrual()) period t's interest is scaled by
+/// `accrual[t]` and the payment stays the one set at origination.
+[[nodiscard]] ReferenceSchedule reference_schedule(double principal, double annual_rate,
+                                                   std::int32_t term,
+                                                   std::span<const double> accrual = {});
+
+/// Pool cash flows, the series of PoolCashFlows, in extended precision.
+struct ReferenceFlows {
+  std::vector<long double> interest;
+  std::vector<long double> scheduled_principal;
+  std::vector<long double> prepayment;
+  std::vector<long double> defaults;
+  std::vector<long double> loss;
+  std::vector<long double> balance;
+
+  [[nodiscard]] std::size_t periods() const noexcept { return interest.size(); }
+};
+
+/// aggregate_pool() computed loan by loan. Each period a loan first
+/// defaults at the monthly default rate, then pays interest and scheduled
+/// principal on what is left, then prepays at the monthly prepayment rate.
+/// Throws std::invalid_argument on invalid loans or assumptions.
+[[nodiscard]] ReferenceFlows reference_cash_flows(const LoanColumns& loans,
+                                                  const CashFlowAssumptions& assumptions);
+/// As above, with each loan's interest accrued by its `accrual` table.
+[[nodiscard]] ReferenceFlows reference_cash_flows(const LoanColumns& loans,
+                                                  const LoanAccrual& accrual,
+                                                  const CashFlowAssumptions& assumptions);
+
+/// One simulate_pool() path replayed loan by loan: its pool flows (summed,
+/// not averaged) and its totals.
+struct ReferencePath {
+  ReferenceFlows flows;
+  long double present_value = 0.0L;
+  long double total_loss = 0.0L;
+};
+
+/// Path `path` of simulate_pool(loans, config) in extended precision. The
+/// path sees the engine's economy, the same Philox normals and (with a
+/// rate model) the same short rates from generate_rate_paths(); every
+/// factor, discount and loan flow is then recomputed in `long double`,
+/// with reference_level_payment() for the payments. Only the
+/// pseudo-random sampler is replayed. Throws std::invalid_argument for
+/// Sampler::sobol, invalid loans or settings, or a path out of range.
+[[nodiscard]] ReferencePath reference_path(const LoanColumns& loans,
+                                           const MonteCarloConfig& config, std::size_t path);
+
+}  // namespace loansim
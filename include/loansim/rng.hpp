@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace loansim {
+
+/// Philox4x32-10 counter-based generator (Salmon et al., SC'11).
+///
+/// Output is a pure function of (key, counter): there is no hidden state to
+/// advance, so any draw can be produced by any thread in any order and the
+/// results never depend on how work was split.
+class Philox4x32 {
+ public:
+  using Counter = std::array<std::uint32_t, 4>;
+  using Block = std::array<std::uint32_t, 4>;
+
+  explicit constexpr Philox4x32(std::uint64_t seed) noexcept
+      : key_{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)} {}
+
+  [[nodiscard]] constexpr Block operator()(Counter ctr) const noexcept {
+    std::array<std::uint32_t, 2> key = key_;
+    for (int round = 0; round < 10; ++round) {
+      const std::uint64_t p0 = std::uint64_t{kM0} * ctr[0];
+      const std::uint64_t p1 = std::uint64_t{kM1} * ctr[2];
+      ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+             static_cast<std::uint32_t>(p1),
+             static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+             static_cast<std::uint32_t>(p0)};
+      key[0] += kW0;
+      key[1] += kW1;
+    }
+    return ctr;
+  }
+
+ private:
+  static constexpr std::uint32_t kM0 = 0xD2511F53u;
+  static constexpr std::uint32_t kM1 = 0xCD9E8D57u;
+  static constexpr std::uint32_t kW0 = 0x9E3779B9u;
+  static constexpr std::uint32_t kW1 = 0xBB67AE85u;
+
+  std::array<std::uint32_t, 2> key_;
+};
+
+/// Uniform in the open interval (0, 1) from 53 bits of two words.
+[[nodiscard]] constexpr double to_unit_interval(std::uint32_t hi, std::uint32_t lo) noexcept {
+  const std::uint64_t bits = (std::uint64_t{hi} << 21) ^ (lo >> 11);
+  return (static_cast<double>(bits) + 0.5) * 0x1.0p-53;
+}
+
+/// Standard normal quantile, accurate to double precision for u in (0, 1).
+[[nodiscard]] double inverse_normal(double u) noexcept;
+
+/// An independent, reproducible sequence of standard normals.
+///
+/// Stream `id` under a given seed always yields the same values; distinct
+/// ids never share a Philox counter. Draws are addressed by index, two
+/// normals per generator call.
+class NormalStream {
+ public:
+  constexpr NormalStream(std::uint64_t seed, std::uint64_t id) noexcept
+      : gen_(seed), id_(id) {}
+
+  /// Normals number 2*step and 2*step + 1 of this stream.
+  [[nodiscard]] std::array<double, 2> pair(std::uint64_t step) const noexcept {
+    const Philox4x32::Block b = gen_({static_cast<std::uint32_t>(step),
+                                      static_cast<std::uint32_t>(step >> 32),
+                                      static_cast<std::uint32_t>(id_),
+                                      static_cast<std::uint32_t>(id_ >> 32)});
+    return {inverse_normal(to_unit_interval(b[0], b[1])),
+            inverse_normal(to_unit_interval(b[2], b[3]))};
+  }
+
+ private:
+  Philox4x32 gen_;
+  std::uint64_t id_;
+};
+
+}  // namespace loansim
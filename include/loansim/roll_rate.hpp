@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loansim/arena.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+
+namespace loansim {
+
+/// States of the roll-rate engine. The first kLiveStates still carry a
+/// balance; `defaulted` and `prepaid` are absorbing.
+enum class DelinquencyState : std::uint8_t { current, dpd30, dpd60, dpd90, defaulted, prepaid };
+
+inline constexpr std::size_t kLiveStates = 4;
+inline constexpr std::size_t kDelinquencyStates = 6;
+
+[[nodiscard]] const char* to_string(DelinquencyState state) noexcept;
+/// Parses a state name ("current", "dpd30", "dpd60", "dpd90", "default",
+/// "prepaid") or the day counts "0", "30", "60", "90"; throws
+/// std::invalid_argument.
+[[nodiscard]] DelinquencyState parse_delinquency_state(std::string_view name);
+
+/// Monthly transition probabilities of one cohort: `rows[from][to]`, from
+/// each live state to every state. Each row sums to one.
+struct TransitionMatrix {
+  std::array<std::array<double, kDelinquencyStates>, kLiveStates> rows{};
+
+  /// Throws std::invalid_argument unless every entry is in [0, 1] and
+  /// every row sums to one within 1e-9.
+  void validate() const;
+};
+
+struct RollRateConfig {
+  std::vector<TransitionMatrix> matrices;  ///< Indexed by cohort.
+  double severity = 0.35;                  ///< Loss given default, in [0, 1].
+  unsigned threads = 0;                    ///< 0 = default_thread_count().
+
+  /// Throws std::invalid_argument on an invalid matrix or severity, or
+  /// with no matrices.
+  void validate() const;
+};
+
+struct RollRateResult {
+  PoolCashFlows flows;
+  /// Balance in each live state at period end (the delinquency pipeline),
+  /// indexed by DelinquencyState.
+  std::array<std::vector<double>, kLiveStates> state_balance;
+};
+
+/// Pool cash flows under cohort Markov roll rates.
+///
+/// Each month a loan moves between states by its cohort's matrix. Timing
+/// follows apply_assumptions(): a loan that defaults does so on its
+/// opening balance; every other loan live at the start of the month pays
+/// its scheduled interest and principal (servicers advance them while a
+/// loan is delinquent, so live balances stay on schedule); loans that
+/// prepay then repay their closing balance.
+///
+/// Under those rules a loan's expected flows are its state distribution
+/// times its scheduled flows, and every loan in a cohort that starts in
+/// the same state shares that distribution. So loans are grouped by
+/// (cohort, starting state), each group's scheduled totals are reduced
+/// once, and the Markov step runs on one state vector per group, batched
+/// across groups, instead of on every loan. The result equals the
+/// loan-by-loan expectation.
+///
+/// `cohorts[i]` indexes `config.matrices` and `initial[i]` is loan i's
+/// state, which must be live; either span may be empty, meaning cohort 0
+/// or `current` for every loan. Throws std::invalid_argument on a length
+/// mismatch or an out-of-range cohort or state. Group totals come from
+/// `arenas` when given.
+[[nodiscard]] RollRateResult run_roll_rates(const LoanColumns& loans,
+                                            std::span<const std::uint32_t> cohorts,
+                                            std::span<const DelinquencyState> initial,
+                                            const RollRateConfig& config,
+                                            RunArenas* arenas = nullptr);
+
+/// Reads cohort matrices from a CSV file with the header
+/// `cohort,from,current,dpd30,dpd60,dpd90,default,prepaid` and one row per
+/// cohort and live `from` state. Cohorts must be numbered from 0 without
+/// gaps, each with all four rows, so a cohort number beyond what the file's
+/// rows can hold is rejected on its line. Throws std::runtime_error naming the
+/// line on malformed input; the matrices are validated.
+[[nodiscard]] std::vector<TransitionMatrix> read_transition_matrices(const std::string& path);
+
+}  // namespace loansim
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include "loansim/arena.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/loan.hpp"
+
+namespace loansim {
+
+/// Structure-of-arrays amortization schedules for a batch of loans.
+///
+/// Each field is stored period-major: the value for (period, loan) lives at
+/// `period * loans() + loan`, so a row is one period across every loan and
+/// the per-period loop over loans is contiguous. Periods past a loan's term
+/// hold zeros. Storage comes from the memory resource given at construction,
+/// e.g. a run's Arena.
+class ScheduleBuffers {
+ public:
+  ScheduleBuffers() = default;
+  explicit ScheduleBuffers(std::pmr::memory_resource* resource)
+      : payment_(resource), interest_(resource), principal_(resource), balance_(resource) {}
+  ScheduleBuffers(std::size_t loans, std::size_t periods,
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : ScheduleBuffers(resource) {
+    resize(loans, periods);
+  }
+
+  /// Reshapes the buffers; contents are unspecified until the next build.
+  void resize(std::size_t loans, std::size_t periods);
+
+  [[nodiscard]] std::size_t loans() const noexcept { return loans_; }
+  [[nodiscard]] std::size_t periods() const noexcept { return periods_; }
+  /// Where the buffers are allocated.
+  [[nodiscard]] std::pmr::memory_resource* resource() const noexcept {
+    return payment_.get_allocator().resource();
+  }
+
+  /// Row accessors: one period across all loans.
+  [[nodiscard]] std::span<double> payment(std::size_t period) { return row(payment_, period); }
+  [[nodiscard]] std::span<double> interest(std::size_t period) { return row(interest_, period); }
+  [[nodiscard]] std::span<double> principal(std::size_t period) { return row(principal_, period); }
+  [[nodiscard]] std::span<double> balance(std::size_t period) { return row(balance_, period); }
+
+  [[nodiscard]] std::span<const double> payment(std::size_t period) const { return row(payment_, period); }
+  [[nodiscard]] std::span<const double> interest(std::size_t period) const { return row(interest_, period); }
+  [[nodiscard]] std::span<const double> principal(std::size_t period) const { return row(principal_, period); }
+  [[nodiscard]] std::span<const double> balance(std::size_t period) const { return row(balance_, period); }
+
+  /// Whole columns, `periods() * loans()` values each.
+  [[nodiscard]] std::span<const double> payment_column() const noexcept { return payment_; }
+  [[nodiscard]] std::span<const double> interest_column() const noexcept { return interest_; }
+  [[nodiscard]] std::span<const double> principal_column() const noexcept { return principal_; }
+  [[nodiscard]] std::span<const double> balance_column() const noexcept { return balance_; }
+
+ private:
+  [[nodiscard]] std::span<double> row(std::pmr::vector<double>& v, std::size_t period) {
+    return {v.data() + period * loans_, loans_};
+  }
+  [[nodiscard]] std::span<const double> row(const std::pmr::vector<double>& v,
+                                            std::size_t period) const {
+    return {v.data() + period * loans_, loans_};
+  }
+
+  std::size_t loans_ = 0;
+  std::size_t periods_ = 0;
+  std::pmr::vector<double> payment_;
+  std::pmr::vector<double> interest_;
+  std::pmr::vector<double> principal_;
+  std::pmr::vector<double> balance_;
+};
+
+/// Longest term in the batch, i.e. the number of schedule periods needed.
+[[nodiscard]] std::size_t max_term(const LoanColumns& loans) noexcept;
+
+/// Fills `out` with level-payment amortization schedules for every loan.
+///
+/// `out` is resized to `loans.size()` x `max_term(loans)`. Balances are end
+/// of period; the final payment of each loan retires its remaining balance
+/// exactly. Per-loan working state is taken from `arenas` when given.
+/// Throws std::invalid_argument if `loans` fails validation.
+void build_schedules(const LoanColumns& loans, ScheduleBuffers& out,
+                     RunArenas* arenas = nullptr);
+
+/// build_schedules() with each loan's interest accrued by its dated table
+/// (see AccrualTables); payments stay level. Also throws
+/// std::invalid_argument if `accrual` does not cover `loans`.
+void build_schedules(const LoanColumns& loans, const LoanAccrual& accrual, ScheduleBuffers& out,
+                     RunArenas* arenas = nullptr);
+
+}  // namespace loansim
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+
+#include "loansim/loan.hpp"
+#include "loansim/mapped_file.hpp"
+
+namespace loansim {
+
+/// How schedule chunks are stored on disk.
+enum class ScheduleCompression : std::uint32_t {
+  none = 0,
+  /// Each value is XORed with the same loan's previous-period value, the
+  /// results are split into byte planes (all first bytes, then all second
+  /// bytes, ...) and deflated with zlib. Slowly varying balances and level
+  /// payments leave long zero runs in the high planes; about 2x smaller
+  /// than raw doubles.
+  delta_deflate = 1,
+};
+
+[[nodiscard]] const char* to_string(ScheduleCompression compression) noexcept;
+
+/// Whether this build can write and read `compression` (deflate needs zlib).
+[[nodiscard]] bool compression_supported(ScheduleCompression compression) noexcept;
+
+struct ScheduleWriterOptions {
+  /// Loans per chunk. Peak memory is about two chunks of schedules
+  /// (4 x 8 bytes x loans x periods each) plus, when compressing, one
+  /// chunk's compression buffers, whatever the pool size.
+  std::size_t chunk_loans = 2'048;
+  ScheduleCompression compression = ScheduleCompression::none;
+
+  /// Throws std::invalid_argument for a zero chunk size or a compression
+  /// mode this build does not support.
+  void validate() const;
+};
+
+/// Totals reported by write_schedules().
+struct ScheduleWriteStats {
+  std::size_t loans = 0;
+  std::size_t chunks = 0;
+  std::uint64_t raw_bytes = 0;     ///< Schedule payload before compression.
+  std::uint64_t stored_bytes = 0;  ///< File size, headers included.
+};
+
+/// Writes full per-loan amortization schedules for `loans` to `path` as a
+/// binary columnar schedule file.
+///
+/// The pool is processed in chunks of `chunk_loans`. Each chunk's schedules
+/// are built into one of two buffers while a background thread compresses
+/// and writes the other, so computation and I/O overlap and memory stays
+/// bounded by the chunk size. Chunks hold payment, interest, principal and
+/// balance columns, period-major as in ScheduleBuffers, over that chunk's
+/// longest term. Throws std::invalid_argument for invalid loans or options
+/// and std::runtime_error on I/O failure.
+ScheduleWriteStats write_schedules(const LoanColumns& loans, const std::string& path,
+                                   const ScheduleWriterOptions& options = {});
+
+/// One chunk of a schedule file: loans [first_loan, first_loan + loans),
+/// each column `periods * loans` values, period-major.
+struct ScheduleChunk {
+  std::size_t first_loan = 0;
+  std::size_t loans = 0;
+  std::size_t periods = 0;
+  std::span<const double> payment;
+  std::span<const double> interest;
+  std::span<const double> principal;
+  std::span<const double> balance;
+};
+
+/// Sequential reader for files produced by write_schedules().
+class ScheduleFileReader {
+ public:
+  /// Maps `path` and validates its header; throws std::runtime_error if it
+  /// is not a schedule file or uses a compression this build lacks.
+  explicit ScheduleFileReader(const std::string& path);
+
+  [[nodiscard]] std::size_t loans() const noexcept { return loans_; }
+  [[nodiscard]] std::size_t chunks() const noexcept { return chunks_; }
+  [[nodiscard]] ScheduleCompression compression() const noexcept { return compression_; }
+
+  /// Calls `fn` for every chunk in file order. Uncompressed chunks point
+  /// into the mapping; compressed ones are inflated into reusable buffers.
+  /// Either way the spans are valid only during the call.
+  void for_each_chunk(const std::function<void(const ScheduleChunk& chunk)>& fn) const;
+
+ private:
+  std::string path_;
+  MappedFile file_;
+  std::size_t loans_ = 0;
+  std::size_t chunks_ = 0;
+  ScheduleCompression compression_ = ScheduleCompression::none;
+};
+
+}  // namespace loansim
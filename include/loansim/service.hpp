@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loansim/arena.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/scenario_grid.hpp"
+#include "loansim/stats.hpp"
+
+namespace loansim {
+
+/// What the service did with one request, passed to ServiceConfig::on_request.
+struct RequestRecord {
+  std::string command;      ///< First word of the request line.
+  std::size_t scenarios = 0;
+  double latency_seconds = 0.0;  ///< From the request line read to the reply sent.
+  bool ok = true;
+};
+
+struct ServiceConfig {
+  std::string socket_path;
+  /// Worker threads each request may use (0 = default_thread_count()).
+  /// Concurrent requests share the process-wide pool of parallel_for().
+  unsigned threads_per_request = 0;
+  /// Model defaults for `grid` requests; a request may override any of
+  /// base_cpr, refi_sensitivity, market_rate and price.
+  ScenarioGridConfig grid;
+  /// Called after every request, from the connection's thread.
+  std::function<void(const RequestRecord&)> on_request;
+
+  /// Throws std::invalid_argument for an empty or over-long socket path.
+  void validate() const;
+};
+
+/// Latency summary over every request served so far.
+struct ServiceStats {
+  std::uint64_t requests = 0;
+  std::uint64_t failed = 0;
+  RunningStats latency;  ///< Seconds.
+  double max_latency = 0.0;
+};
+
+/// A daemon that keeps one PreparedPool resident and answers scenario
+/// requests on a Unix-domain stream socket.
+///
+/// The pool is prepared once and only read afterwards, so every connection
+/// runs its requests against it concurrently, each on its own thread with
+/// its own RunArenas (reused from one request to the next). The protocol is
+/// line-based text; every request gets a reply ending in a line that starts
+/// with `ok` or `error`:
+///
+///     info                          -> ok loans=N periods=P
+///     grid [key=value ...]          -> one tab-separated line per scenario
+///                                      (name, pv, prepaid, loss, yield,
+///                                      modified duration, WAL), then
+///                                      ok scenarios=N latency_ms=X
+///     stats                         -> ok requests=N failed=F mean_ms=X max_ms=X
+///     shutdown                      -> ok; the service stops
+///
+/// `grid` keys: shocks (basis points) and speeds (comma-separated lists),
+/// cdr, severity, price, base_cpr, refi_sensitivity, market_rate, batch.
+class SimulationService {
+ public:
+  /// Validates and prepares `loans`; the columns are copied, so the tape
+  /// they came from may be closed afterwards.
+  SimulationService(const LoanColumns& loans, ServiceConfig config);
+  ~SimulationService();
+
+  SimulationService(const SimulationService&) = delete;
+  SimulationService& operator=(const SimulationService&) = delete;
+
+  /// Binds the socket (replacing a stale socket file) and serves until
+  /// stop() or a `shutdown` request, then waits for open connections to
+  /// finish their current request. Running out of descriptors, memory or
+  /// threads delays new connections rather than ending the service. Throws
+  /// std::system_error if the socket cannot be set up (including when the
+  /// path exists and is not a socket) or accepting fails otherwise; open
+  /// connections are finished first.
+  void serve();
+
+  /// Makes serve() return. Safe from any thread; idempotent.
+  void stop() noexcept;
+
+  /// Answers one request line as serve() would, without a socket. The
+  /// reply has one `\n`-terminated line per output line.
+  [[nodiscard]] std::string handle(std::string_view request, RunArenas& arenas);
+
+  [[nodiscard]] const PreparedPool& pool() const noexcept { return pool_; }
+  [[nodiscard]] ServiceStats stats() const;
+
+ private:
+  std::string respond(std::string_view request, RunArenas& arenas, RequestRecord& rec);
+  void serve_connection(int fd);
+  void record(const RequestRecord& r);
+
+  PreparedPool pool_;
+  ServiceConfig config_;
+  std::atomic<bool> stopping_{false};
+  std::mutex listen_mutex_;
+  int listen_fd_ = -1;  // guarded by listen_mutex_
+  mutable std::mutex stats_mutex_;
+  ServiceStats stats_;
+};
+
+/// Sends one request line to the service at `socket_path` and returns its
+/// full reply. Throws std::system_error if the service cannot be reached.
+[[nodiscard]] std::string service_request(const std::string& socket_path,
+                                          std::string_view request);
+
+}  // namespace loansim
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/arena.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/monte_carlo.hpp"
+
+namespace loansim {
+
+/// How partition_pool() assigns loans to shards.
+enum class ShardKey : std::uint8_t {
+  range,  ///< Contiguous runs of the tape, sizes within one loan of each other.
+  hash,   ///< By a hash of the loan's tape index, spreading any ordering evenly.
+};
+
+[[nodiscard]] const char* to_string(ShardKey key) noexcept;
+/// Parses "range" or "hash"; throws std::invalid_argument.
+[[nodiscard]] ShardKey parse_shard_key(std::string_view name);
+
+/// Splits `loans` into `shards` disjoint pools that together hold every
+/// loan once, each in tape order. Shards may be empty when there are fewer
+/// loans than shards. Throws std::invalid_argument if `shards` is 0.
+[[nodiscard]] std::vector<LoanPool> partition_pool(const LoanColumns& loans, std::size_t shards,
+                                                   ShardKey key);
+
+/// Everything one shard contributes to a whole-pool run. Both parts are
+/// additive over loans: scheduled totals per period, and Monte Carlo path
+/// values (see MonteCarloPartial).
+struct ShardResult {
+  std::uint64_t loans = 0;
+  ScheduledTotals scheduled;
+  MonteCarloPartial monte_carlo;
+};
+
+/// Runs one shard: its scheduled totals and a partial Monte Carlo run.
+[[nodiscard]] ShardResult run_shard(const LoanColumns& loans, const MonteCarloConfig& config,
+                                    RunArenas* arenas = nullptr);
+
+/// Writes `result` as a little-endian binary file. Throws
+/// std::runtime_error on I/O failure.
+void write_shard_result(const ShardResult& result, const std::string& path);
+/// Reads a file written by write_shard_result(). Throws std::runtime_error
+/// for a missing, truncated or foreign file.
+[[nodiscard]] ShardResult read_shard_result(const std::string& path);
+
+/// A whole-pool result assembled from shards.
+struct MergedResult {
+  std::uint64_t loans = 0;
+  PoolCashFlows cash_flows;  ///< aggregate_pool() of the whole pool.
+  MonteCarloResult monte_carlo;
+};
+
+/// Merges the shards of one pool, all run with `config`. Scheduled totals
+/// are added in shard order before `assumptions` are applied, and Monte
+/// Carlo partials go through merge_partials(), so nothing is approximated:
+/// the result is the whole-pool computation with loans summed shard by
+/// shard. It is deterministic for a given partition; a single shard gives
+/// simulate_pool()'s bits. Throws std::invalid_argument if a shard ran with
+/// other settings.
+[[nodiscard]] MergedResult merge_shards(std::span<const ShardResult> shards,
+                                        const CashFlowAssumptions& assumptions,
+                                        const MonteCarloConfig& config);
+
+}  // namespace loansim
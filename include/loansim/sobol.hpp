@@ -0,0 +1,51 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace loansim {
+
+/// Sobol' low-discrepancy points in [0, 1)^d, base 2, 32 bits per coordinate.
+///
+/// Coordinate 0 is the van der Corput sequence; coordinate j > 0 uses the
+/// j-th primitive polynomial over GF(2) (ordered by degree, then value) and
+/// initial direction numbers drawn from a fixed Philox stream. They are
+/// valid Sobol' direction numbers but not the search-optimized Joe-Kuo
+/// tables, so uniformity in high coordinates is weaker; callers randomize
+/// with a digital shift and estimate error across shifts.
+///
+/// Points are addressed by index, like NormalStream draws, so any thread
+/// can produce any point and results never depend on how work was split.
+class SobolSequence {
+ public:
+  /// Largest supported dimension count (primitive polynomials of degree
+  /// up to 16).
+  static constexpr std::size_t kMaxDimensions = 4'096;
+
+  /// Throws std::invalid_argument if `dimensions` is 0 or above kMaxDimensions.
+  explicit SobolSequence(std::size_t dimensions);
+
+  [[nodiscard]] std::size_t dimensions() const noexcept { return dimensions_; }
+
+  /// Coordinate `dim` of point `index`, as the 32 leading binary digits.
+  [[nodiscard]] std::uint32_t bits(std::uint32_t index, std::size_t dim) const noexcept {
+    const std::uint32_t* v = &directions_[dim * 32];
+    std::uint32_t x = 0;
+    for (; index != 0; index &= index - 1) x ^= v[std::countr_zero(index)];
+    return x;
+  }
+
+ private:
+  std::size_t dimensions_;
+  std::vector<std::uint32_t> directions_;  // dimension-major, 32 per dimension
+};
+
+/// Uniform in (0, 1) from a shifted Sobol' coordinate: the cell midpoint,
+/// so 0 and 1 are never returned.
+[[nodiscard]] constexpr double sobol_unit(std::uint32_t bits, std::uint32_t shift) noexcept {
+  return (static_cast<double>(bits ^ shift) + 0.5) * 0x1.0p-32;
+}
+
+}  // namespace loansim
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace loansim {
+
+/// Count, mean and sum of squared deviations of a sample (Welford), with
+/// the pairwise merge of Chan et al. Merging partial stats in a fixed order
+/// gives the same bits no matter how the sample was partitioned into work.
+struct RunningStats {
+  std::uint64_t count = 0;
+  double mean = 0.0;
+  double m2 = 0.0;
+
+  void add(double x) noexcept {
+    ++count;
+    const double delta = x - mean;
+    mean += delta / static_cast<double>(count);
+    m2 += delta * (x - mean);
+  }
+
+  void merge(const RunningStats& other) noexcept {
+    if (other.count == 0) return;
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+    const double n_a = static_cast<double>(count);
+    const double n_b = static_cast<double>(other.count);
+    const double n = n_a + n_b;
+    const double delta = other.mean - mean;
+    mean += delta * n_b / n;
+    m2 += other.m2 + delta * delta * n_a * n_b / n;
+    count += other.count;
+  }
+
+  [[nodiscard]] double variance() const noexcept {
+    return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0;
+  }
+
+  /// Standard error of the mean.
+  [[nodiscard]] double std_error() const noexcept {
+    return count > 1 ? std::sqrt(variance() / static_cast<double>(count)) : 0.0;
+  }
+};
+
+/// RunningStats of two paired samples plus their co-moment, mergeable in
+/// the same way.
+struct RunningCovariance {
+  RunningStats x;
+  RunningStats y;
+  double c = 0.0;  ///< Sum of (x - mean x)(y - mean y).
+
+  void add(double a, double b) noexcept {
+    const double dx = a - x.mean;
+    x.add(a);
+    y.add(b);
+    c += dx * (b - y.mean);
+  }
+
+  void merge(const RunningCovariance& other) noexcept {
+    if (other.x.count == 0) return;
+    if (x.count == 0) {
+      *this = other;
+      return;
+    }
+    const double n_a = static_cast<double>(x.count);
+    const double n_b = static_cast<double>(other.x.count);
+    c += other.c + (other.x.mean - x.mean) * (other.y.mean - y.mean) * n_a * n_b / (n_a + n_b);
+    x.merge(other.x);
+    y.merge(other.y);
+  }
+
+  [[nodiscard]] double covariance() const noexcept {
+    return x.count > 1 ? c / static_cast<double>(x.count - 1) : 0.0;
+  }
+};
+
+}  // namespace loansim
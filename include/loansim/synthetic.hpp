@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "loansim/loan.hpp"
+
+namespace loansim {
+
+/// A reproducible pool shaped like a residential mortgage book: balances of
+/// $50K-$950K, note rates of 2.5%-8% in 1/8 steps, mostly 360- and 180-month
+/// originals seasoned up to five years. Loan i depends only on (seed, i),
+/// via Philox, so the same arguments give the same pool on every platform.
+[[nodiscard]] LoanPool make_synthetic_pool(std::size_t loans, std::uint64_t seed = 42);
+
+}  // namespace loansim
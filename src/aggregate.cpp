@@ -0,0 +1,157 @@
+#include "loansim/aggregate.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "loansim/instrument.hpp"
+#include "loansim/parallel.hpp"
+#include "loansim/schedule.hpp"
+
+#include "amortize_block.hpp"
+
+namespace loansim {
+namespace {
+
+std::atomic<bool> term_kernels_enabled{true};
+
+double monthly_rate(double annual) { return 1.0 - std::pow(1.0 - annual, 1.0 / 12.0); }
+
+/// Reduces `loans` loans in kAggregateChunkLoans chunks, `accumulate(begin,
+/// end, out)` adding one chunk's totals, and folds them in chunk order.
+template <class Accumulate>
+ScheduledTotals reduce_chunks(std::size_t loans, std::size_t periods, unsigned threads,
+                              RunArenas* arenas, const Accumulate& accumulate) {
+  const std::size_t chunks = (loans + kAggregateChunkLoans - 1) / kAggregateChunkLoans;
+  // Partials are sized up front on this thread so workers never allocate.
+  std::pmr::vector<ScheduledTotals> partial(shared_resource(arenas));
+  partial.reserve(chunks);
+  for (std::size_t c = 0; c < chunks; ++c) {
+    partial.emplace_back(shared_resource(arenas)).resize(periods);
+  }
+  parallel_for(chunks, threads, [&](std::size_t chunk, unsigned) {
+    const std::size_t begin = chunk * kAggregateChunkLoans;
+    accumulate(begin, std::min(begin + kAggregateChunkLoans, loans), partial[chunk]);
+  });
+
+  ScheduledTotals total;
+  total.resize(periods);
+  for (const ScheduledTotals& p : partial) total.add(p);
+  return total;
+}
+
+}  // namespace
+
+void CashFlowAssumptions::validate() const {
+  if (!(cpr >= 0.0 && cpr < 1.0)) throw std::invalid_argument("CashFlowAssumptions: cpr");
+  if (!(cdr >= 0.0 && cdr < 1.0)) throw std::invalid_argument("CashFlowAssumptions: cdr");
+  if (!(severity >= 0.0 && severity <= 1.0)) {
+    throw std::invalid_argument("CashFlowAssumptions: severity");
+  }
+}
+
+void ScheduledTotals::resize(std::size_t periods) {
+  for (std::pmr::vector<double>* v : {&interest, &principal, &opening_balance, &closing_balance}) {
+    v->resize(periods, 0.0);
+  }
+}
+
+void ScheduledTotals::add(const ScheduledTotals& other) {
+  if (other.periods() > periods()) resize(other.periods());
+  for (std::size_t t = 0; t < other.periods(); ++t) {
+    interest[t] += other.interest[t];
+    principal[t] += other.principal[t];
+    opening_balance[t] += other.opening_balance[t];
+    closing_balance[t] += other.closing_balance[t];
+  }
+}
+
+bool term_kernels() noexcept { return term_kernels_enabled.load(std::memory_order_relaxed); }
+
+void set_term_kernels(bool enabled) noexcept {
+  term_kernels_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void accumulate_scheduled(const LoanColumns& loans, ScheduledTotals& out) {
+  out.resize(std::max(out.periods(), max_term(loans)));
+  detail::AmortizeBlock block;
+  detail::LevelPolicy level;
+  detail::for_each_block(loans.term_months, [&](std::span<const std::uint32_t> rows) {
+    block = {};
+    block.load(loans, rows);
+    detail::amortize_block(block, level, out);
+  });
+}
+
+void accumulate_scheduled(const LoanColumns& loans, const LoanAccrual& accrual,
+                          ScheduledTotals& out) {
+  out.resize(std::max(out.periods(), max_term(loans)));
+  detail::AmortizeBlock block;
+  detail::for_each_block(loans.term_months, [&](std::span<const std::uint32_t> rows) {
+    block = {};
+    block.load(loans, rows);
+    detail::AccrualPolicy policy(block, accrual, rows);
+    detail::amortize_block(block, policy, out);
+  });
+}
+
+PoolCashFlows apply_assumptions(const ScheduledTotals& scheduled,
+                                const CashFlowAssumptions& assumptions) {
+  assumptions.validate();
+  const double smm = monthly_rate(assumptions.cpr);
+  const double mdr = monthly_rate(assumptions.cdr);
+  PoolCashFlows flows(scheduled.periods());
+  double surviving = 1.0;  // fraction of the scheduled balance still performing
+  for (std::size_t t = 0; t < scheduled.periods(); ++t) {
+    const double alive = surviving * (1.0 - mdr);
+    flows.defaults[t] = scheduled.opening_balance[t] * surviving * mdr;
+    flows.loss[t] = flows.defaults[t] * assumptions.severity;
+    flows.interest[t] = scheduled.interest[t] * alive;
+    flows.scheduled_principal[t] = scheduled.principal[t] * alive;
+    flows.prepayment[t] = scheduled.closing_balance[t] * alive * smm;
+    surviving = alive * (1.0 - smm);
+    flows.balance[t] = scheduled.closing_balance[t] * surviving;
+  }
+  return flows;
+}
+
+ScheduledTotals scheduled_totals(const LoanColumns& loans, unsigned threads, RunArenas* arenas) {
+  loans.validate();
+  return reduce_chunks(loans.size(), max_term(loans), threads, arenas,
+                       [&](std::size_t begin, std::size_t end, ScheduledTotals& out) {
+                         accumulate_scheduled(loans.slice(begin, end), out);
+                       });
+}
+
+ScheduledTotals scheduled_totals(const LoanColumns& loans, const LoanAccrual& accrual,
+                                 unsigned threads, RunArenas* arenas) {
+  loans.validate();
+  const std::size_t periods = max_term(loans);
+  accrual.validate(loans.size(), periods);
+  return reduce_chunks(loans.size(), periods, threads, arenas,
+                       [&](std::size_t begin, std::size_t end, ScheduledTotals& out) {
+                         accumulate_scheduled(loans.slice(begin, end), accrual.slice(begin, end),
+                                              out);
+                       });
+}
+
+PoolCashFlows aggregate_pool(const LoanColumns& loans, const CashFlowAssumptions& assumptions,
+                             unsigned threads, RunArenas* arenas) {
+  assumptions.validate();
+  const StageScope scope(Stage::aggregate, loans.size(), arenas);
+  return apply_assumptions(scheduled_totals(loans, threads, arenas), assumptions);
+}
+
+PoolCashFlows aggregate_pool(const LoanColumns& loans, const LoanAccrual& accrual,
+                             const CashFlowAssumptions& assumptions, unsigned threads,
+                             RunArenas* arenas) {
+  assumptions.validate();
+  const StageScope scope(Stage::aggregate, loans.size(), arenas);
+  return apply_assumptions(scheduled_totals(loans, accrual, threads, arenas), assumptions);
+}
+
+}  // namespace loansim
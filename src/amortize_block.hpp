@@ -0,0 +1,231 @@
+#pragma once
+
+// Internal: the cache-resident block stepper behind accumulate_scheduled()
+// and the per-product kernels in products.cpp.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/loan.hpp"
+#include "loansim/payment_kernel.hpp"
+
+#include "lane_sum.hpp"
+
+namespace loansim::detail {
+
+// A block's per-loan state (a few arrays of kAmortizeBlock doubles) stays
+// in L1 while it is stepped through every period.
+inline constexpr std::size_t kAmortizeBlock = 256;
+
+// Loans that for_each_block() orders by term at a time: enough that a
+// block rarely spans more than a few adjacent terms, small enough that the
+// sort keys stay on the stack.
+inline constexpr std::size_t kTermWindow = 16 * kAmortizeBlock;
+
+/// Per-loan state of one block. Lanes past `n` stay zero-balance with term
+/// 0, so they contribute nothing to any sum.
+struct AmortizeBlock {
+  alignas(64) std::array<double, kAmortizeBlock> bal{};
+  alignas(64) std::array<double, kAmortizeBlock> rate{};   // monthly
+  alignas(64) std::array<double, kAmortizeBlock> level{};
+  alignas(64) std::array<double, kAmortizeBlock> term{};   // as double: keeps selects one width
+  alignas(64) std::array<double, kAmortizeBlock> interest{};
+  alignas(64) std::array<double, kAmortizeBlock> principal{};
+  std::size_t n = 0;
+  std::size_t padded = 0;
+  std::int32_t shortest = 0;
+  std::int32_t longest = 0;
+
+  /// Loads loans `rows` of `loans` (at most kAmortizeBlock), in that
+  /// order, with level payments over each loan's full term.
+  void load(const LoanColumns& loans, std::span<const std::uint32_t> rows) {
+    alignas(64) std::array<double, kAmortizeBlock> annual;
+    alignas(64) std::array<std::int32_t, kAmortizeBlock> months;
+    n = rows.size();
+    padded = pad_to_lanes(n);
+    shortest = n > 0 ? loans.term_months[rows[0]] : 0;
+    longest = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t r = rows[i];
+      bal[i] = loans.principal[r];
+      annual[i] = loans.annual_rate[r];
+      months[i] = loans.term_months[r];
+      rate[i] = annual[i] / 12.0;
+      term[i] = months[i];
+      shortest = std::min(shortest, months[i]);
+      longest = std::max(longest, months[i]);
+    }
+    level_payments(LoanColumns{{bal.data(), n}, {annual.data(), n}, {months.data(), n}},
+                   std::span<double>(level.data(), n));
+  }
+};
+
+/// Calls `visit(rows)` for successive blocks of at most kAmortizeBlock of
+/// the loans whose terms are `terms`, `rows` indexing into `terms`. Each
+/// kTermWindow loans are ordered by (term, index), so a block holds one
+/// term or a few adjacent ones however the tape interleaves them. The
+/// order depends only on the terms, never on the thread count or
+/// term_kernels().
+template <class Visit>
+void for_each_block(std::span<const std::int32_t> terms, Visit&& visit) {
+  std::array<std::uint64_t, kTermWindow> keys;
+  std::array<std::uint32_t, kAmortizeBlock> rows;
+  for (std::size_t w = 0; w < terms.size(); w += kTermWindow) {
+    const std::size_t count = std::min(kTermWindow, terms.size() - w);
+    for (std::size_t i = 0; i < count; ++i) {
+      keys[i] = std::uint64_t{static_cast<std::uint32_t>(terms[w + i])} << 32 | i;
+    }
+    std::sort(keys.begin(), keys.begin() + count);
+    for (std::size_t b = 0; b < count; b += kAmortizeBlock) {
+      const std::size_t m = std::min(kAmortizeBlock, count - b);
+      for (std::size_t k = 0; k < m; ++k) {
+        rows[k] = static_cast<std::uint32_t>(w + (keys[b + k] & 0xFFFF'FFFFu));
+      }
+      visit(std::span<const std::uint32_t>(rows.data(), m));
+    }
+  }
+}
+
+/// Product policy for level-payment loans: nothing changes between periods.
+struct LevelPolicy {
+  void before_period(AmortizeBlock&, std::int32_t) {}
+  [[nodiscard]] double principal(std::size_t, double, double scheduled) const {
+    return scheduled;
+  }
+};
+
+/// Policy for loans with dated accrual: before each period every lane's
+/// monthly rate is scaled by its accrual factor, looked up in the shared
+/// tables. The level payment stays the one set at origination.
+class AccrualPolicy {
+ public:
+  /// `rows` are the block's loans, as passed to AmortizeBlock::load().
+  AccrualPolicy(const AmortizeBlock& s, const LoanAccrual& accrual,
+                std::span<const std::uint32_t> rows)
+      : data_(accrual.tables->accrual_data().data()), periods_(accrual.tables->periods()) {
+    for (std::size_t k = 0; k < s.n; ++k) {
+      monthly_[k] = s.rate[k];
+      offset_[k] = accrual.table[rows[k]] * periods_;
+    }
+  }
+
+  void before_period(AmortizeBlock& s, std::int32_t t) {
+    // Padding lanes read entry t of table 0 and scale it by a zero rate.
+    const double* column = data_ + t;
+    for (std::size_t k = 0; k < s.padded; ++k) s.rate[k] = monthly_[k] * column[offset_[k]];
+  }
+  [[nodiscard]] double principal(std::size_t, double, double scheduled) const {
+    return scheduled;
+  }
+
+ private:
+  const double* data_;
+  std::size_t periods_;
+  alignas(64) std::array<double, kAmortizeBlock> monthly_{};
+  alignas(64) std::array<std::size_t, kAmortizeBlock> offset_{};
+};
+
+/// Adds period t's block sums into `out`; `opening` carries the balance
+/// from one period to the next.
+inline void record_period(const AmortizeBlock& s, std::size_t padded, std::int32_t t,
+                          double& opening, ScheduledTotals& out) {
+  const double closing = lane_sum(s.bal.data(), padded);
+  const auto p = static_cast<std::size_t>(t);
+  out.interest[p] += lane_sum(s.interest.data(), padded);
+  out.principal[p] += lane_sum(s.principal.data(), padded);
+  out.opening_balance[p] += opening;
+  out.closing_balance[p] += closing;
+  opening = closing;
+}
+
+/// amortize_block() for a block in which every loan has term `Term`: the
+/// bound is a compile-time constant and the last period is peeled, so no
+/// lane compares its term. Gives the generic loop's totals bit for bit.
+template <std::int32_t Term, class Policy>
+void amortize_block_term(AmortizeBlock& s, Policy& policy, ScheduledTotals& out) {
+  const std::size_t padded = s.padded;
+  double opening = lane_sum(s.bal.data(), padded);
+  for (std::int32_t t = 0; t < Term - 1; ++t) {
+    policy.before_period(s, t);
+    const double now = t;
+    for (std::size_t k = 0; k < padded; ++k) {
+      const double b = s.bal[k];
+      const double in = b * s.rate[k];
+      const double sp = policy.principal(k, now, std::min(s.level[k] - in, b));
+      s.bal[k] = b - sp;
+      s.interest[k] = in;
+      s.principal[k] = sp;
+    }
+    record_period(s, padded, t, opening, out);
+  }
+  // The final period retires whatever balance is left.
+  policy.before_period(s, Term - 1);
+  for (std::size_t k = 0; k < padded; ++k) {
+    const double b = s.bal[k];
+    s.interest[k] = b * s.rate[k];
+    s.principal[k] = b;
+    s.bal[k] = b - b;
+  }
+  record_period(s, padded, Term - 1, opening, out);
+}
+
+/// Steps `s` through periods [from, to). Unless `Final`, no lane may reach
+/// its last period in the range, so none compares its term.
+template <bool Final, class Policy>
+void step_periods(AmortizeBlock& s, Policy& policy, std::int32_t from, std::int32_t to,
+                  double& opening, ScheduledTotals& out) {
+  const std::size_t padded = s.padded;  // a local, so policies cannot alias it
+  for (std::int32_t t = from; t < to; ++t) {
+    policy.before_period(s, t);
+    // Step every loan first, then reduce: the update loop has no
+    // loop-carried sums and vectorizes as a plain element-wise pass.
+    const double now = t;
+    const double last = t + 1;
+    for (std::size_t k = 0; k < padded; ++k) {
+      const double b = s.bal[k];
+      const double in = b * s.rate[k];
+      const double due = policy.principal(k, now, std::min(s.level[k] - in, b));
+      double sp = due;
+      if constexpr (Final) sp = s.term[k] == last ? b : due;
+      s.bal[k] = b - sp;
+      s.interest[k] = in;
+      s.principal[k] = sp;
+    }
+    record_period(s, padded, t, opening, out);
+  }
+}
+
+/// Steps `s` through every period, adding its scheduled totals into `out`
+/// (which must already span `s.longest` periods).
+///
+/// `Policy` specializes the product at compile time:
+/// `before_period(s, t)` may rewrite rates and payments ahead of period t,
+/// and `principal(k, t, scheduled)` adjusts lane k's principal due. Both are
+/// inlined, so the per-loan loop stays a branch-free element-wise pass.
+///
+/// While term_kernels() is on, blocks whose loans all run 180 or 360
+/// months go to amortize_block_term(), and any other block runs the
+/// periods before its shortest term without the per-lane term compare.
+/// Off, every period compares. The totals are the same bits either way.
+template <class Policy>
+void amortize_block(AmortizeBlock& s, Policy& policy, ScheduledTotals& out) {
+  double opening = lane_sum(s.bal.data(), s.padded);
+  if (!term_kernels()) return step_periods<true>(s, policy, 0, s.longest, opening, out);
+  if (s.shortest == s.longest) {
+    switch (s.longest) {
+      case 360: return amortize_block_term<360>(s, policy, out);
+      case 180: return amortize_block_term<180>(s, policy, out);
+      default: break;
+    }
+  }
+  const std::int32_t open = std::max(s.shortest - 1, 0);
+  step_periods<false>(s, policy, 0, open, opening, out);
+  step_periods<true>(s, policy, open, s.longest, opening, out);
+}
+
+}  // namespace loansim::detail
@@ -0,0 +1,75 @@
+#include "loansim/analytics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace loansim {
+
+void LoanAnalytics::resize(std::size_t loans) {
+  for (std::vector<double>* v : {&yield, &macaulay_duration, &modified_duration, &convexity,
+                                 &wal}) {
+    v->resize(loans, 0.0);
+  }
+}
+
+CashFlowAnalytics analyze_cash_flows(std::span<const double> cash,
+                                     std::span<const double> principal, double price,
+                                     double guess) {
+  if (cash.size() != principal.size()) {
+    throw std::invalid_argument("analyze_cash_flows: cash and principal differ in length");
+  }
+  if (!(price > 0.0)) throw std::invalid_argument("analyze_cash_flows: price must be > 0");
+  double total = 0.0;
+  for (const double c : cash) total += c;
+  if (!(total > 0.0)) throw std::invalid_argument("analyze_cash_flows: no positive cash flow");
+
+  // Sums of cash * v^t, t * cash * v^t and t * (t + 1) * cash * v^t at the
+  // monthly discount factor v, t counted in months.
+  struct Sums {
+    double p0 = 0.0, p1 = 0.0, p2 = 0.0;
+  };
+  const auto sums = [&](double monthly) {
+    const double v = 1.0 / (1.0 + monthly);
+    Sums s;
+    double df = 1.0;
+    for (std::size_t i = 0; i < cash.size(); ++i) {
+      const double t = static_cast<double>(i + 1);
+      df *= v;
+      const double pv = cash[i] * df;
+      s.p0 += pv;
+      s.p1 += t * pv;
+      s.p2 += t * (t + 1.0) * pv;
+    }
+    return s;
+  };
+
+  double monthly = guess / 12.0;
+  for (int it = 0; it < 100; ++it) {
+    const Sums s = sums(monthly);
+    // dP/dm = -p1 / (1 + m); P is decreasing and convex in m, so Newton
+    // converges from any start once it lands to the left of the root.
+    const double step = (s.p0 - price) * (1.0 + monthly) / s.p1;
+    const double next = std::max(monthly + step, -0.99);
+    const bool done = std::abs(next - monthly) <= 1e-15 * (1.0 + std::abs(monthly));
+    monthly = next;
+    if (done) break;
+  }
+
+  const Sums s = sums(monthly);
+  CashFlowAnalytics a;
+  a.yield = 12.0 * monthly;
+  a.macaulay_duration = s.p1 / s.p0 / 12.0;
+  a.modified_duration = a.macaulay_duration / (1.0 + monthly);
+  a.convexity = s.p2 / s.p0 / (144.0 * (1.0 + monthly) * (1.0 + monthly));
+  double weighted = 0.0;
+  double paid = 0.0;
+  for (std::size_t i = 0; i < principal.size(); ++i) {
+    weighted += static_cast<double>(i + 1) * principal[i];
+    paid += principal[i];
+  }
+  a.wal = paid > 0.0 ? weighted / paid / 12.0 : 0.0;
+  return a;
+}
+
+}  // namespace loansim
@@ -0,0 +1,101 @@
+#include "loansim/arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace loansim {
+namespace {
+
+constexpr std::size_t kBlockAlign = 64;
+
+std::size_t padding_for(const std::byte* p, std::size_t alignment) noexcept {
+  const auto addr = reinterpret_cast<std::uintptr_t>(p);
+  return (alignment - addr % alignment) % alignment;
+}
+
+}  // namespace
+
+Arena::Arena(std::size_t block_size, std::pmr::memory_resource* upstream)
+    : block_size_(std::max<std::size_t>(block_size, kBlockAlign)), upstream_(upstream) {
+  if (upstream_ == nullptr) throw std::invalid_argument("Arena: null upstream resource");
+}
+
+Arena::~Arena() { release(); }
+
+void Arena::reset() noexcept {
+  current_ = 0;
+  offset_ = 0;
+  allocated_ = 0;
+}
+
+void Arena::release() noexcept {
+  reset();
+  for (const Block& b : blocks_) upstream_->deallocate(b.data, b.size, kBlockAlign);
+  blocks_.clear();
+  reserved_ = 0;
+}
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  // Try the current block, then any retained blocks after it, before going
+  // upstream. Retained blocks that are too small for this request are
+  // skipped for the rest of the run.
+  for (; current_ < blocks_.size(); ++current_, offset_ = 0) {
+    Block& b = blocks_[current_];
+    const std::size_t pad = padding_for(b.data + offset_, alignment);
+    if (offset_ + pad + bytes <= b.size) {
+      std::byte* p = b.data + offset_ + pad;
+      offset_ += pad + bytes;
+      allocated_ += bytes;
+      return p;
+    }
+  }
+
+  const std::size_t size = std::max(block_size_, bytes + alignment);
+  auto* data = static_cast<std::byte*>(upstream_->allocate(size, kBlockAlign));
+  blocks_.push_back({data, size});
+  reserved_ += size;
+  current_ = blocks_.size() - 1;
+  const std::size_t pad = padding_for(data, alignment);
+  offset_ = pad + bytes;
+  allocated_ += bytes;
+  return data + pad;
+}
+
+RunArenas::RunArenas(std::size_t block_size) : block_size_(block_size), shared_(block_size) {}
+
+void RunArenas::ensure_workers(unsigned workers) {
+  while (workers_.size() < workers) workers_.push_back(std::make_unique<Arena>(block_size_));
+}
+
+void RunArenas::reset() noexcept {
+  shared_.reset();
+  for (const auto& a : workers_) a->reset();
+}
+
+void RunArenas::release() noexcept {
+  shared_.release();
+  for (const auto& a : workers_) a->release();
+}
+
+std::size_t RunArenas::bytes_allocated() const noexcept {
+  std::size_t n = shared_.bytes_allocated();
+  for (const auto& a : workers_) n += a->bytes_allocated();
+  return n;
+}
+
+std::size_t RunArenas::bytes_reserved() const noexcept {
+  std::size_t n = shared_.bytes_reserved();
+  for (const auto& a : workers_) n += a->bytes_reserved();
+  return n;
+}
+
+bool RunArenas::owns(const std::pmr::memory_resource* resource) const noexcept {
+  if (resource == &shared_) return true;
+  for (const auto& a : workers_) {
+    if (resource == a.get()) return true;
+  }
+  return false;
+}
+
+}  // namespace loansim
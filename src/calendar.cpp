@@ -0,0 +1,238 @@
+#include "loansim/calendar.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace loansim {
+namespace {
+
+using std::chrono::day;
+using std::chrono::days;
+using std::chrono::month;
+using std::chrono::months;
+using std::chrono::year;
+using std::chrono::year_month_day;
+using std::chrono::year_month_day_last;
+
+/// Days from `a` to `b` counted 30/360 (bond basis), in standard months.
+/// The dates may be nominal (a day past the end of its month): the start
+/// day counts as at most 30, and an end day of 31 as 30 when the start day
+/// does, so a month between equal days of the month is always exactly 1.
+double thirty_360(const year_month_day& a, const year_month_day& b) noexcept {
+  const int d1 = std::min(static_cast<int>(unsigned{a.day()}), 30);
+  int d2 = static_cast<int>(unsigned{b.day()});
+  if (d2 == 31 && d1 == 30) d2 = 30;
+  const int days360 = 360 * (int{b.year()} - int{a.year()}) +
+                      30 * (static_cast<int>(unsigned{b.month()}) -
+                            static_cast<int>(unsigned{a.month()})) +
+                      (d2 - d1);
+  return days360 / 30.0;
+}
+
+/// Actual/Actual (ISDA): each calendar year's days over that year's length.
+double actual_actual(Date start, Date end) noexcept {
+  double years = 0.0;
+  while (start < end) {
+    const year y = year_month_day{start}.year();
+    const Date next_year = Date{(y + std::chrono::years{1}) / 1 / 1};
+    const Date stop = std::min(end, next_year);
+    years += static_cast<double>((stop - start).count()) / (y.is_leap() ? 366.0 : 365.0);
+    start = stop;
+  }
+  return 12.0 * years;
+}
+
+/// Packs a table key: the origination day and both convention fields.
+std::uint64_t table_key(Date origination, const AccrualConvention& c) noexcept {
+  const auto day_number = static_cast<std::uint32_t>(origination.time_since_epoch().count());
+  const auto day_count = static_cast<std::uint64_t>(c.day_count);
+  const auto roll = static_cast<std::uint64_t>(c.roll);
+  return std::uint64_t{day_number} << 16 | day_count << 8 | roll;
+}
+
+}  // namespace
+
+Date parse_date(std::string_view text) {
+  int y = 0;
+  unsigned m = 0;
+  unsigned d = 0;
+  const auto number = [&](std::size_t at, std::size_t width, auto& out) {
+    const char* first = text.data() + at;
+    const auto [end, ec] = std::from_chars(first, first + width, out);
+    return ec == std::errc() && end == first + width;
+  };
+  const bool shape = text.size() == 10 && text[4] == '-' && text[7] == '-';
+  if (!shape || !number(0, 4, y) || !number(5, 2, m) || !number(8, 2, d) ||
+      !year_month_day{year{y}, month{m}, day{d}}.ok()) {
+    throw std::invalid_argument("invalid date '" + std::string(text) + "' (want YYYY-MM-DD)");
+  }
+  return Date{year_month_day{year{y}, month{m}, day{d}}};
+}
+
+std::string to_string(Date date) {
+  const year_month_day d{date};
+  char text[16];
+  std::snprintf(text, sizeof text, "%04d-%02u-%02u", int{d.year()}, unsigned{d.month()},
+                unsigned{d.day()});
+  return text;
+}
+
+Date add_months(Date date, int count) noexcept {
+  const year_month_day d{date};
+  const auto target = std::chrono::year_month{d.year(), d.month()} + months{count};
+  const day last = year_month_day_last(target.year(), target.month() / std::chrono::last).day();
+  return Date{target / std::min(d.day(), last)};
+}
+
+const char* to_string(DayCount day_count) noexcept {
+  switch (day_count) {
+    case DayCount::thirty_360: return "30/360";
+    case DayCount::actual_360: return "act/360";
+    case DayCount::actual_365: return "act/365";
+    case DayCount::actual_actual: return "act/act";
+  }
+  return "unknown";
+}
+
+DayCount parse_day_count(std::string_view name) {
+  if (name == "30/360" || name == "thirty_360") return DayCount::thirty_360;
+  if (name == "act/360" || name == "actual_360") return DayCount::actual_360;
+  if (name == "act/365" || name == "actual_365") return DayCount::actual_365;
+  if (name == "act/act" || name == "actual_actual") return DayCount::actual_actual;
+  throw std::invalid_argument("unknown day count '" + std::string(name) + "'");
+}
+
+double accrual_months(Date start, Date end, DayCount day_count) noexcept {
+  switch (day_count) {
+    case DayCount::thirty_360: return thirty_360(year_month_day{start}, year_month_day{end});
+    case DayCount::actual_360: return static_cast<double>((end - start).count()) / 30.0;
+    case DayCount::actual_365: return static_cast<double>((end - start).count()) * 12.0 / 365.0;
+    case DayCount::actual_actual: return actual_actual(start, end);
+  }
+  return 0.0;
+}
+
+const char* to_string(BusinessDayRule rule) noexcept {
+  switch (rule) {
+    case BusinessDayRule::unadjusted: return "unadjusted";
+    case BusinessDayRule::following: return "following";
+    case BusinessDayRule::modified_following: return "modified_following";
+    case BusinessDayRule::preceding: return "preceding";
+  }
+  return "unknown";
+}
+
+BusinessDayRule parse_business_day_rule(std::string_view name) {
+  if (name == "unadjusted" || name == "none") return BusinessDayRule::unadjusted;
+  if (name == "following") return BusinessDayRule::following;
+  if (name == "modified_following") return BusinessDayRule::modified_following;
+  if (name == "preceding") return BusinessDayRule::preceding;
+  throw std::invalid_argument("unknown business day rule '" + std::string(name) + "'");
+}
+
+BusinessCalendar::BusinessCalendar(std::vector<Date> holidays) : holidays_(std::move(holidays)) {
+  std::sort(holidays_.begin(), holidays_.end());
+  holidays_.erase(std::unique(holidays_.begin(), holidays_.end()), holidays_.end());
+}
+
+BusinessCalendar BusinessCalendar::read(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) throw std::runtime_error("cannot open " + path);
+  std::vector<Date> holidays;
+  std::string line;
+  for (std::size_t number = 1; std::getline(in, line); ++number) {
+    std::string_view text(line);
+    text = text.substr(0, text.find('#'));
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\r' || text.back() == '\t')) {
+      text.remove_suffix(1);
+    }
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+    if (text.empty()) continue;
+    try {
+      holidays.push_back(parse_date(text));
+    } catch (const std::invalid_argument& e) {
+      throw std::runtime_error(path + ":" + std::to_string(number) + ": " + e.what());
+    }
+  }
+  return BusinessCalendar(std::move(holidays));
+}
+
+bool BusinessCalendar::is_business_day(Date date) const noexcept {
+  const std::chrono::weekday w{date};
+  if (w == std::chrono::Saturday || w == std::chrono::Sunday) return false;
+  return !std::binary_search(holidays_.begin(), holidays_.end(), date);
+}
+
+Date BusinessCalendar::adjust(Date date, BusinessDayRule rule) const noexcept {
+  const auto step = [&](Date d, int direction) {
+    while (!is_business_day(d)) d += days{direction};
+    return d;
+  };
+  switch (rule) {
+    case BusinessDayRule::unadjusted: return date;
+    case BusinessDayRule::following: return step(date, 1);
+    case BusinessDayRule::preceding: return step(date, -1);
+    case BusinessDayRule::modified_following: {
+      const Date next = step(date, 1);
+      return year_month_day{next}.month() == year_month_day{date}.month() ? next
+                                                                          : step(date, -1);
+    }
+  }
+  return date;
+}
+
+AccrualTables::AccrualTables(std::size_t periods, BusinessCalendar calendar)
+    : periods_(periods), calendar_(std::move(calendar)) {}
+
+std::uint32_t AccrualTables::intern(Date origination, const AccrualConvention& convention) {
+  const auto [it, inserted] =
+      index_.try_emplace(table_key(origination, convention), static_cast<std::uint32_t>(size()));
+  if (!inserted) return it->second;
+
+  origination_.push_back(origination);
+  accrual_.resize(accrual_.size() + periods_);
+  dates_.resize(dates_.size() + periods_);
+  double* accrual = accrual_.data() + it->second * periods_;
+  Date* dates = dates_.data() + it->second * periods_;
+  // 30/360 accrues between the nominal payment dates, the origination's
+  // day in each month before clamping, so every period is a whole month;
+  // the other day counts accrue between adjusted dates.
+  const bool nominal_accrual = convention.day_count == DayCount::thirty_360;
+  const year_month_day nominal{origination};
+  Date start = origination;
+  for (std::size_t t = 0; t < periods_; ++t) {
+    const Date scheduled = add_months(origination, static_cast<int>(t + 1));
+    dates[t] = calendar_.adjust(scheduled, convention.roll);
+    if (nominal_accrual) {
+      accrual[t] = thirty_360(nominal + months{static_cast<int>(t)},
+                              nominal + months{static_cast<int>(t + 1)});
+      continue;
+    }
+    accrual[t] = accrual_months(start, dates[t], convention.day_count);
+    start = dates[t];
+  }
+  return it->second;
+}
+
+std::size_t AccrualTables::bytes() const noexcept {
+  return accrual_.size() * sizeof(double) + dates_.size() * sizeof(Date) +
+         origination_.size() * sizeof(Date);
+}
+
+void LoanAccrual::validate(std::size_t loans, std::size_t periods) const {
+  if (tables == nullptr) throw std::invalid_argument("LoanAccrual: no tables");
+  if (table.size() != loans) throw std::invalid_argument("LoanAccrual: one table id per loan");
+  if (tables->periods() < periods) {
+    throw std::invalid_argument("LoanAccrual: tables are shorter than the longest term");
+  }
+  for (const std::uint32_t id : table) {
+    if (id >= tables->size()) throw std::invalid_argument("LoanAccrual: unknown table id");
+  }
+}
+
+}  // namespace loansim
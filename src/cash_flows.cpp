@@ -0,0 +1,44 @@
+#include "loansim/cash_flows.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace loansim {
+
+void PoolCashFlows::resize(std::size_t periods) {
+  for (std::pmr::vector<double>* v : {&interest, &scheduled_principal, &prepayment, &defaults,
+                                 &loss, &balance}) {
+    v->resize(periods, 0.0);
+  }
+}
+
+void PoolCashFlows::clear() noexcept {
+  for (std::pmr::vector<double>* v : {&interest, &scheduled_principal, &prepayment, &defaults,
+                                 &loss, &balance}) {
+    std::fill(v->begin(), v->end(), 0.0);
+  }
+}
+
+void PoolCashFlows::add(const PoolCashFlows& other) {
+  if (other.periods() > periods()) {
+    throw std::invalid_argument("PoolCashFlows::add: other has more periods");
+  }
+  const std::size_t n = other.periods();
+  for (std::size_t t = 0; t < n; ++t) {
+    interest[t] += other.interest[t];
+    scheduled_principal[t] += other.scheduled_principal[t];
+    prepayment[t] += other.prepayment[t];
+    defaults[t] += other.defaults[t];
+    loss[t] += other.loss[t];
+    balance[t] += other.balance[t];
+  }
+}
+
+void PoolCashFlows::scale(double factor) noexcept {
+  for (std::pmr::vector<double>* v : {&interest, &scheduled_principal, &prepayment, &defaults,
+                                 &loss, &balance}) {
+    for (double& x : *v) x *= factor;
+  }
+}
+
+}  // namespace loansim
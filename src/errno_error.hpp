@@ -0,0 +1,16 @@
+#pragma once
+
+// Internal: system_error from errno, for the POSIX file and socket code.
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+namespace loansim::detail {
+
+/// Throws std::system_error for the current errno, as "`what` `path`".
+[[noreturn]] inline void throw_errno(const char* what, const std::string& path) {
+  throw std::system_error(errno, std::generic_category(), std::string(what) + " " + path);
+}
+
+}  // namespace loansim::detail
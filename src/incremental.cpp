@@ -0,0 +1,104 @@
+#include "loansim/incremental.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "loansim/instrument.hpp"
+#include "loansim/parallel.hpp"
+
+namespace loansim {
+namespace {
+
+void check_loan(double principal, double annual_rate, std::int32_t term_months) {
+  const LoanColumns one{{&principal, 1}, {&annual_rate, 1}, {&term_months, 1}};
+  one.validate();
+}
+
+}  // namespace
+
+IncrementalPool::IncrementalPool(const LoanColumns& loans, unsigned threads)
+    : threads_(threads) {
+  loans.validate();
+  loans_.principal.assign(loans.principal.begin(), loans.principal.end());
+  loans_.annual_rate.assign(loans.annual_rate.begin(), loans.annual_rate.end());
+  loans_.term_months.assign(loans.term_months.begin(), loans.term_months.end());
+  const std::size_t chunks = (size() + kAggregateChunkLoans - 1) / kAggregateChunkLoans;
+  chunk_totals_.resize(chunks);
+  dirty_.assign(chunks, 1);
+  stale_ = true;
+  refresh();
+}
+
+std::size_t IncrementalPool::add(double principal, double annual_rate,
+                                 std::int32_t term_months) {
+  check_loan(principal, annual_rate, term_months);
+  loans_.push_back(principal, annual_rate, term_months);
+  const std::size_t index = size() - 1;
+  if (index / kAggregateChunkLoans >= chunk_totals_.size()) {
+    chunk_totals_.emplace_back();
+    dirty_.push_back(0);
+  }
+  mark(index);
+  return index;
+}
+
+void IncrementalPool::modify(std::size_t index, double principal, double annual_rate,
+                             std::int32_t term_months) {
+  if (index >= size()) throw std::out_of_range("IncrementalPool::modify: bad index");
+  check_loan(principal, annual_rate, term_months);
+  loans_.principal[index] = principal;
+  loans_.annual_rate[index] = annual_rate;
+  loans_.term_months[index] = term_months;
+  mark(index);
+}
+
+void IncrementalPool::pay_off(std::size_t index) {
+  if (index >= size()) throw std::out_of_range("IncrementalPool::pay_off: bad index");
+  loans_.principal[index] = 0.0;
+  mark(index);
+}
+
+void IncrementalPool::mark(std::size_t index) {
+  dirty_[index / kAggregateChunkLoans] = 1;
+  stale_ = true;
+}
+
+std::size_t IncrementalPool::dirty_chunks() const noexcept {
+  return static_cast<std::size_t>(std::count(dirty_.begin(), dirty_.end(), 1));
+}
+
+void IncrementalPool::refresh() {
+  if (!stale_) return;
+  std::vector<std::size_t> todo;
+  for (std::size_t c = 0; c < dirty_.size(); ++c) {
+    if (dirty_[c]) todo.push_back(c);
+  }
+  const LoanColumns all = loans_.columns();
+  parallel_for(todo.size(), threads_, [&](std::size_t task, unsigned) {
+    const std::size_t chunk = todo[task];
+    const std::size_t begin = chunk * kAggregateChunkLoans;
+    const std::size_t end = std::min(begin + kAggregateChunkLoans, size());
+    ScheduledTotals fresh;
+    accumulate_scheduled(all.slice(begin, end), fresh);
+    chunk_totals_[chunk] = std::move(fresh);
+  });
+  std::fill(dirty_.begin(), dirty_.end(), 0);
+
+  // Same fold as aggregate_pool(): chunks in index order, growing to the
+  // longest term as they are added.
+  total_ = ScheduledTotals{};
+  for (const ScheduledTotals& c : chunk_totals_) total_.add(c);
+  stale_ = false;
+}
+
+const ScheduledTotals& IncrementalPool::scheduled() {
+  refresh();
+  return total_;
+}
+
+PoolCashFlows IncrementalPool::cash_flows(const CashFlowAssumptions& assumptions) {
+  const StageScope scope(Stage::aggregate, size());
+  return apply_assumptions(scheduled(), assumptions);
+}
+
+}  // namespace loansim
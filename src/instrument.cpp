@@ -0,0 +1,109 @@
+#include "loansim/instrument.hpp"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+namespace loansim {
+namespace {
+
+/// One stage's totals; relaxed atomics, as they are only ever summed.
+struct StageCounters {
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> nanoseconds{0};
+  std::atomic<std::uint64_t> loans{0};
+  std::atomic<std::uint64_t> bytes{0};
+};
+
+std::array<StageCounters, kStageCount>& counters() {
+  static std::array<StageCounters, kStageCount> c;
+  return c;
+}
+
+[[maybe_unused]] thread_local std::array<int, kStageCount> active_scopes{};
+
+}  // namespace
+
+const char* to_string(Stage stage) noexcept {
+  switch (stage) {
+    case Stage::load: return "load";
+    case Stage::schedule: return "schedule";
+    case Stage::simulate: return "simulate";
+    case Stage::aggregate: return "aggregate";
+    case Stage::output: return "output";
+  }
+  return "unknown";
+}
+
+StageReport stage_report() {
+  StageReport report{};
+  for (std::size_t s = 0; s < kStageCount; ++s) {
+    const StageCounters& c = counters()[s];
+    report[s].calls = c.calls.load(std::memory_order_relaxed);
+    report[s].seconds = static_cast<double>(c.nanoseconds.load(std::memory_order_relaxed)) * 1e-9;
+    report[s].loans = c.loans.load(std::memory_order_relaxed);
+    report[s].bytes = c.bytes.load(std::memory_order_relaxed);
+  }
+  return report;
+}
+
+void reset_stage_report() {
+  for (StageCounters& c : counters()) {
+    c.calls.store(0, std::memory_order_relaxed);
+    c.nanoseconds.store(0, std::memory_order_relaxed);
+    c.loans.store(0, std::memory_order_relaxed);
+    c.bytes.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::string stage_report_json() {
+  const StageReport report = stage_report();
+  std::string json = kInstrumentationEnabled ? "{\"enabled\":true,\"stages\":{"
+                                             : "{\"enabled\":false,\"stages\":{";
+  for (std::size_t s = 0; s < kStageCount; ++s) {
+    const StageStats& st = report[s];
+    char entry[256];
+    std::snprintf(entry, sizeof entry,
+                  "%s\"%s\":{\"calls\":%" PRIu64 ",\"seconds\":%.6f,\"loans\":%" PRIu64
+                  ",\"bytes\":%" PRIu64 "}",
+                  s == 0 ? "" : ",", to_string(static_cast<Stage>(s)), st.calls, st.seconds,
+                  st.loans, st.bytes);
+    json += entry;
+  }
+  json += "}}";
+  return json;
+}
+
+#if LOANSIM_INSTRUMENTATION
+
+StageScope::StageScope(Stage stage, std::size_t loans, const RunArenas* arenas) noexcept
+    : stage_(stage),
+      outermost_(active_scopes[static_cast<std::size_t>(stage)]++ == 0),
+      arenas_(arenas),
+      loans_(loans) {
+  if (arenas_ != nullptr) arena_start_ = arenas_->bytes_allocated();
+  if (outermost_) start_ = std::chrono::steady_clock::now();
+}
+
+StageScope::~StageScope() {
+  --active_scopes[static_cast<std::size_t>(stage_)];
+  StageCounters& c = counters()[static_cast<std::size_t>(stage_)];
+  if (outermost_) {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.nanoseconds.fetch_add(
+        static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+        std::memory_order_relaxed);
+  }
+  if (arenas_ != nullptr) {
+    const std::size_t now = arenas_->bytes_allocated();
+    if (now > arena_start_) bytes_ += now - arena_start_;
+  }
+  c.loans.fetch_add(loans_, std::memory_order_relaxed);
+  c.bytes.fetch_add(bytes_, std::memory_order_relaxed);
+}
+
+#endif
+
+}  // namespace loansim
@@ -0,0 +1,32 @@
+#pragma once
+
+// Internal: deterministic, vectorizable reductions shared by the batch engines.
+
+#include <array>
+#include <cstddef>
+
+namespace loansim::detail {
+
+/// Width of the partial-sum arrays. Buffers passed to lane_sum() are padded
+/// to a multiple of this with zeros.
+inline constexpr std::size_t kLanes = 8;
+
+/// Sums `v[0, n)` (n a multiple of kLanes) with kLanes independent
+/// accumulators combined in a fixed order. This vectorizes without letting
+/// the compiler reassociate, so the result is the same on every build.
+inline double lane_sum(const double* v, std::size_t n) noexcept {
+  std::array<double, kLanes> acc{};
+  for (std::size_t i = 0; i < n; i += kLanes) {
+    for (std::size_t j = 0; j < kLanes; ++j) acc[j] += v[i + j];
+  }
+  double s = 0.0;
+  for (const double x : acc) s += x;
+  return s;
+}
+
+/// `n` rounded up to a multiple of kLanes.
+inline constexpr std::size_t pad_to_lanes(std::size_t n) noexcept {
+  return (n + kLanes - 1) / kLanes * kLanes;
+}
+
+}  // namespace loansim::detail
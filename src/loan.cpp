@@ -0,0 +1,54 @@
+#include "loansim/loan.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace loansim {
+namespace {
+
+bool finite_non_negative(double x) { return std::isfinite(x) && x >= 0.0; }
+
+}  // namespace
+
+LoanColumns LoanColumns::slice(std::size_t begin, std::size_t end) const {
+  if (begin > end || end > size()) {
+    throw std::out_of_range("LoanColumns::slice: range out of bounds");
+  }
+  const std::size_t n = end - begin;
+  return LoanColumns{principal.subspan(begin, n), annual_rate.subspan(begin, n),
+                     term_months.subspan(begin, n)};
+}
+
+void LoanColumns::validate() const {
+  const std::size_t n = size();
+  if (annual_rate.size() != n || term_months.size() != n) {
+    throw std::invalid_argument("LoanColumns: column lengths differ");
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    // isfinite() also rejects NaN, and the infinities a CSV "inf" parses to.
+    if (!finite_non_negative(principal[i]) || !finite_non_negative(annual_rate[i]) ||
+        term_months[i] <= 0) {
+      throw std::invalid_argument("LoanColumns: invalid loan at index " +
+                                  std::to_string(i));
+    }
+  }
+}
+
+void LoanPool::reserve(std::size_t n) {
+  principal.reserve(n);
+  annual_rate.reserve(n);
+  term_months.reserve(n);
+}
+
+void LoanPool::push_back(double balance, double rate, std::int32_t term) {
+  principal.push_back(balance);
+  annual_rate.push_back(rate);
+  term_months.push_back(term);
+}
+
+LoanColumns LoanPool::columns() const noexcept {
+  return LoanColumns{principal, annual_rate, term_months};
+}
+
+}  // namespace loansim
@@ -0,0 +1,477 @@
+#include "loansim/loan_store.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "loansim/instrument.hpp"
+#include "loansim/parallel.hpp"
+
+#include "text_fields.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::trim;
+
+constexpr int kMaxDecimals = 6;
+constexpr int kMaxDigits = 18;  // every fixed-point value fits an int64
+// Significant digits every decimal keeps through a double (DBL_DIG).
+constexpr int kMaxRawDigits = std::numeric_limits<double>::digits10;
+
+/// Lets the string-keyed tables below be probed with a string_view.
+struct StringHash {
+  using is_transparent = void;
+  std::size_t operator()(std::string_view s) const noexcept {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+/// A plain decimal ([+-]digits[.digits]) split into its digits as an
+/// integer and the number of fractional digits.
+struct Decimal {
+  std::int64_t mantissa = 0;
+  int decimals = 0;
+  int digits = 0;
+};
+
+bool parse_decimal(std::string_view s, Decimal& out) {
+  bool negative = false;
+  if (!s.empty() && (s.front() == '+' || s.front() == '-')) {
+    negative = s.front() == '-';
+    s.remove_prefix(1);
+  }
+  Decimal d;
+  bool point = false;
+  bool any = false;
+  for (const char c : s) {
+    if (c == '.' && !point) {
+      point = true;
+      continue;
+    }
+    if (c < '0' || c > '9') return false;
+    any = true;
+    if (d.digits == 0 && c == '0' && !point) continue;  // leading zeros
+    if (++d.digits > kMaxDigits) return false;
+    d.mantissa = d.mantissa * 10 + (c - '0');
+    d.decimals += point ? 1 : 0;
+  }
+  if (!any || d.decimals > kMaxDecimals) return false;
+  if (negative) d.mantissa = -d.mantissa;
+  out = d;
+  return true;
+}
+
+/// True if `s` is a decimal written the way number() gives it back: an
+/// optional '-', an integer part with no leading zero (other than a lone
+/// "0") and an optional fraction. Zero-padded IDs and ZIP codes, '+'
+/// signs and exponents fail, so their columns keep the text. Sets
+/// `significant` to the digits from the first non-zero one on.
+bool canonical_decimal(std::string_view s, int& significant) {
+  if (!s.empty() && s.front() == '-') s.remove_prefix(1);
+  const std::size_t integer = std::min(s.find('.'), s.size());
+  if (integer == 0 || (integer > 1 && s.front() == '0')) return false;
+  if (integer < s.size() && integer + 1 == s.size()) return false;  // "12."
+  significant = 0;
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    if (i == integer) continue;
+    if (s[i] < '0' || s[i] > '9') return false;
+    if (significant > 0 || s[i] != '0') ++significant;
+  }
+  return true;
+}
+
+std::int64_t pow10(int n) {
+  std::int64_t p = 1;
+  while (n-- > 0) p *= 10;
+  return p;
+}
+
+/// Smallest of 1, 2, 4 and 8 bytes that holds values in [0, max].
+std::size_t width_for(std::uint64_t max) {
+  if (max <= 0xFFu) return 1;
+  if (max <= 0xFFFFu) return 2;
+  if (max <= 0xFFFF'FFFFu) return 4;
+  return 8;
+}
+
+void store_packed(std::vector<std::uint8_t>& out, std::size_t row, std::size_t width,
+                  std::uint64_t value) {
+  std::uint8_t* p = out.data() + row * width;
+  switch (width) {
+    case 1: *p = static_cast<std::uint8_t>(value); break;
+    case 2: { const auto v = static_cast<std::uint16_t>(value); std::memcpy(p, &v, 2); break; }
+    case 4: { const auto v = static_cast<std::uint32_t>(value); std::memcpy(p, &v, 4); break; }
+    default: std::memcpy(p, &value, 8); break;
+  }
+}
+
+}  // namespace
+
+/// Builds one ColdColumn from two passes over its fields: observe() every
+/// row, then encode() every row in the same order.
+class ColdColumnBuilder {
+ public:
+  explicit ColdColumnBuilder(std::string name) { column_.name_ = std::move(name); }
+
+  void observe(std::string_view field) {
+    field = trim(field);
+    ++rows_;
+    if (!many_ && distinct_.find(field) == distinct_.end()) distinct_.emplace(field);
+    many_ = distinct_.size() > ColdColumn::kMaxCategories;
+    if (field.empty() || !numeric_) return;
+    int significant = 0;
+    if (!canonical_decimal(field, significant)) {
+      numeric_ = false;
+      return;
+    }
+    significant_ = std::max(significant_, significant);
+    Decimal d;
+    if (fixed_ && parse_decimal(field, d)) {
+      decimals_ = std::max(decimals_, d.decimals);
+      integer_digits_ = std::max(integer_digits_, d.digits - d.decimals);
+      min_ = std::min(min_, static_cast<long double>(d.mantissa) / pow10(d.decimals));
+      max_ = std::max(max_, static_cast<long double>(d.mantissa) / pow10(d.decimals));
+      return;
+    }
+    fixed_ = false;
+  }
+
+  void start() {
+    ColdColumn& c = column_;
+    c.size_ = rows_;
+    // Raw doubles are only exact for values of up to kMaxRawDigits digits;
+    // a longer one (a 20-digit ID, say) stays text.
+    const bool raw = !fixed_ || integer_digits_ + decimals_ > kMaxDigits;
+    if (raw && significant_ > kMaxRawDigits) numeric_ = false;
+    if (numeric_ && distinct_.size() > (distinct_.count("") ? 1u : 0u)) {
+      c.kind_ = ColdColumn::Kind::number;
+      c.raw_ = raw;
+      if (c.raw_) {
+        c.width_ = sizeof(double);
+      } else {
+        c.scale_ = static_cast<double>(pow10(decimals_));
+        c.base_ = std::llroundl(min_ * pow10(decimals_));
+        const std::int64_t top = std::llroundl(max_ * pow10(decimals_));
+        c.width_ = width_for(static_cast<std::uint64_t>(top - c.base_) + 1);
+      }
+      c.packed_.resize(rows_ * c.width_);
+    } else if (!many_) {
+      c.kind_ = ColdColumn::Kind::category;
+      c.categories_.assign(distinct_.begin(), distinct_.end());
+      std::sort(c.categories_.begin(), c.categories_.end());
+      for (std::size_t i = 0; i < c.categories_.size(); ++i) {
+        codes_.emplace(c.categories_[i], static_cast<std::uint32_t>(i));
+      }
+      c.width_ = width_for(c.categories_.size() - 1);
+      c.packed_.resize(rows_ * c.width_);
+    } else {
+      c.kind_ = ColdColumn::Kind::text;
+      c.offsets_.reserve(rows_ + 1);
+      c.offsets_.push_back(0);
+    }
+    distinct_.clear();
+  }
+
+  void encode(std::string_view field) {
+    field = trim(field);
+    ColdColumn& c = column_;
+    switch (c.kind_) {
+      case ColdColumn::Kind::number: {
+        if (c.raw_) {
+          double x = std::numeric_limits<double>::quiet_NaN();
+          if (!field.empty()) std::from_chars(field.data(), field.data() + field.size(), x);
+          std::memcpy(c.packed_.data() + row_ * sizeof x, &x, sizeof x);
+        } else if (!field.empty()) {
+          Decimal d;
+          parse_decimal(field, d);
+          const std::int64_t v = d.mantissa * pow10(decimals_ - d.decimals);
+          store_packed(c.packed_, row_, c.width_, static_cast<std::uint64_t>(v - c.base_) + 1);
+        }
+        break;
+      }
+      case ColdColumn::Kind::category:
+        store_packed(c.packed_, row_, c.width_, codes_.find(field)->second);
+        break;
+      case ColdColumn::Kind::text:
+        c.chars_.append(field);
+        c.offsets_.push_back(c.chars_.size());
+        break;
+    }
+    ++row_;
+  }
+
+  [[nodiscard]] ColdColumn finish() { return std::move(column_); }
+
+ private:
+  ColdColumn column_;
+  std::size_t rows_ = 0;
+  std::size_t row_ = 0;
+  bool numeric_ = true;
+  bool fixed_ = true;
+  bool many_ = false;
+  int decimals_ = 0;
+  int integer_digits_ = 0;
+  int significant_ = 0;
+  long double min_ = std::numeric_limits<long double>::infinity();
+  long double max_ = -std::numeric_limits<long double>::infinity();
+  std::unordered_set<std::string, StringHash, std::equal_to<>> distinct_;
+  std::unordered_map<std::string, std::uint32_t, StringHash, std::equal_to<>> codes_;
+};
+
+/// Builds a LoanStore's hot set from two passes over the same chunks.
+class HotSetBuilder {
+ public:
+  void observe(const LoanColumns& chunk) {
+    chunk.validate();
+    for (std::size_t i = 0; i < chunk.size(); ++i) {
+      const double b = chunk.principal[i];
+      const double cents = std::round(b * 100.0);
+      cents_ = cents_ && cents < 4'294'967'296.0 && cents / 100.0 == b;
+      if (dictionary_) {
+        rates_.insert(std::bit_cast<std::uint64_t>(chunk.annual_rate[i]));
+        dictionary_ = rates_.size() <= 65'536;
+      }
+      if (chunk.term_months[i] > 0xFFFF) {
+        throw std::invalid_argument("LoanStore: term_months above 65535");
+      }
+    }
+  }
+
+  void start(LoanStore& store, std::size_t loans) {
+    if (cents_) {
+      store.balance_cents_.reserve(loans);
+    } else {
+      store.balance_.reserve(loans);
+    }
+    if (dictionary_) {
+      store.rates_.reserve(rates_.size());
+      for (const std::uint64_t bits : rates_) store.rates_.push_back(std::bit_cast<double>(bits));
+      std::sort(store.rates_.begin(), store.rates_.end());
+      for (std::size_t i = 0; i < store.rates_.size(); ++i) {
+        codes_.emplace(std::bit_cast<std::uint64_t>(store.rates_[i]),
+                       static_cast<std::uint16_t>(i));
+      }
+      store.rate_code_.reserve(loans);
+    } else {
+      store.rate_.reserve(loans);
+    }
+    store.term_.reserve(loans);
+    rates_.clear();
+  }
+
+  void encode(const LoanColumns& chunk, LoanStore& store) const {
+    for (std::size_t i = 0; i < chunk.size(); ++i) {
+      if (cents_) {
+        store.balance_cents_.push_back(
+            static_cast<std::uint32_t>(std::round(chunk.principal[i] * 100.0)));
+      } else {
+        store.balance_.push_back(chunk.principal[i]);
+      }
+      if (dictionary_) {
+        store.rate_code_.push_back(
+            codes_.find(std::bit_cast<std::uint64_t>(chunk.annual_rate[i]))->second);
+      } else {
+        store.rate_.push_back(chunk.annual_rate[i]);
+      }
+      store.term_.push_back(static_cast<std::uint16_t>(chunk.term_months[i]));
+    }
+  }
+
+ private:
+  bool cents_ = true;
+  bool dictionary_ = true;
+  std::unordered_set<std::uint64_t> rates_;  // bit patterns
+  std::unordered_map<std::uint64_t, std::uint16_t> codes_;
+};
+
+std::size_t ColdColumn::bytes() const noexcept {
+  std::size_t n = packed_.size() + offsets_.size() * sizeof(std::uint64_t) + chars_.size();
+  for (const std::string& c : categories_) n += c.size();
+  return n;
+}
+
+std::uint64_t ColdColumn::packed(std::size_t row) const noexcept {
+  const std::uint8_t* p = packed_.data() + row * width_;
+  switch (width_) {
+    case 1: return *p;
+    case 2: { std::uint16_t v; std::memcpy(&v, p, 2); return v; }
+    case 4: { std::uint32_t v; std::memcpy(&v, p, 4); return v; }
+    default: { std::uint64_t v; std::memcpy(&v, p, 8); return v; }
+  }
+}
+
+bool ColdColumn::missing(std::size_t row) const noexcept {
+  switch (kind_) {
+    case Kind::number: return std::isnan(number(row));
+    case Kind::category: return categories_[packed(row)].empty();
+    case Kind::text: return offsets_[row] == offsets_[row + 1];
+  }
+  return true;
+}
+
+double ColdColumn::number(std::size_t row) const noexcept {
+  if (raw_) {
+    double x;
+    std::memcpy(&x, packed_.data() + row * sizeof x, sizeof x);
+    return x;
+  }
+  const std::uint64_t p = packed(row);
+  if (p == 0) return std::numeric_limits<double>::quiet_NaN();
+  // The quotient is the correctly rounded value of the decimal on the tape
+  // while the numerator is at most 2^53 (and the scale, at most 10^6, is
+  // always exact); up to the 18 digits allowed it may round once more.
+  return static_cast<double>(base_ + static_cast<std::int64_t>(p) - 1) / scale_;
+}
+
+std::string_view ColdColumn::text(std::size_t row) const noexcept {
+  if (kind_ == Kind::category) return categories_[packed(row)];
+  return std::string_view(chars_).substr(offsets_[row], offsets_[row + 1] - offsets_[row]);
+}
+
+std::uint32_t ColdColumn::code(std::size_t row) const noexcept {
+  return static_cast<std::uint32_t>(packed(row));
+}
+
+LoanStore LoanStore::from_columns(const LoanColumns& loans) {
+  HotSetBuilder hot;
+  hot.observe(loans);
+  LoanStore store;
+  hot.start(store, loans.size());
+  hot.encode(loans, store);
+  return store;
+}
+
+LoanStore LoanStore::read_csv(const std::string& path, const CsvTapeOptions& options) {
+  const CsvTapeReader reader(path, options);
+  const std::size_t rows = reader.count_rows();
+  StageScope scope(Stage::load, rows);
+
+  HotSetBuilder hot;
+  reader.for_each_chunk([&](const LoanColumns& chunk) { hot.observe(chunk); });
+  LoanStore store;
+  hot.start(store, rows);
+  reader.for_each_chunk([&](const LoanColumns& chunk) { hot.encode(chunk, store); });
+
+  const std::vector<std::string> names = reader.column_names();
+  std::vector<std::size_t> index;
+  std::vector<ColdColumnBuilder> cold;
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == options.principal_column || names[i] == options.rate_column ||
+        names[i] == options.term_column) {
+      continue;
+    }
+    index.push_back(i);
+    cold.emplace_back(names[i]);
+  }
+  if (!cold.empty()) {
+    const auto field = [&](std::span<const std::string_view> fields, std::size_t c) {
+      return index[c] < fields.size() ? fields[index[c]] : std::string_view{};
+    };
+    reader.for_each_row([&](std::size_t, std::span<const std::string_view> fields) {
+      for (std::size_t c = 0; c < cold.size(); ++c) cold[c].observe(field(fields, c));
+    });
+    for (ColdColumnBuilder& c : cold) c.start();
+    reader.for_each_row([&](std::size_t, std::span<const std::string_view> fields) {
+      for (std::size_t c = 0; c < cold.size(); ++c) cold[c].encode(field(fields, c));
+    });
+    store.cold_.reserve(cold.size());
+    for (ColdColumnBuilder& c : cold) store.cold_.push_back(c.finish());
+  }
+  scope.add_bytes(store.hot_bytes() + store.cold_bytes());
+  return store;
+}
+
+void LoanStore::decode(std::size_t begin, std::size_t end, LoanPool& out) const {
+  if (begin > end || end > size()) throw std::out_of_range("LoanStore::decode: range out of bounds");
+  const std::size_t n = end - begin;
+  out.principal.resize(n);
+  out.annual_rate.resize(n);
+  out.term_months.resize(n);
+  if (balances_in_cents()) {
+    // Exact: the store only uses cents when cents / 100.0 gave back the balance.
+    for (std::size_t i = 0; i < n; ++i) out.principal[i] = balance_cents_[begin + i] / 100.0;
+  } else {
+    std::copy_n(balance_.begin() + begin, n, out.principal.begin());
+  }
+  if (!rates_.empty()) {
+    for (std::size_t i = 0; i < n; ++i) out.annual_rate[i] = rates_[rate_code_[begin + i]];
+  } else {
+    std::copy_n(rate_.begin() + begin, n, out.annual_rate.begin());
+  }
+  for (std::size_t i = 0; i < n; ++i) out.term_months[i] = term_[begin + i];
+}
+
+LoanPool LoanStore::decode_all() const {
+  LoanPool pool;
+  decode(0, size(), pool);
+  return pool;
+}
+
+void LoanStore::for_each_chunk(std::size_t chunk_loans,
+                               const std::function<void(const LoanColumns& chunk)>& fn) const {
+  if (chunk_loans == 0) throw std::invalid_argument("LoanStore::for_each_chunk: chunk_loans is 0");
+  LoanPool buffer;
+  for (std::size_t begin = 0; begin < size(); begin += chunk_loans) {
+    decode(begin, std::min(begin + chunk_loans, size()), buffer);
+    fn(buffer.columns());
+  }
+}
+
+std::size_t LoanStore::max_term() const noexcept {
+  return term_.empty() ? 0 : *std::max_element(term_.begin(), term_.end());
+}
+
+std::size_t LoanStore::hot_bytes() const noexcept {
+  return balance_cents_.size() * sizeof(std::uint32_t) + balance_.size() * sizeof(double) +
+         rate_code_.size() * sizeof(std::uint16_t) + rates_.size() * sizeof(double) +
+         rate_.size() * sizeof(double) + term_.size() * sizeof(std::uint16_t);
+}
+
+std::size_t LoanStore::cold_bytes() const noexcept {
+  std::size_t n = 0;
+  for (const ColdColumn& c : cold_) n += c.bytes();
+  return n;
+}
+
+const ColdColumn* LoanStore::cold(std::string_view name) const noexcept {
+  for (const ColdColumn& c : cold_) {
+    if (c.name() == name) return &c;
+  }
+  return nullptr;
+}
+
+PoolCashFlows aggregate_store(const LoanStore& store, const CashFlowAssumptions& assumptions,
+                              unsigned threads, RunArenas* arenas) {
+  assumptions.validate();
+  const StageScope scope(Stage::aggregate, store.size(), arenas);
+  const unsigned workers = threads == 0 ? default_thread_count() : threads;
+  const std::size_t periods = store.max_term();
+  const std::size_t chunks = (store.size() + kAggregateChunkLoans - 1) / kAggregateChunkLoans;
+  // Same chunking and fold order as aggregate_pool().
+  std::pmr::vector<ScheduledTotals> partial(shared_resource(arenas));
+  partial.reserve(chunks);
+  for (std::size_t c = 0; c < chunks; ++c) {
+    partial.emplace_back(shared_resource(arenas)).resize(periods);
+  }
+  std::vector<LoanPool> buffers(workers);
+  for (LoanPool& b : buffers) b.reserve(kAggregateChunkLoans);
+  parallel_for(chunks, workers, [&](std::size_t chunk, unsigned worker) {
+    const std::size_t begin = chunk * kAggregateChunkLoans;
+    store.decode(begin, std::min(begin + kAggregateChunkLoans, store.size()), buffers[worker]);
+    accumulate_scheduled(buffers[worker].columns(), partial[chunk]);
+  });
+
+  ScheduledTotals total(shared_resource(arenas));
+  total.resize(periods);
+  for (const ScheduledTotals& p : partial) total.add(p);
+  return apply_assumptions(total, assumptions);
+}
+
+}  // namespace loansim
@@ -0,0 +1,459 @@
+#include "loansim/loan_tape.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "loansim/instrument.hpp"
+
+#include "text_fields.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::parse_error;
+using detail::split_fields;
+using detail::trim;
+
+constexpr char kMagic[8] = {'L', 'S', 'I', 'M', 'T', 'A', 'P', 'E'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kEndianMark = 0x01020304u;
+constexpr std::size_t kAlign = 64;
+
+struct TapeHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t endian;
+  std::uint64_t loans;
+  std::uint64_t principal_offset;
+  std::uint64_t rate_offset;
+  std::uint64_t term_offset;
+  std::uint64_t reserved[2];
+};
+static_assert(sizeof(TapeHeader) == 64);
+static_assert(std::endian::native == std::endian::little,
+              "columnar tapes are stored little-endian");
+
+constexpr std::size_t align_up(std::size_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+TapeHeader make_header(std::size_t loans) {
+  TapeHeader h{};
+  std::memcpy(h.magic, kMagic, sizeof kMagic);
+  h.version = kVersion;
+  h.endian = kEndianMark;
+  h.loans = loans;
+  h.principal_offset = align_up(sizeof(TapeHeader));
+  h.rate_offset = align_up(h.principal_offset + loans * sizeof(double));
+  h.term_offset = align_up(h.rate_offset + loans * sizeof(double));
+  return h;
+}
+
+std::size_t file_size(const TapeHeader& h) {
+  return h.term_offset + h.loans * sizeof(std::int32_t);
+}
+
+template <class T>
+bool parse_number(std::string_view field, T& out) {
+  field = trim(field);
+  if (!field.empty() && field.front() == '+') field.remove_prefix(1);
+  const auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), out);
+  return ec == std::errc{} && ptr == field.data() + field.size();
+}
+
+/// One line of the mapped text, without its terminator.
+struct Line {
+  std::string_view text;
+  const char* next;
+};
+
+Line next_line(const char* p, const char* end) {
+  const auto* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+  const char* stop = nl ? nl : end;
+  const char* text_end = stop;
+  if (text_end > p && text_end[-1] == '\r') --text_end;
+  return {{p, static_cast<std::size_t>(text_end - p)}, nl ? nl + 1 : end};
+}
+
+/// Index of column `name` in the header `fields`, or -1.
+int column_index(const std::vector<std::string_view>& fields, std::string_view name) {
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    if (trim(fields[i]) == name) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+}  // namespace
+
+CsvTapeReader::CsvTapeReader(const std::string& path, CsvTapeOptions options)
+    : path_(path), options_(std::move(options)), file_(MappedFile::open(path)) {
+  if (options_.chunk_rows == 0) throw std::invalid_argument("CsvTapeReader: chunk_rows is 0");
+  const auto* begin = reinterpret_cast<const char*>(file_.bytes().data());
+  const char* end = begin + file_.size();
+  if (begin == end) parse_error(path_, 1, "empty tape");
+
+  const Line header = next_line(begin, end);
+  body_offset_ = static_cast<std::size_t>(header.next - begin);
+  std::string_view rest = header.text;
+  if (rest.substr(0, 3) == "\xEF\xBB\xBF") rest.remove_prefix(3);  // UTF-8 BOM
+  for (int index = 0;; ++index) {
+    const std::size_t cut = rest.find(options_.delimiter);
+    const std::string_view name = trim(rest.substr(0, cut));
+    if (name == options_.principal_column) principal_index_ = index;
+    if (name == options_.rate_column) rate_index_ = index;
+    if (name == options_.term_column) term_index_ = index;
+    field_count_ = index + 1;
+    if (cut == std::string_view::npos) break;
+    rest.remove_prefix(cut + 1);
+  }
+  if (principal_index_ < 0 || rate_index_ < 0 || term_index_ < 0) {
+    parse_error(path_, 1, "header is missing a principal, rate or term column");
+  }
+}
+
+std::size_t CsvTapeReader::count_rows() const {
+  const auto* p = reinterpret_cast<const char*>(file_.bytes().data()) + body_offset_;
+  const char* end = reinterpret_cast<const char*>(file_.bytes().data()) + file_.size();
+  std::size_t rows = 0;
+  while (p < end) {
+    const Line line = next_line(p, end);
+    rows += line.text.empty() ? 0 : 1;
+    p = line.next;
+  }
+  return rows;
+}
+
+void CsvTapeReader::for_each_chunk(
+    const std::function<void(const LoanColumns& chunk)>& fn) const {
+  const std::size_t cap = options_.chunk_rows;
+  std::vector<double> principal(cap);
+  std::vector<double> rate(cap);
+  std::vector<std::int32_t> term(cap);
+  std::size_t filled = 0;
+  const auto flush = [&] {
+    fn(LoanColumns{{principal.data(), filled}, {rate.data(), filled}, {term.data(), filled}});
+    filled = 0;
+  };
+
+  const int last_needed = std::max({principal_index_, rate_index_, term_index_});
+  const char delim = options_.delimiter;
+  const auto* p = reinterpret_cast<const char*>(file_.bytes().data()) + body_offset_;
+  const char* end = reinterpret_cast<const char*>(file_.bytes().data()) + file_.size();
+  for (std::size_t line_no = 2; p < end; ++line_no) {
+    const Line line = next_line(p, end);
+    p = line.next;
+    if (line.text.empty()) continue;
+
+    std::string_view rest = line.text;
+    int seen = 0;
+    for (int index = 0; index <= last_needed; ++index) {
+      const std::size_t cut = rest.find(delim);
+      const std::string_view field = rest.substr(0, cut);
+      bool ok = true;
+      if (index == principal_index_) {
+        ok = parse_number(field, principal[filled]);
+        ++seen;
+      } else if (index == rate_index_) {
+        ok = parse_number(field, rate[filled]);
+        rate[filled] *= options_.rate_scale;
+        ++seen;
+      } else if (index == term_index_) {
+        ok = parse_number(field, term[filled]);
+        ++seen;
+      }
+      if (!ok) parse_error(path_, line_no, "malformed numeric field");
+      if (cut == std::string_view::npos) break;
+      rest.remove_prefix(cut + 1);
+    }
+    if (seen != 3) parse_error(path_, line_no, "row has too few fields");
+    if (++filled == cap) flush();
+  }
+  if (filled != 0) flush();
+}
+
+LoanPool CsvTapeReader::read_all() const {
+  const std::size_t rows = count_rows();
+  StageScope scope(Stage::load, rows);
+  scope.add_bytes(rows * (2 * sizeof(double) + sizeof(std::int32_t)));
+  LoanPool pool;
+  pool.reserve(rows);
+  for_each_chunk([&](const LoanColumns& chunk) {
+    pool.principal.insert(pool.principal.end(), chunk.principal.begin(), chunk.principal.end());
+    pool.annual_rate.insert(pool.annual_rate.end(), chunk.annual_rate.begin(),
+                            chunk.annual_rate.end());
+    pool.term_months.insert(pool.term_months.end(), chunk.term_months.begin(),
+                            chunk.term_months.end());
+  });
+  return pool;
+}
+
+ProductBook CsvTapeReader::read_products() const {
+  StageScope scope(Stage::load, 0);
+  const auto* begin = reinterpret_cast<const char*>(file_.bytes().data());
+  const char* end = begin + file_.size();
+  std::string_view header = next_line(begin, end).text;
+  if (header.substr(0, 3) == "\xEF\xBB\xBF") header.remove_prefix(3);
+  std::vector<std::string_view> fields;
+  split_fields(header, options_.delimiter, fields);
+  const int product_index = column_index(fields, "product");
+  const int io_index = column_index(fields, "io_months");
+  const int first_reset_index = column_index(fields, "first_reset");
+  const int reset_months_index = column_index(fields, "reset_months");
+  const int margin_index = column_index(fields, "margin");
+  const int periodic_cap_index = column_index(fields, "periodic_cap");
+  const int lifetime_cap_index = column_index(fields, "lifetime_cap");
+  const int floor_index = column_index(fields, "rate_floor");
+
+  ProductBook book;
+  const char* p = begin + body_offset_;
+  for (std::size_t line_no = 2; p < end; ++line_no) {
+    const Line line = next_line(p, end);
+    p = line.next;
+    if (line.text.empty()) continue;
+    split_fields(line.text, options_.delimiter, fields);
+
+    // Optional columns that are absent or blank keep `out` unchanged.
+    const auto optional = [&](int index, auto& out) {
+      if (index < 0 || static_cast<std::size_t>(index) >= fields.size()) return false;
+      if (trim(fields[index]).empty()) return false;
+      if (!parse_number(fields[index], out)) parse_error(path_, line_no, "malformed numeric field");
+      return true;
+    };
+    const auto optional_rate = [&](int index, double& out) {
+      if (optional(index, out)) out *= options_.rate_scale;
+    };
+    const auto required = [&](int index, auto& out) {
+      if (static_cast<std::size_t>(index) >= fields.size()) {
+        parse_error(path_, line_no, "row has too few fields");
+      }
+      if (!parse_number(fields[index], out)) parse_error(path_, line_no, "malformed numeric field");
+    };
+    double principal = 0.0;
+    double rate = 0.0;
+    std::int32_t term = 0;
+    required(principal_index_, principal);
+    required(rate_index_, rate);
+    required(term_index_, term);
+    rate *= options_.rate_scale;
+
+    Product product = Product::fixed;
+    if (product_index >= 0 && static_cast<std::size_t>(product_index) < fields.size() &&
+        !trim(fields[product_index]).empty()) {
+      try {
+        product = parse_product(trim(fields[product_index]));
+      } catch (const std::invalid_argument& e) {
+        parse_error(path_, line_no, e.what());
+      }
+    }
+    try {
+      switch (product) {
+        case Product::fixed:
+          book.add_fixed(principal, rate, term);
+          break;
+        case Product::interest_only: {
+          std::int32_t io = 0;
+          optional(io_index, io);
+          book.add_interest_only(principal, rate, term, io);
+          break;
+        }
+        case Product::arm: {
+          ArmTerms terms;
+          optional(first_reset_index, terms.first_reset);
+          optional(reset_months_index, terms.reset_months);
+          optional_rate(margin_index, terms.margin);
+          optional_rate(periodic_cap_index, terms.periodic_cap);
+          optional_rate(lifetime_cap_index, terms.lifetime_cap);
+          optional_rate(floor_index, terms.floor);
+          book.add_arm(principal, rate, term, terms);
+          break;
+        }
+      }
+    } catch (const std::invalid_argument& e) {
+      parse_error(path_, line_no, e.what());
+    }
+  }
+  scope.add_loans(book.size());
+  scope.add_bytes(book.size() * (2 * sizeof(double) + sizeof(std::int32_t)));
+  return book;
+}
+
+bool CsvTapeReader::has_column(std::string_view name) const {
+  const auto* begin = reinterpret_cast<const char*>(file_.bytes().data());
+  std::string_view header = next_line(begin, begin + file_.size()).text;
+  if (header.substr(0, 3) == "\xEF\xBB\xBF") header.remove_prefix(3);
+  std::vector<std::string_view> fields;
+  split_fields(header, options_.delimiter, fields);
+  return column_index(fields, name) >= 0;
+}
+
+std::vector<std::string> CsvTapeReader::column_names() const {
+  const auto* begin = reinterpret_cast<const char*>(file_.bytes().data());
+  std::string_view header = next_line(begin, begin + file_.size()).text;
+  if (header.substr(0, 3) == "\xEF\xBB\xBF") header.remove_prefix(3);
+  std::vector<std::string_view> fields;
+  split_fields(header, options_.delimiter, fields);
+  std::vector<std::string> names;
+  names.reserve(fields.size());
+  for (const std::string_view f : fields) names.emplace_back(trim(f));
+  return names;
+}
+
+void CsvTapeReader::for_each_row(
+    const std::function<void(std::size_t line, std::span<const std::string_view> fields)>& fn)
+    const {
+  const auto* begin = reinterpret_cast<const char*>(file_.bytes().data());
+  const char* end = begin + file_.size();
+  std::vector<std::string_view> fields;
+  const char* p = begin + body_offset_;
+  for (std::size_t line_no = 2; p < end; ++line_no) {
+    const Line line = next_line(p, end);
+    p = line.next;
+    if (line.text.empty()) continue;
+    split_fields(line.text, options_.delimiter, fields);
+    fn(line_no, fields);
+  }
+}
+
+bool ColumnarTape::is_columnar(const std::string& path) {
+  const MappedFile file = MappedFile::open(path);
+  return file.size() >= sizeof kMagic &&
+         std::memcmp(file.bytes().data(), kMagic, sizeof kMagic) == 0;
+}
+
+ColumnarTape ColumnarTape::open(const std::string& path) {
+  StageScope scope(Stage::load, 0);
+  ColumnarTape tape;
+  tape.file_ = MappedFile::open(path);
+  const std::span<const std::byte> bytes = tape.file_.bytes();
+  TapeHeader h{};
+  if (bytes.size() < sizeof h) throw std::runtime_error(path + ": truncated tape header");
+  std::memcpy(&h, bytes.data(), sizeof h);
+  if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0) {
+    throw std::runtime_error(path + ": not a columnar loan tape");
+  }
+  if (h.version != kVersion || h.endian != kEndianMark) {
+    throw std::runtime_error(path + ": unsupported tape version or byte order");
+  }
+  // Bound the untrusted count by the file size before any arithmetic on it.
+  constexpr std::size_t kRowBytes = 2 * sizeof(double) + sizeof(std::int32_t);
+  if (h.loans > (bytes.size() - sizeof h) / kRowBytes) {
+    throw std::runtime_error(path + ": corrupt tape layout");
+  }
+  const TapeHeader expected = make_header(h.loans);
+  if (h.principal_offset != expected.principal_offset || h.rate_offset != expected.rate_offset ||
+      h.term_offset != expected.term_offset || bytes.size() < file_size(expected)) {
+    throw std::runtime_error(path + ": corrupt tape layout");
+  }
+  const auto* base = bytes.data();
+  const auto n = static_cast<std::size_t>(h.loans);
+  tape.columns_ = LoanColumns{
+      {reinterpret_cast<const double*>(base + h.principal_offset), n},
+      {reinterpret_cast<const double*>(base + h.rate_offset), n},
+      {reinterpret_cast<const std::int32_t*>(base + h.term_offset), n}};
+  scope.add_loans(n);
+  return tape;
+}
+
+void write_columnar_tape(const LoanColumns& loans, const std::string& path) {
+  loans.validate();
+  const StageScope scope(Stage::output, loans.size());
+  const TapeHeader h = make_header(loans.size());
+  MappedFile out = MappedFile::create(path, file_size(h));
+  std::byte* base = out.writable_bytes().data();
+  std::memcpy(base, &h, sizeof h);
+  std::memcpy(base + h.principal_offset, loans.principal.data(), loans.size() * sizeof(double));
+  std::memcpy(base + h.rate_offset, loans.annual_rate.data(), loans.size() * sizeof(double));
+  std::memcpy(base + h.term_offset, loans.term_months.data(),
+              loans.size() * sizeof(std::int32_t));
+}
+
+void write_csv_tape(const LoanColumns& loans, const std::string& path) {
+  loans.validate();
+  const StageScope scope(Stage::output, loans.size());
+  std::FILE* out = std::fopen(path.c_str(), "w");
+  if (out == nullptr) throw std::runtime_error("cannot create " + path);
+  const CsvTapeOptions names;
+  std::fprintf(out, "%s,%s,%s\n", names.principal_column.c_str(), names.rate_column.c_str(),
+               names.term_column.c_str());
+  char line[96];
+  for (std::size_t i = 0; i < loans.size(); ++i) {
+    // Shortest round-trip formatting: reading the tape back is exact.
+    char* p = std::to_chars(line, line + sizeof line, loans.principal[i]).ptr;
+    *p++ = ',';
+    p = std::to_chars(p, line + sizeof line, loans.annual_rate[i]).ptr;
+    *p++ = ',';
+    p = std::to_chars(p, line + sizeof line, loans.term_months[i]).ptr;
+    *p++ = '\n';
+    std::fwrite(line, 1, static_cast<std::size_t>(p - line), out);
+  }
+  const bool failed = std::ferror(out) != 0;
+  if (std::fclose(out) != 0 || failed) throw std::runtime_error("error writing " + path);
+}
+
+std::size_t convert_csv_to_columnar(const std::string& csv_path, const std::string& out_path,
+                                    const CsvTapeOptions& options) {
+  // Parsing is streamed into the output mapping, so the whole conversion is
+  // reported as output.
+  StageScope scope(Stage::output, 0);
+  const CsvTapeReader reader(csv_path, options);
+  const std::size_t n = reader.count_rows();
+  const TapeHeader h = make_header(n);
+
+  // Filled under a temporary name and renamed into place, so a failed
+  // conversion never leaves a partial tape at `out_path`.
+  const std::string temp = out_path + ".tmp";
+  std::size_t written = 0;
+  try {
+    MappedFile out = MappedFile::create(temp, file_size(h));
+    std::byte* base = out.writable_bytes().data();
+    std::memcpy(base, &h, sizeof h);
+    reader.for_each_chunk([&](const LoanColumns& chunk) {
+      chunk.validate();
+      const std::size_t k = chunk.size();
+      std::memcpy(base + h.principal_offset + written * sizeof(double), chunk.principal.data(),
+                  k * sizeof(double));
+      std::memcpy(base + h.rate_offset + written * sizeof(double), chunk.annual_rate.data(),
+                  k * sizeof(double));
+      std::memcpy(base + h.term_offset + written * sizeof(std::int32_t),
+                  chunk.term_months.data(), k * sizeof(std::int32_t));
+      written += k;
+    });
+    out.sync();
+  } catch (...) {
+    std::remove(temp.c_str());
+    throw;
+  }
+  if (std::rename(temp.c_str(), out_path.c_str()) != 0) {
+    const int error = errno;
+    std::remove(temp.c_str());
+    throw std::system_error(error, std::generic_category(), "cannot rename " + temp);
+  }
+  scope.add_loans(written);
+  return written;
+}
+
+LoanTape LoanTape::open(const std::string& path, const CsvTapeOptions& options) {
+  // The readers below record the loans and bytes; this scope covers the
+  // format probe as well.
+  const StageScope scope(Stage::load, 0);
+  LoanTape tape;
+  if (ColumnarTape::is_columnar(path)) {
+    tape.storage_ = ColumnarTape::open(path);
+  } else {
+    tape.storage_ = CsvTapeReader(path, options).read_all();
+  }
+  return tape;
+}
+
+LoanColumns LoanTape::columns() const {
+  if (const auto* mapped = std::get_if<ColumnarTape>(&storage_)) return mapped->columns();
+  return std::get<LoanPool>(storage_).columns();
+}
+
+}  // namespace loansim
@@ -0,0 +1,91 @@
+#include "loansim/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include "errno_error.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::throw_errno;
+
+/// Closes the descriptor on scope exit; the mapping outlives it.
+struct FdGuard {
+  int fd;
+  ~FdGuard() {
+    if (fd >= 0) ::close(fd);
+  }
+};
+
+}  // namespace
+
+MappedFile::~MappedFile() { reset(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      writable_(std::exchange(other.writable_, false)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    reset();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    writable_ = std::exchange(other.writable_, false);
+  }
+  return *this;
+}
+
+void MappedFile::reset() noexcept {
+  if (data_ != nullptr) ::munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+  writable_ = false;
+}
+
+MappedFile MappedFile::open(const std::string& path) {
+  const FdGuard fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd.fd < 0) throw_errno("cannot open", path);
+  struct stat st {};
+  if (::fstat(fd.fd, &st) != 0) throw_errno("cannot stat", path);
+
+  MappedFile file;
+  file.size_ = static_cast<std::size_t>(st.st_size);
+  if (file.size_ == 0) return file;
+  void* p = ::mmap(nullptr, file.size_, PROT_READ, MAP_PRIVATE, fd.fd, 0);
+  if (p == MAP_FAILED) throw_errno("cannot map", path);
+  ::madvise(p, file.size_, MADV_SEQUENTIAL);
+  file.data_ = static_cast<std::byte*>(p);
+  return file;
+}
+
+MappedFile MappedFile::create(const std::string& path, std::size_t size) {
+  const FdGuard fd{::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+  if (fd.fd < 0) throw_errno("cannot create", path);
+  if (::ftruncate(fd.fd, static_cast<off_t>(size)) != 0) throw_errno("cannot size", path);
+
+  MappedFile file;
+  file.size_ = size;
+  file.writable_ = true;
+  if (size == 0) return file;
+  void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.fd, 0);
+  if (p == MAP_FAILED) throw_errno("cannot map", path);
+  file.data_ = static_cast<std::byte*>(p);
+  return file;
+}
+
+void MappedFile::sync() {
+  if (!writable_ || size_ == 0) return;
+  if (::msync(data_, size_, MS_SYNC) != 0) {
+    throw std::system_error(errno, std::generic_category(), "cannot sync mapping");
+  }
+}
+
+}  // namespace loansim
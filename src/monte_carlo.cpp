@@ -0,0 +1,967 @@
+#include "loansim/monte_carlo.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "loansim/instrument.hpp"
+#include "loansim/parallel.hpp"
+#include "loansim/payment_kernel.hpp"
+#include "loansim/rng.hpp"
+#include "loansim/schedule.hpp"
+#include "loansim/sobol.hpp"
+
+#include "errno_error.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::throw_errno;
+
+// Paths per block and blocks per wave are fixed so the fold order, and
+// therefore the floating-point result, never depends on the thread count.
+constexpr std::size_t kPathsPerBlock = kMonteCarloPathsPerBlock;
+constexpr std::size_t kBlocksPerWave = 256;
+// Accumulator lanes per path sum: two AVX-512 vectors of float, four of
+// double. Loans are padded to a multiple of this.
+constexpr std::size_t kPathLanes = 16;
+// Loans summed in lane accumulators before each fold into double.
+constexpr std::size_t kFoldLoans = 1'024;
+// Periods between resets of a float path's scheduled balances to the
+// double schedule (PoolModel::anchor).
+constexpr std::size_t kAnchorPeriods = 32;
+
+constexpr char kCheckpointMagic[8] = {'L', 'S', 'I', 'M', 'C', 'K', 'P', 'T'};
+constexpr std::uint32_t kCheckpointVersion = 1;
+constexpr std::uint32_t kEndianMark = 0x01020304u;
+
+/// Path totals summed over one sample unit (a path, an antithetic pair or
+/// a Sobol' replicate), or over the part of it one block ran.
+struct UnitSums {
+  std::size_t unit = 0;
+  std::size_t paths = 0;
+  double pv = 0.0;
+  double loss = 0.0;
+  double pv_control = 0.0;
+  double loss_control = 0.0;
+};
+
+struct BlockResult {
+  PoolCashFlows sum;
+  RunningStats present_value;
+  RunningStats total_loss;
+  RunningCovariance pv_control;    // per path: (pv, control)
+  RunningCovariance loss_control;  // per path: (loss, control)
+  std::pmr::vector<UnitSums> units;  // in path order
+};
+
+/// How paths map to normals and to the independent samples behind the
+/// standard errors. Units are runs of consecutive paths, so a block's
+/// partial units can be folded in block order.
+struct Sampling {
+  explicit Sampling(std::pmr::memory_resource* r) : shifts(r) {}
+
+  bool antithetic = false;
+  std::size_t per_replicate = 0;  // Sobol' draws per shift; 0 = pseudo-random
+  std::optional<SobolSequence> sequence;
+  std::pmr::vector<std::uint32_t> shifts;  // replicate-major, one per dimension
+
+  [[nodiscard]] std::size_t draw(std::size_t path) const noexcept {
+    return antithetic ? path / 2 : path;
+  }
+  [[nodiscard]] std::size_t unit(std::size_t path) const noexcept {
+    return per_replicate == 0 ? draw(path) : draw(path) / per_replicate;
+  }
+};
+
+/// The path-to-unit mapping of `config`, without the Sobol' points.
+Sampling sampling_units(const MonteCarloConfig& config, std::pmr::memory_resource* resource) {
+  Sampling s(resource);
+  s.antithetic = config.antithetic;
+  if (config.sampler == Sampler::sobol) {
+    s.per_replicate = s.draw(config.paths) / config.sobol_replicates;
+  }
+  return s;
+}
+
+Sampling make_sampling(const MonteCarloConfig& config, std::size_t periods,
+                       std::pmr::memory_resource* resource) {
+  Sampling s = sampling_units(config, resource);
+  if (config.sampler != Sampler::sobol) return s;
+  const std::size_t dims = 2 * std::max<std::size_t>(periods, 1);
+  s.sequence.emplace(dims);
+  s.shifts.resize(config.sobol_replicates * dims);
+  const Philox4x32 gen(config.seed);
+  for (std::size_t r = 0; r < config.sobol_replicates; ++r) {
+    for (std::size_t d = 0; d < dims; ++d) {
+      s.shifts[r * dims + d] = gen({static_cast<std::uint32_t>(d), static_cast<std::uint32_t>(r),
+                                    0x5B01'5B01u, 0})[0];
+    }
+  }
+  return s;
+}
+
+/// Per-loan inputs shared read-only by every path, in the path precision.
+/// Arrays are padded to a multiple of kPathLanes with zero-principal,
+/// zero-term loans, which contribute nothing to any flow.
+template <class Real>
+struct PoolModel {
+  explicit PoolModel(std::pmr::memory_resource* r)
+      : rate(r),
+        level(r),
+        base_smm(r),
+        term(r),
+        principal(r),
+        anchor(r),
+        discount(r),
+        pv_speed(r),
+        pv_default(r),
+        loss_speed(r),
+        loss_default(r) {}
+
+  std::size_t loans = 0;
+  std::size_t padded = 0;
+  std::size_t periods = 0;
+  std::pmr::vector<Real> rate;      // monthly
+  std::pmr::vector<Real> level;     // scheduled payment
+  std::pmr::vector<Real> base_smm;  // at a speed multiplier of one
+  std::pmr::vector<Real> term;      // as Real: keeps the maturity select one width
+  std::pmr::vector<Real> principal;
+  // float only: the scheduled balance at the start of period
+  // (j + 1) * kAnchorPeriods at anchor[j * padded + i].
+  std::pmr::vector<Real> anchor;
+  std::pmr::vector<double> discount;  // per period
+  // Control variate weights per period (empty unless enabled): d PV / d
+  // multiplier and d loss / d multiplier along the base path.
+  std::pmr::vector<double> pv_speed;
+  std::pmr::vector<double> pv_default;
+  std::pmr::vector<double> loss_speed;
+  std::pmr::vector<double> loss_default;
+};
+
+/// One worker's per-loan path state, allocated from its own arena.
+template <class Real>
+struct Scratch {
+  Scratch(std::size_t loans, std::size_t periods, bool rate_paths, std::pmr::memory_resource* r)
+      : sched_balance(loans, r),
+        survival(loans, r),
+        normals(2 * periods, r),
+        rates(rate_paths ? kPathsPerBlock * periods : 0, r),
+        rate_scratch(rate_paths ? rate_path_scratch(periods) : 0, r) {}
+
+  std::pmr::vector<Real> sched_balance;
+  std::pmr::vector<Real> survival;
+  std::pmr::vector<double> normals;       // speed and default draw of each period, interleaved
+  std::pmr::vector<double> rates;         // the current block's rate paths, path-major
+  std::pmr::vector<double> rate_scratch;  // generate_rate_paths() lane batches
+};
+
+double base_smm(const MonteCarloConfig& config, double annual_rate) {
+  const double incentive = annual_rate - config.market_rate;
+  const double cpr =
+      std::min(config.base_cpr * std::exp(config.refi_sensitivity * incentive), 0.99);
+  return 1.0 - std::pow(1.0 - cpr, 1.0 / 12.0);
+}
+
+double base_mdr(const MonteCarloConfig& config) {
+  return 1.0 - std::pow(1.0 - config.base_cdr, 1.0 / 12.0);
+}
+
+/// Fills the control variate weights of `m`. Each loan is run once at the
+/// base path (both multipliers one) from its closed-form schedule, then
+/// swept backwards: with U_t and L_t the PV and loss of a loan's flows from
+/// period t on per unit of surviving balance fraction, a period's
+/// sensitivities to its SMM s and default rate d are
+///
+///   dPV/ds   = q (1-d) (D_t after - U_{t+1})
+///   dPV/dd   = q (D_t (b (1-sev) - in - sp - after s) - (1-s) U_{t+1})
+///   dLoss/ds = -q (1-d) L_{t+1}
+///   dLoss/dd = q (sev b - (1-s) L_{t+1})
+///
+/// and the multipliers scale s and d, so their weights are these times the
+/// base s and d, summed over loans.
+template <class Real>
+void control_weights(const LoanColumns& loans, std::span<const double> level,
+                     const MonteCarloConfig& config, PoolModel<Real>& m) {
+  for (std::pmr::vector<double>* v : {&m.pv_speed, &m.pv_default, &m.loss_speed,
+                                      &m.loss_default}) {
+    v->assign(m.periods, 0.0);
+  }
+  const double d = base_mdr(config);
+  const double sev = config.severity;
+  std::vector<double> balance(m.periods), interest(m.periods), sched(m.periods),
+      survival(m.periods);
+  for (std::size_t i = 0; i < m.loans; ++i) {
+    const double r = loans.annual_rate[i] / 12.0;
+    const double s = base_smm(config, loans.annual_rate[i]);
+    const auto term = static_cast<std::size_t>(loans.term_months[i]);
+    const double decay = (1.0 - d) * (1.0 - s);
+    double b = loans.principal[i];
+    double q = 1.0;
+    for (std::size_t t = 0; t < term; ++t) {
+      const double in = b * r;
+      survival[t] = q;
+      q *= decay;
+      balance[t] = b;
+      interest[t] = in;
+      sched[t] = t + 1 == term ? b : std::min(level[i] - in, b);
+      b -= sched[t];
+    }
+    double u = 0.0;
+    double l = 0.0;
+    for (std::size_t t = term; t-- > 0;) {
+      const double q = survival[t];
+      const double bt = balance[t];
+      const double after = bt - sched[t];
+      const double df = m.discount[t];
+      m.pv_speed[t] += s * q * (1.0 - d) * (df * after - u);
+      m.pv_default[t] +=
+          d * q * (df * (bt * (1.0 - sev) - interest[t] - sched[t] - after * s) - (1.0 - s) * u);
+      m.loss_speed[t] -= s * q * (1.0 - d) * l;
+      m.loss_default[t] += d * q * (sev * bt - (1.0 - s) * l);
+      u = df * ((1.0 - d) * (interest[t] + sched[t] + after * s) + bt * d * (1.0 - sev)) +
+          decay * u;
+      l = sev * bt * d + decay * l;
+    }
+  }
+}
+
+template <class Real>
+PoolModel<Real> build_model(const LoanColumns& loans, const MonteCarloConfig& config,
+                            std::pmr::memory_resource* resource) {
+  PoolModel<Real> m(resource);
+  m.loans = loans.size();
+  m.padded = (m.loans + kPathLanes - 1) / kPathLanes * kPathLanes;
+  m.periods = max_term(loans);
+  for (std::pmr::vector<Real>* v : {&m.rate, &m.level, &m.base_smm, &m.term, &m.principal}) {
+    v->assign(m.padded, Real(0));
+  }
+  // Model inputs are derived in double and rounded once.
+  std::vector<double> level(m.loans);
+  level_payments(loans, level);
+  for (std::size_t i = 0; i < m.loans; ++i) {
+    m.rate[i] = static_cast<Real>(loans.annual_rate[i] / 12.0);
+    m.level[i] = static_cast<Real>(level[i]);
+    m.term[i] = static_cast<Real>(loans.term_months[i]);
+    m.principal[i] = static_cast<Real>(loans.principal[i]);
+    m.base_smm[i] = static_cast<Real>(base_smm(config, loans.annual_rate[i]));
+  }
+  // Stepping a balance forward multiplies each period's rounding by 1 + r
+  // for every period left, which in float puts the last payments of long,
+  // high-rate loans outside kFloat32Tolerance. Float paths are therefore
+  // reset to the double schedule every kAnchorPeriods periods, so rounding
+  // compounds over at most that many.
+  if constexpr (std::is_same_v<Real, float>) {
+    const std::size_t anchors = m.periods == 0 ? 0 : (m.periods - 1) / kAnchorPeriods;
+    m.anchor.assign(anchors * m.padded, Real(0));
+    for (std::size_t i = 0; i < m.loans; ++i) {
+      const double rate = loans.annual_rate[i] / 12.0;
+      const auto term = static_cast<std::size_t>(loans.term_months[i]);
+      double b = loans.principal[i];
+      for (std::size_t t = 0; t < term; ++t) {
+        const double sp = t + 1 == term ? b : std::min(level[i] - b * rate, b);
+        b -= sp;
+        const std::size_t j = (t + 1) / kAnchorPeriods;
+        if ((t + 1) % kAnchorPeriods == 0 && j <= anchors) m.anchor[(j - 1) * m.padded + i] = b;
+      }
+    }
+  }
+  m.discount.resize(m.periods);
+  const double monthly = 1.0 + config.discount_rate / 12.0;
+  double df = 1.0;
+  for (double& d : m.discount) d = df /= monthly;
+  if (config.control_variate) control_weights(loans, level, config, m);
+  return m;
+}
+
+/// Path `path`'s normals: z_speed for period t at 2t, z_default at 2t + 1.
+void draw_normals(const Sampling& sampling, const MonteCarloConfig& config, std::size_t path,
+                  std::span<double> out) {
+  const std::size_t draw = sampling.draw(path);
+  const double sign = sampling.antithetic && path % 2 == 1 ? -1.0 : 1.0;
+  if (sampling.sequence) {
+    const std::size_t dims = sampling.sequence->dimensions();
+    const auto point = static_cast<std::uint32_t>(draw % sampling.per_replicate);
+    const std::uint32_t* shift = &sampling.shifts[draw / sampling.per_replicate * dims];
+    for (std::size_t d = 0; d < out.size(); ++d) {
+      out[d] = sign * inverse_normal(sobol_unit(sampling.sequence->bits(point, d), shift[d]));
+    }
+    return;
+  }
+  const NormalStream stream(config.seed, draw);
+  for (std::size_t t = 0; 2 * t < out.size(); ++t) {
+    const auto [z_speed, z_default] = stream.pair(t);
+    out[2 * t] = sign * z_speed;
+    out[2 * t + 1] = sign * z_default;
+  }
+}
+
+/// Adds one path's totals to its block's statistics and sample unit.
+void record_path(const Sampling& sampling, std::size_t path, const PathValues& v,
+                 BlockResult& out) {
+  out.present_value.add(v.present_value);
+  out.total_loss.add(v.total_loss);
+  out.pv_control.add(v.present_value, v.pv_control);
+  out.loss_control.add(v.total_loss, v.loss_control);
+  const std::size_t unit = sampling.unit(path);
+  if (out.units.empty() || out.units.back().unit != unit) out.units.push_back({unit});
+  UnitSums& u = out.units.back();
+  ++u.paths;
+  u.pv += v.present_value;
+  u.loss += v.total_loss;
+  u.pv_control += v.pv_control;
+  u.loss_control += v.loss_control;
+}
+
+/// Simulates path `path` into `out`, on its short rates `rates` (empty
+/// without a rate model); also stores its totals in `*keep` when given.
+template <class Real>
+void simulate_path(const PoolModel<Real>& m, const Sampling& sampling,
+                   const MonteCarloConfig& config, std::size_t path,
+                   std::span<const double> rates, Scratch<Real>& s, BlockResult& out,
+                   PathValues* keep) {
+  draw_normals(sampling, config, path, s.normals);
+  const double phi = config.factor_persistence;
+  const double shock = std::sqrt(1.0 - phi * phi);
+  const double mdr0 = base_mdr(config);
+  const double severity = config.severity;
+  const bool control = !m.pv_speed.empty();
+
+  std::copy(m.principal.begin(), m.principal.end(), s.sched_balance.begin());
+  std::fill(s.survival.begin(), s.survival.end(), Real(1));
+  Real* sb = s.sched_balance.data();
+  Real* q = s.survival.data();
+  const Real* r = m.rate.data();
+  const Real* lvl = m.level.data();
+  const Real* smm0 = m.base_smm.data();
+  const Real* term = m.term.data();
+
+  const double r0 = config.rates.initial;
+  double path_discount = 1.0;
+
+  double speed_x = 0.0;
+  double default_x = 0.0;
+  double pv = 0.0;
+  double path_loss = 0.0;
+  double pv_control = 0.0;
+  double loss_control = 0.0;
+  for (std::size_t t = 0; t < m.periods; ++t) {
+    if (t % kAnchorPeriods == 0 && t > 0 && !m.anchor.empty()) {
+      const Real* anchor = &m.anchor[(t / kAnchorPeriods - 1) * m.padded];
+      std::copy(anchor, anchor + m.padded, sb);
+    }
+    const double z_speed = s.normals[2 * t];
+    const double z_default = s.normals[2 * t + 1];
+    speed_x = t == 0 ? z_speed : phi * speed_x + shock * z_speed;
+    default_x = t == 0 ? z_default : phi * default_x + shock * z_default;
+    // The path factors are scalars per period: computed in double, then
+    // rounded once to the path precision.
+    const double speed_factor = std::exp(config.cpr_volatility * speed_x -
+                                         0.5 * config.cpr_volatility * config.cpr_volatility);
+    const double default_factor = std::exp(config.cdr_volatility * default_x -
+                                           0.5 * config.cdr_volatility * config.cdr_volatility);
+    double rate_factor = 1.0;
+    double discount = m.discount[t];
+    if (!rates.empty()) {
+      // Scalars per path and period, whatever the pool size. Adding the
+      // move to discount_rate (rather than re-spreading r_t) keeps a flat
+      // path's factors exactly those of the fixed-rate run.
+      const double move = rates[t] - r0;
+      rate_factor = std::exp(-config.refi_sensitivity * move);
+      path_discount /= 1.0 + (config.discount_rate + move) / 12.0;
+      discount = path_discount;
+    }
+    const auto speed = static_cast<Real>(speed_factor * rate_factor);
+    const auto mdr = static_cast<Real>(std::min(1.0, mdr0 * default_factor));
+    if (control) {
+      // Both multipliers have mean one, so each control has mean zero.
+      pv_control += m.pv_speed[t] * (speed_factor - 1.0) + m.pv_default[t] * (default_factor - 1.0);
+      loss_control +=
+          m.loss_speed[t] * (speed_factor - 1.0) + m.loss_default[t] * (default_factor - 1.0);
+    }
+    const Real last = static_cast<Real>(t + 1);
+
+    // Each loan tracks its no-prepay scheduled balance and the fraction of
+    // it still performing; matured loans have a zero scheduled balance, so
+    // every flow below vanishes for them without a branch.
+    //
+    // Sums run in kPathLanes independent accumulators (so the loop
+    // vectorizes without reassociation) over one run of kFoldLoans loans,
+    // then fold into double in a fixed order. A float run's rounding
+    // therefore never accumulates across the whole pool.
+    double interest = 0.0, sched = 0.0, prepay = 0.0, defaults = 0.0, balance = 0.0;
+    for (std::size_t begin = 0; begin < m.padded; begin += kFoldLoans) {
+      const std::size_t end = std::min(begin + kFoldLoans, m.padded);
+      std::array<Real, kPathLanes> a_in{}, a_sp{}, a_pp{}, a_d{}, a_bal{};
+      for (std::size_t i = begin; i < end; i += kPathLanes) {
+        for (std::size_t j = 0; j < kPathLanes; ++j) {
+          const std::size_t k = i + j;
+          const Real b = sb[k];
+          const Real survive = q[k];
+          const Real in = b * r[k];
+          const Real due = lvl[k] - in;
+          const Real scheduled = due < b ? due : b;
+          const Real sp = term[k] == last ? b : scheduled;
+          const Real after = b - sp;
+          const Real alive = survive * (Real(1) - mdr);
+          const Real rate = smm0[k] * speed;
+          // The cap tests `keep` rather than `rate` so that `keep` is needed
+          // on both arms; otherwise it is sunk into a branch and the loop
+          // no longer if-converts.
+          const Real keep = Real(1) - rate;
+          const bool capped = !(keep > Real(0));
+          const Real smm = capped ? Real(1) : rate;
+          const Real stay = capped ? Real(0) : keep;
+          const Real remaining = alive * stay;
+          sb[k] = after;
+          q[k] = remaining;
+          a_d[j] += b * survive * mdr;
+          a_in[j] += in * alive;
+          a_sp[j] += sp * alive;
+          a_pp[j] += after * alive * smm;
+          a_bal[j] += after * remaining;
+        }
+      }
+      for (std::size_t j = 0; j < kPathLanes; ++j) {
+        interest += a_in[j];
+        sched += a_sp[j];
+        prepay += a_pp[j];
+        defaults += a_d[j];
+        balance += a_bal[j];
+      }
+    }
+    const double loss = defaults * severity;
+    out.sum.interest[t] += interest;
+    out.sum.scheduled_principal[t] += sched;
+    out.sum.prepayment[t] += prepay;
+    out.sum.defaults[t] += defaults;
+    out.sum.loss[t] += loss;
+    out.sum.balance[t] += balance;
+    pv += discount * (interest + sched + prepay + (defaults - loss));
+    path_loss += loss;
+  }
+  const PathValues values{pv, path_loss, pv_control, loss_control};
+  record_path(sampling, path, values, out);
+  if (keep != nullptr) *keep = values;
+}
+
+/// Mean of a unit-level sample adjusted by `beta` times its control, and
+/// the standard error of that mean.
+Estimate controlled_estimate(const RunningCovariance& units, double beta) {
+  Estimate e;
+  e.samples = units.x.count;
+  e.mean = units.x.mean - beta * units.y.mean;
+  const double variance =
+      units.x.variance() - 2.0 * beta * units.covariance() + beta * beta * units.y.variance();
+  e.std_error = e.samples > 1 ? std::sqrt(std::max(variance, 0.0) / static_cast<double>(e.samples))
+                              : 0.0;
+  return e;
+}
+
+/// Regression coefficient of a path value on its control; zero without one.
+double control_beta(const RunningCovariance& paths) {
+  const double v = paths.y.variance();
+  return v > 0.0 ? paths.covariance() / v : 0.0;
+}
+
+/// Everything simulate() has folded, in block order, before `next_block`.
+struct Fold {
+  std::size_t next_block = 0;
+  PoolCashFlows sum;
+  RunningStats present_value;
+  RunningStats total_loss;
+  // Units are folded into unit-level (value, control) samples once
+  // complete; `pending` carries one that spans blocks.
+  RunningCovariance pv_paths, loss_paths, pv_units, loss_units;
+  UnitSums pending;
+
+  void add(const BlockResult& block) {
+    sum.add(block.sum);
+    present_value.merge(block.present_value);
+    total_loss.merge(block.total_loss);
+    pv_paths.merge(block.pv_control);
+    loss_paths.merge(block.loss_control);
+    for (const UnitSums& u : block.units) {
+      if (u.unit != pending.unit) {
+        finish();
+        pending = UnitSums{u.unit};
+      }
+      pending.paths += u.paths;
+      pending.pv += u.pv;
+      pending.loss += u.loss;
+      pending.pv_control += u.pv_control;
+      pending.loss_control += u.loss_control;
+    }
+  }
+
+  void finish() {
+    if (pending.paths == 0) return;
+    const auto n = static_cast<double>(pending.paths);
+    pv_units.add(pending.pv / n, pending.pv_control / n);
+    loss_units.add(pending.loss / n, pending.loss_control / n);
+  }
+};
+
+/// Checkpoint file layout: this header, the six per-period series of
+/// Fold::sum, then the fold's statistics as raw structs. Snapshots are
+/// read back by the same build on the same machine, so no field is
+/// converted.
+struct CheckpointHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t endian;
+  std::uint64_t fingerprint;
+  std::uint64_t periods;
+  std::uint64_t next_block;
+  std::uint8_t reserved[24];
+};
+static_assert(sizeof(CheckpointHeader) == 64);
+
+/// FNV-1a over the bytes of everything a run's result depends on.
+class Fingerprint {
+ public:
+  void add(const void* data, std::size_t size) noexcept {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) hash_ = (hash_ ^ p[i]) * 0x100'0000'01B3ull;
+  }
+  template <class T>
+  void add(const T& value) noexcept {
+    static_assert(std::is_trivially_copyable_v<T>);
+    add(&value, sizeof value);
+  }
+  template <class T>
+  void add(std::span<const T> values) noexcept {
+    add(values.data(), values.size_bytes());
+  }
+  [[nodiscard]] std::uint64_t value() const noexcept { return hash_; }
+
+ private:
+  std::uint64_t hash_ = 0xCBF2'9CE4'8422'2325ull;
+};
+
+/// Identifies a run for resuming and merging: the loans and every setting
+/// except the thread count and the checkpoint options, none of which
+/// change the result.
+void add_settings(Fingerprint& f, const MonteCarloConfig& c) {
+  f.add(c.paths);
+  f.add(c.seed);
+  f.add(c.precision);
+  f.add(c.sampler);
+  f.add(c.sobol_replicates);
+  f.add(c.antithetic);
+  f.add(c.control_variate);
+  for (const double x : {c.base_cpr, c.refi_sensitivity, c.market_rate, c.cpr_volatility,
+                         c.base_cdr, c.cdr_volatility, c.factor_persistence, c.severity,
+                         c.discount_rate}) {
+    f.add(x);
+  }
+  if (c.rates.enabled()) {
+    f.add(c.rates.kind);
+    for (const double x : {c.rates.initial, c.rates.mean_reversion, c.rates.long_run,
+                           c.rates.volatility}) {
+      f.add(x);
+    }
+  }
+}
+
+std::uint64_t settings_fingerprint(const MonteCarloConfig& config) {
+  Fingerprint f;
+  add_settings(f, config);
+  return f.value();
+}
+
+std::uint64_t run_fingerprint(const LoanColumns& loans, const MonteCarloConfig& config) {
+  Fingerprint f;
+  f.add(loans.size());
+  f.add(loans.principal);
+  f.add(loans.annual_rate);
+  f.add(loans.term_months);
+  add_settings(f, config);
+  return f.value();
+}
+
+template <class T>
+void append(std::vector<std::byte>& out, const T& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  const auto* p = reinterpret_cast<const std::byte*>(&value);
+  out.insert(out.end(), p, p + sizeof value);
+}
+
+template <class T>
+void extract(std::span<const std::byte>& in, T& value) {
+  std::memcpy(&value, in.data(), sizeof value);
+  in = in.subspan(sizeof value);
+}
+
+/// The series of `sum` in file order.
+template <class Flows>
+auto series(Flows& sum) {
+  return std::array{&sum.interest, &sum.scheduled_principal, &sum.prepayment,
+                    &sum.defaults,  &sum.loss,                &sum.balance};
+}
+
+std::size_t checkpoint_size(std::size_t periods) {
+  return sizeof(CheckpointHeader) + 6 * periods * sizeof(double) + 2 * sizeof(RunningStats) +
+         4 * sizeof(RunningCovariance) + sizeof(UnitSums);
+}
+
+/// Syncs the directory holding `path`, so a rename into it is durable.
+void sync_parent(const std::string& path) {
+  std::string dir = std::filesystem::path(path).parent_path().string();
+  if (dir.empty()) dir = ".";
+  const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) throw_errno("cannot open", dir);
+  if (::fsync(fd) != 0) {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    throw_errno("cannot sync", dir);
+  }
+  ::close(fd);
+}
+
+/// Writes `fold` to `path` through a temporary file that is synced and
+/// renamed over it, then syncs the directory, so a kill or crash at any
+/// point leaves the previous snapshot or the new one, never a torn file.
+void write_checkpoint(const std::string& path, std::uint64_t fingerprint, const Fold& fold) {
+  const std::size_t periods = fold.sum.periods();
+  std::vector<std::byte> bytes;
+  bytes.reserve(checkpoint_size(periods));
+  CheckpointHeader h{};
+  std::memcpy(h.magic, kCheckpointMagic, sizeof kCheckpointMagic);
+  h.version = kCheckpointVersion;
+  h.endian = kEndianMark;
+  h.fingerprint = fingerprint;
+  h.periods = periods;
+  h.next_block = fold.next_block;
+  append(bytes, h);
+  for (const std::pmr::vector<double>* v : series(fold.sum)) {
+    const auto* p = reinterpret_cast<const std::byte*>(v->data());
+    bytes.insert(bytes.end(), p, p + periods * sizeof(double));
+  }
+  append(bytes, fold.present_value);
+  append(bytes, fold.total_loss);
+  for (const RunningCovariance* c : {&fold.pv_paths, &fold.loss_paths, &fold.pv_units,
+                                     &fold.loss_units}) {
+    append(bytes, *c);
+  }
+  append(bytes, fold.pending);
+
+  const std::string temp = path + ".tmp";
+  const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) throw_errno("cannot create", temp);
+  std::span<const std::byte> rest = bytes;
+  while (!rest.empty()) {
+    const ssize_t n = ::write(fd, rest.data(), rest.size());
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      const int error = errno;
+      ::close(fd);
+      errno = error;
+      throw_errno("cannot write", temp);
+    }
+    rest = rest.subspan(static_cast<std::size_t>(n));
+  }
+  if (::fsync(fd) != 0) {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    throw_errno("cannot sync", temp);
+  }
+  if (::close(fd) != 0) throw_errno("cannot close", temp);
+  if (std::rename(temp.c_str(), path.c_str()) != 0) throw_errno("cannot rename", temp);
+  sync_parent(path);
+}
+
+/// Restores `fold` from the snapshot at `path`. Returns false if there is
+/// none; throws std::runtime_error if the file is not a snapshot of this run.
+bool read_checkpoint(const std::string& path, std::uint64_t fingerprint, Fold& fold) {
+  std::FILE* in = std::fopen(path.c_str(), "rb");
+  if (in == nullptr) {
+    if (errno == ENOENT) return false;
+    throw_errno("cannot open", path);
+  }
+  const std::size_t periods = fold.sum.periods();
+  std::vector<std::byte> bytes(checkpoint_size(periods) + 1);
+  const std::size_t got = std::fread(bytes.data(), 1, bytes.size(), in);
+  std::fclose(in);
+
+  CheckpointHeader h{};
+  if (got < sizeof h) throw std::runtime_error(path + ": truncated checkpoint");
+  std::memcpy(&h, bytes.data(), sizeof h);
+  if (std::memcmp(h.magic, kCheckpointMagic, sizeof kCheckpointMagic) != 0) {
+    throw std::runtime_error(path + ": not a checkpoint file");
+  }
+  if (h.version != kCheckpointVersion || h.endian != kEndianMark) {
+    throw std::runtime_error(path + ": unsupported checkpoint version or byte order");
+  }
+  if (h.fingerprint != fingerprint || h.periods != periods) {
+    throw std::runtime_error(path + ": checkpoint is from another run (settings, seed or loans)");
+  }
+  if (got != bytes.size() - 1) throw std::runtime_error(path + ": truncated checkpoint");
+
+  std::span<const std::byte> rest = std::span<const std::byte>(bytes).subspan(sizeof h);
+  for (std::pmr::vector<double>* v : series(fold.sum)) {
+    std::memcpy(v->data(), rest.data(), periods * sizeof(double));
+    rest = rest.subspan(periods * sizeof(double));
+  }
+  extract(rest, fold.present_value);
+  extract(rest, fold.total_loss);
+  for (RunningCovariance* c : {&fold.pv_paths, &fold.loss_paths, &fold.pv_units,
+                               &fold.loss_units}) {
+    extract(rest, *c);
+  }
+  extract(rest, fold.pending);
+  fold.next_block = static_cast<std::size_t>(h.next_block);
+  return true;
+}
+
+/// The result of a completed fold.
+MonteCarloResult finish_result(Fold& fold, const MonteCarloConfig& config) {
+  fold.finish();
+  MonteCarloResult result;
+  result.paths = config.paths;
+  result.mean = std::move(fold.sum);
+  result.present_value = fold.present_value;
+  result.total_loss = fold.total_loss;
+  result.present_value_estimate = controlled_estimate(fold.pv_units, control_beta(fold.pv_paths));
+  result.total_loss_estimate = controlled_estimate(fold.loss_units, control_beta(fold.loss_paths));
+  result.mean.scale(1.0 / static_cast<double>(config.paths));
+  return result;
+}
+
+/// Runs the paths of `config`; with `partial` given, also keeps each
+/// path's totals and the unscaled flow sums there.
+template <class Real>
+MonteCarloResult simulate(const LoanColumns& loans, const MonteCarloConfig& config,
+                          RunArenas* arenas, MonteCarloPartial* partial) {
+  const unsigned threads = config.threads == 0 ? default_thread_count() : config.threads;
+  if (arenas != nullptr) arenas->ensure_workers(threads);
+  std::pmr::memory_resource* shared = shared_resource(arenas);
+  const PoolModel<Real> model = build_model<Real>(loans, config, shared);
+  const Sampling sampling = make_sampling(config, model.periods, shared);
+  if (partial != nullptr) partial->paths.resize(config.paths);
+
+  std::pmr::vector<Scratch<Real>> scratch(shared);
+  scratch.reserve(threads);
+  for (unsigned w = 0; w < threads; ++w) {
+    scratch.emplace_back(model.padded, model.periods, config.rates.enabled(),
+                         worker_resource(arenas, w));
+  }
+
+  const std::size_t blocks = (config.paths + kPathsPerBlock - 1) / kPathsPerBlock;
+  // The wave length only bounds memory; the fold is in block order either
+  // way. Checkpointed runs use short waves so snapshots can land often.
+  const std::size_t wave_blocks = config.checkpoint_path.empty()
+                                      ? kBlocksPerWave
+                                      : std::min<std::size_t>(kBlocksPerWave, 4 * threads);
+  std::pmr::vector<BlockResult> wave(shared);
+  wave.reserve(std::min(blocks, wave_blocks));
+  for (std::size_t b = 0; b < std::min(blocks, wave_blocks); ++b) {
+    wave.push_back(BlockResult{PoolCashFlows(model.periods, shared), {}, {}, {}, {},
+                               std::pmr::vector<UnitSums>(shared)});
+    wave.back().units.reserve(kPathsPerBlock);
+  }
+
+  Fold fold;
+  fold.sum.resize(model.periods);
+  std::uint64_t fingerprint = 0;
+  if (!config.checkpoint_path.empty()) {
+    fingerprint = run_fingerprint(loans, config);
+    read_checkpoint(config.checkpoint_path, fingerprint, fold);
+  }
+  auto last_snapshot = std::chrono::steady_clock::now();
+
+  for (std::size_t first = fold.next_block; first < blocks; first += wave_blocks) {
+    const std::size_t count = std::min(wave_blocks, blocks - first);
+    parallel_for(count, threads, [&](std::size_t task, unsigned worker) {
+      BlockResult& block = wave[task];
+      block.sum.clear();
+      block.present_value = {};
+      block.total_loss = {};
+      block.pv_control = {};
+      block.loss_control = {};
+      block.units.clear();
+      const std::size_t begin = (first + task) * kPathsPerBlock;
+      const std::size_t end = std::min(begin + kPathsPerBlock, config.paths);
+      Scratch<Real>& s = scratch[worker];
+      // The block's rate paths are generated once, here, and shared by every
+      // loan on them.
+      if (config.rates.enabled()) {
+        generate_rate_paths(config.rates, config.seed, begin, end - begin, model.periods,
+                            config.antithetic, s.rates, s.rate_scratch);
+      }
+      for (std::size_t p = begin; p < end; ++p) {
+        const std::span<const double> rates =
+            config.rates.enabled()
+                ? std::span<const double>(s.rates).subspan((p - begin) * model.periods,
+                                                            model.periods)
+                : std::span<const double>();
+        simulate_path(model, sampling, config, p, rates, s, block,
+                      partial != nullptr ? &partial->paths[p] : nullptr);
+      }
+    });
+    for (std::size_t b = 0; b < count; ++b) fold.add(wave[b]);
+    fold.next_block = first + count;
+
+    if (config.checkpoint_path.empty() || fold.next_block == blocks) continue;
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last_snapshot).count() >= config.checkpoint_interval) {
+      write_checkpoint(config.checkpoint_path, fingerprint, fold);
+      last_snapshot = now;
+    }
+  }
+  if (!config.checkpoint_path.empty()) std::remove(config.checkpoint_path.c_str());
+  if (partial != nullptr) {
+    partial->settings = settings_fingerprint(config);
+    partial->sum = fold.sum;
+  }
+  return finish_result(fold, config);
+}
+
+template <class Real>
+MonteCarloResult simulate(const LoanColumns& loans, const MonteCarloConfig& config,
+                          RunArenas* arenas) {
+  return simulate<Real>(loans, config, arenas, nullptr);
+}
+
+}  // namespace
+
+const char* to_string(Precision precision) noexcept {
+  switch (precision) {
+    case Precision::float64: return "float64";
+    case Precision::float32: return "float32";
+  }
+  return "unknown";
+}
+
+const char* to_string(Sampler sampler) noexcept {
+  switch (sampler) {
+    case Sampler::pseudo_random: return "pseudo_random";
+    case Sampler::sobol: return "sobol";
+  }
+  return "unknown";
+}
+
+Sampler parse_sampler(std::string_view name) {
+  if (name == "pseudo_random" || name == "philox") return Sampler::pseudo_random;
+  if (name == "sobol") return Sampler::sobol;
+  throw std::invalid_argument("unknown sampler '" + std::string(name) + "'");
+}
+
+Precision parse_precision(std::string_view name) {
+  if (name == "float64" || name == "double") return Precision::float64;
+  if (name == "float32" || name == "float") return Precision::float32;
+  throw std::invalid_argument("unknown precision '" + std::string(name) + "'");
+}
+
+void MonteCarloConfig::validate() const {
+  const auto fail = [](const char* what) {
+    throw std::invalid_argument(std::string("MonteCarloConfig: ") + what);
+  };
+  if (paths == 0) fail("paths must be positive");
+  if (!(base_cpr >= 0.0 && base_cpr < 1.0)) fail("base_cpr must be in [0, 1)");
+  if (!(base_cdr >= 0.0 && base_cdr < 1.0)) fail("base_cdr must be in [0, 1)");
+  if (!(cpr_volatility >= 0.0) || !(cdr_volatility >= 0.0)) fail("negative volatility");
+  if (!(factor_persistence >= 0.0 && factor_persistence < 1.0)) {
+    fail("factor_persistence must be in [0, 1)");
+  }
+  if (!(severity >= 0.0 && severity <= 1.0)) fail("severity must be in [0, 1]");
+  if (!(discount_rate > -12.0)) fail("discount_rate must exceed -1200%");
+  if (!(checkpoint_interval >= 0.0)) fail("checkpoint_interval must be non-negative");
+  rates.validate();
+  if (antithetic && paths % 2 != 0) fail("antithetic sampling needs an even path count");
+  if (sampler == Sampler::sobol) {
+    const std::size_t draws = antithetic ? paths / 2 : paths;
+    if (sobol_replicates < 2) fail("sobol_replicates must be at least 2");
+    if (draws % sobol_replicates != 0) fail("sobol_replicates must divide the draw count");
+    if (draws / sobol_replicates > 0xFFFF'FFFFu) fail("more than 2^32 Sobol' points per replicate");
+  }
+}
+
+MonteCarloResult simulate_pool(const LoanColumns& loans, const MonteCarloConfig& config,
+                               RunArenas* arenas) {
+  loans.validate();
+  config.validate();
+  const StageScope scope(Stage::simulate, loans.size(), arenas);
+  switch (config.precision) {
+    case Precision::float64: return simulate<double>(loans, config, arenas);
+    case Precision::float32: return simulate<float>(loans, config, arenas);
+  }
+  throw std::invalid_argument("MonteCarloConfig: unknown precision");
+}
+
+MonteCarloPartial simulate_partial(const LoanColumns& loans, const MonteCarloConfig& config,
+                                   RunArenas* arenas) {
+  loans.validate();
+  config.validate();
+  if (!config.checkpoint_path.empty()) {
+    throw std::invalid_argument("simulate_partial: checkpointing is not supported");
+  }
+  const StageScope scope(Stage::simulate, loans.size(), arenas);
+  MonteCarloPartial partial;
+  switch (config.precision) {
+    case Precision::float64: (void)simulate<double>(loans, config, arenas, &partial); break;
+    case Precision::float32: (void)simulate<float>(loans, config, arenas, &partial); break;
+  }
+  return partial;
+}
+
+MonteCarloResult merge_partials(std::span<const MonteCarloPartial> parts,
+                                const MonteCarloConfig& config) {
+  config.validate();
+  if (parts.empty()) throw std::invalid_argument("merge_partials: no partials");
+  const std::uint64_t settings = settings_fingerprint(config);
+  Fold fold;
+  for (const MonteCarloPartial& part : parts) {
+    if (part.settings != settings || part.paths.size() != config.paths) {
+      throw std::invalid_argument("merge_partials: partial was run with other settings");
+    }
+    fold.sum.resize(std::max(fold.sum.periods(), part.sum.periods()));
+    fold.sum.add(part.sum);
+  }
+
+  // Each path's pool totals are the sums of its totals over the parts; they
+  // then go through the same blocks and fold as in simulate_pool().
+  const Sampling units = sampling_units(config, std::pmr::get_default_resource());
+  BlockResult block{PoolCashFlows(), {}, {}, {}, {}, std::pmr::vector<UnitSums>()};
+  for (std::size_t begin = 0; begin < config.paths; begin += kPathsPerBlock) {
+    block.present_value = {};
+    block.total_loss = {};
+    block.pv_control = {};
+    block.loss_control = {};
+    block.units.clear();
+    const std::size_t end = std::min(begin + kPathsPerBlock, config.paths);
+    for (std::size_t p = begin; p < end; ++p) {
+      PathValues v = parts[0].paths[p];
+      for (std::size_t i = 1; i < parts.size(); ++i) {
+        const PathValues& w = parts[i].paths[p];
+        v.present_value += w.present_value;
+        v.total_loss += w.total_loss;
+        v.pv_control += w.pv_control;
+        v.loss_control += w.loss_control;
+      }
+      record_path(units, p, v, block);
+    }
+    fold.add(block);
+  }
+  return finish_result(fold, config);
+}
+
+}  // namespace loansim
@@ -0,0 +1,223 @@
+#include "loansim/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace loansim {
+namespace {
+
+/// Chase-Lev work-stealing deque over task indices (Lê et al., "Correct and
+/// Efficient Work-Stealing for Weak Memory Models", 2013).
+///
+/// The owner takes from the bottom; thieves steal from the top. Every task
+/// is pushed before the job is published, so the buffer never grows and is
+/// never written concurrently; only `top_` and `bottom_` are contended.
+class TaskDeque {
+ public:
+  static constexpr std::size_t kEmpty = static_cast<std::size_t>(-1);
+
+  /// Owner only, before the deque is shared.
+  void reset(std::size_t capacity) {
+    tasks_.resize(capacity);
+    top_.store(0, std::memory_order_relaxed);
+    bottom_.store(0, std::memory_order_relaxed);
+  }
+
+  /// Owner only, before the deque is shared.
+  void push(std::size_t task) {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    tasks_[static_cast<std::size_t>(b)] = task;
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /// Owner: the most recently pushed task, or kEmpty.
+  std::size_t take() {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return kEmpty;
+    }
+    std::size_t task = tasks_[static_cast<std::size_t>(b)];
+    if (t == b) {
+      // Last task: race any thief for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        task = kEmpty;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  /// Any thread: the oldest task, or kEmpty if the deque looked empty or
+  /// another thread won the race (see `lost`).
+  std::size_t steal(bool& lost) {
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t b = bottom_.load(std::memory_order_acquire);
+    lost = false;
+    if (t >= b) return kEmpty;
+    const std::size_t task = tasks_[static_cast<std::size_t>(t)];
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      lost = true;
+      return kEmpty;
+    }
+    return task;
+  }
+
+ private:
+  std::vector<std::size_t> tasks_;
+  // Separate cache lines: the owner writes bottom_, thieves write top_.
+  alignas(64) std::atomic<std::int64_t> top_{0};
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+};
+
+/// One parallel_for() call. Slot 0 is the calling thread; pool workers
+/// claim slots 1..threads-1 as they notice the job.
+struct Job {
+  Job(std::size_t tasks, unsigned threads,
+      const std::function<void(std::size_t, unsigned)>& fn)
+      : fn(fn), deques(threads), threads(threads) {
+    // Contiguous ranges per slot keep neighbouring chunks on one core.
+    // Pushed in reverse so each owner takes its range in ascending order;
+    // thieves steal from the far end.
+    for (unsigned s = 0; s < threads; ++s) {
+      const std::size_t begin = tasks * s / threads;
+      const std::size_t end = tasks * (s + 1) / threads;
+      deques[s].reset(end - begin);
+      for (std::size_t t = end; t > begin; --t) deques[s].push(t - 1);
+    }
+  }
+
+  const std::function<void(std::size_t, unsigned)>& fn;
+  std::vector<TaskDeque> deques;
+  const unsigned threads;
+  unsigned next_slot = 1;  // guarded by the pool mutex
+  unsigned active = 0;     // workers inside run(); guarded by the pool mutex
+  std::atomic<bool> cancelled{false};
+  std::mutex failure_mutex;
+  std::exception_ptr failure;
+
+  /// Drains slot `s`'s deque, then steals until every deque is empty.
+  void run(unsigned s) {
+    for (std::size_t t; (t = deques[s].take()) != TaskDeque::kEmpty;) execute(t, s);
+    for (;;) {
+      bool contended = false;
+      for (unsigned k = 1; k < threads; ++k) {
+        bool lost = false;
+        const std::size_t t = deques[(s + k) % threads].steal(lost);
+        contended = contended || lost;
+        if (t != TaskDeque::kEmpty) {
+          execute(t, s);
+          k = 0;  // rescan from the nearest victim
+        }
+      }
+      // No task is ever added once a job starts, so a clean sweep means
+      // whatever is left is already running elsewhere.
+      if (!contended) return;
+    }
+  }
+
+  void execute(std::size_t task, unsigned slot) {
+    if (cancelled.load(std::memory_order_relaxed)) return;
+    try {
+      fn(task, slot);
+    } catch (...) {
+      const std::lock_guard lock(failure_mutex);
+      if (!failure) failure = std::current_exception();
+      cancelled.store(true, std::memory_order_relaxed);
+    }
+  }
+};
+
+/// Process-wide pool of worker threads, started on first use and grown on
+/// demand. Workers sleep on a condition variable between jobs.
+class WorkerPool {
+ public:
+  ~WorkerPool() {
+    {
+      const std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& th : workers_) th.join();
+  }
+
+  void run(Job& job) {
+    {
+      const std::lock_guard lock(mutex_);
+      while (workers_.size() + 1 < job.threads) {
+        workers_.emplace_back([this] { work(); });
+      }
+      open_.push_back(&job);
+    }
+    wake_.notify_all();
+    job.run(0);
+
+    // Close the job to latecomers, then wait for the workers inside it.
+    std::unique_lock lock(mutex_);
+    std::erase(open_, &job);
+    done_.wait(lock, [&] { return job.active == 0; });
+  }
+
+ private:
+  void work() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+      wake_.wait(lock, [&] { return stopping_ || !open_.empty(); });
+      if (stopping_) return;
+      Job& job = *open_.front();
+      const unsigned slot = job.next_slot++;
+      if (job.next_slot == job.threads) open_.erase(open_.begin());
+      ++job.active;
+      lock.unlock();
+      job.run(slot);
+      lock.lock();
+      if (--job.active == 0) done_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::vector<Job*> open_;  // jobs with unclaimed slots
+  std::vector<std::thread> workers_;
+  bool stopping_ = false;
+};
+
+WorkerPool& pool() {
+  static WorkerPool p;
+  return p;
+}
+
+}  // namespace
+
+unsigned default_thread_count() noexcept {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallel_for(std::size_t tasks, unsigned threads,
+                  const std::function<void(std::size_t task, unsigned worker)>& fn) {
+  if (threads == 0) threads = default_thread_count();
+  const auto workers = static_cast<unsigned>(std::min<std::size_t>(threads, tasks));
+  if (workers <= 1) {
+    for (std::size_t t = 0; t < tasks; ++t) fn(t, 0);
+    return;
+  }
+  Job job(tasks, workers, fn);
+  pool().run(job);
+  if (job.failure) std::rethrow_exception(job.failure);
+}
+
+}  // namespace loansim
@@ -0,0 +1,138 @@
+#include "loansim/payment_kernel.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+
+#include "payment_kernel_impl.hpp"
+
+namespace loansim {
+namespace detail {
+namespace {
+
+void scalar_payments(const double* principal, const double* annual_rate,
+                     const std::int32_t* term, double* payment, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    payment[i] = level_payment(principal[i], annual_rate[i], term[i]);
+  }
+}
+
+void scalar_balances(const double* principal, const double* annual_rate,
+                     const std::int32_t* term, const double* payment,
+                     const std::int32_t* elapsed, double* balance, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    balance[i] = remaining_balance(principal[i], annual_rate[i], term[i], payment[i],
+                                   elapsed[i]);
+  }
+}
+
+}  // namespace
+
+const PaymentKernel scalar_payment_kernel{scalar_payments, scalar_balances};
+
+}  // namespace detail
+
+namespace {
+
+bool cpu_supports(SimdLevel level) noexcept {
+  switch (level) {
+    case SimdLevel::scalar:
+      return true;
+    case SimdLevel::avx2:
+#if defined(LOANSIM_HAVE_AVX2)
+      return __builtin_cpu_supports("avx2");
+#else
+      return false;
+#endif
+    case SimdLevel::avx512:
+#if defined(LOANSIM_HAVE_AVX512)
+      return __builtin_cpu_supports("avx512f");
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+SimdLevel initial_level() noexcept {
+  if (const char* env = std::getenv("LOANSIM_SIMD")) {
+    const std::string_view name(env);
+    for (const SimdLevel level : {SimdLevel::scalar, SimdLevel::avx2, SimdLevel::avx512}) {
+      if (name == to_string(level) && cpu_supports(level)) return level;
+    }
+  }
+  return detect_simd_level();
+}
+
+std::atomic<SimdLevel>& active_level() noexcept {
+  static std::atomic<SimdLevel> level{initial_level()};
+  return level;
+}
+
+const detail::PaymentKernel& kernel() noexcept {
+  switch (active_level().load(std::memory_order_relaxed)) {
+#if defined(LOANSIM_HAVE_AVX512)
+    case SimdLevel::avx512:
+      return detail::avx512_payment_kernel;
+#endif
+#if defined(LOANSIM_HAVE_AVX2)
+    case SimdLevel::avx2:
+      return detail::avx2_payment_kernel;
+#endif
+    default:
+      return detail::scalar_payment_kernel;
+  }
+}
+
+}  // namespace
+
+const char* to_string(SimdLevel level) noexcept {
+  switch (level) {
+    case SimdLevel::scalar:
+      return "scalar";
+    case SimdLevel::avx2:
+      return "avx2";
+    case SimdLevel::avx512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+SimdLevel detect_simd_level() noexcept {
+  if (cpu_supports(SimdLevel::avx512)) return SimdLevel::avx512;
+  if (cpu_supports(SimdLevel::avx2)) return SimdLevel::avx2;
+  return SimdLevel::scalar;
+}
+
+SimdLevel simd_level() noexcept { return active_level().load(std::memory_order_relaxed); }
+
+void set_simd_level(SimdLevel level) {
+  if (!cpu_supports(level)) {
+    throw std::invalid_argument(std::string("set_simd_level: ") + to_string(level) +
+                                " is not available");
+  }
+  active_level().store(level, std::memory_order_relaxed);
+}
+
+void level_payments(const LoanColumns& loans, std::span<double> payment) {
+  if (payment.size() != loans.size()) {
+    throw std::invalid_argument("level_payments: output length mismatch");
+  }
+  kernel().payments(loans.principal.data(), loans.annual_rate.data(),
+                    loans.term_months.data(), payment.data(), loans.size());
+}
+
+void remaining_balances(const LoanColumns& loans, std::span<const double> payment,
+                        std::span<const std::int32_t> elapsed,
+                        std::span<double> balance) {
+  const std::size_t n = loans.size();
+  if (payment.size() != n || elapsed.size() != n || balance.size() != n) {
+    throw std::invalid_argument("remaining_balances: length mismatch");
+  }
+  kernel().balances(loans.principal.data(), loans.annual_rate.data(),
+                    loans.term_months.data(), payment.data(), elapsed.data(),
+                    balance.data(), n);
+}
+
+}  // namespace loansim
@@ -0,0 +1,80 @@
+// Built with -mavx2 -ffp-contract=off; only reached after a runtime CPU check.
+
+#include <immintrin.h>
+
+#include "payment_kernel_impl.hpp"
+
+namespace loansim::detail {
+namespace {
+
+constexpr std::size_t kLanes = 4;
+
+/// Lane-wise growth_factor(): same products, same order.
+__m256d growth(__m256d r, __m128i exponent) noexcept {
+  const __m256i one = _mm256_set1_epi64x(1);
+  __m256i bits = _mm256_cvtepi32_epi64(exponent);
+  __m256d f = _mm256_set1_pd(1.0);
+  __m256d base = _mm256_add_pd(_mm256_set1_pd(1.0), r);
+  while (!_mm256_testz_si256(bits, bits)) {
+    const __m256i low = _mm256_and_si256(bits, one);
+    const __m256d take = _mm256_castsi256_pd(_mm256_cmpeq_epi64(low, one));
+    f = _mm256_blendv_pd(f, _mm256_mul_pd(f, base), take);
+    base = _mm256_mul_pd(base, base);
+    bits = _mm256_srli_epi64(bits, 1);
+  }
+  return f;
+}
+
+void payments(const double* principal, const double* annual_rate,
+              const std::int32_t* term, double* payment, std::size_t n) {
+  const __m256d twelve = _mm256_set1_pd(12.0);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d zero = _mm256_setzero_pd();
+  std::size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const __m256d p = _mm256_loadu_pd(principal + i);
+    const __m256d r = _mm256_div_pd(_mm256_loadu_pd(annual_rate + i), twelve);
+    const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(term + i));
+    const __m256d f = growth(r, e);
+    const __m256d amortizing =
+        _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(p, r), f), _mm256_sub_pd(f, one));
+    const __m256d straight = _mm256_div_pd(p, _mm256_cvtepi32_pd(e));
+    const __m256d is_zero = _mm256_cmp_pd(r, zero, _CMP_EQ_OQ);
+    _mm256_storeu_pd(payment + i, _mm256_blendv_pd(amortizing, straight, is_zero));
+  }
+  for (; i < n; ++i) payment[i] = level_payment(principal[i], annual_rate[i], term[i]);
+}
+
+void balances(const double* principal, const double* annual_rate,
+              const std::int32_t* term, const double* payment,
+              const std::int32_t* elapsed, double* balance, std::size_t n) {
+  const __m256d twelve = _mm256_set1_pd(12.0);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d zero = _mm256_setzero_pd();
+  std::size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const __m256d p = _mm256_loadu_pd(principal + i);
+    const __m256d a = _mm256_loadu_pd(payment + i);
+    const __m256d r = _mm256_div_pd(_mm256_loadu_pd(annual_rate + i), twelve);
+    const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(elapsed + i));
+    const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(term + i));
+    const __m256d f = growth(r, k);
+    const __m256d amortizing = _mm256_sub_pd(
+        _mm256_mul_pd(p, f),
+        _mm256_div_pd(_mm256_mul_pd(a, _mm256_sub_pd(f, one)), r));
+    const __m256d straight = _mm256_sub_pd(p, _mm256_mul_pd(a, _mm256_cvtepi32_pd(k)));
+    const __m256d is_zero = _mm256_cmp_pd(r, zero, _CMP_EQ_OQ);
+    const __m256d live = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpgt_epi32(t, k)));
+    const __m256d b = _mm256_blendv_pd(amortizing, straight, is_zero);
+    _mm256_storeu_pd(balance + i, _mm256_and_pd(b, live));
+  }
+  for (; i < n; ++i) {
+    balance[i] = remaining_balance(principal[i], annual_rate[i], term[i], payment[i], elapsed[i]);
+  }
+}
+
+}  // namespace
+
+const PaymentKernel avx2_payment_kernel{payments, balances};
+
+}  // namespace loansim::detail
@@ -0,0 +1,88 @@
+// Built with -mavx512f -ffp-contract=off; only reached after a runtime CPU check.
+
+#include <immintrin.h>
+
+#include "payment_kernel_impl.hpp"
+
+namespace loansim::detail {
+namespace {
+
+constexpr std::size_t kLanes = 8;
+
+// GCC's unmasked forms of these intrinsics pass an undefined vector through
+// as the merge source, which trips -Wmaybe-uninitialized once inlined. The
+// zero-masked forms with every lane selected compute the same values from
+// initialized inputs only.
+constexpr __mmask8 kAllLanes = 0xFF;
+
+__m512i widen(__m256i v) noexcept { return _mm512_maskz_cvtepi32_epi64(kAllLanes, v); }
+__m512d to_double(__m256i v) noexcept { return _mm512_maskz_cvtepi32_pd(kAllLanes, v); }
+
+/// Lane-wise growth_factor(): same products, same order.
+__m512d growth(__m512d r, __m256i exponent) noexcept {
+  const __m512i one = _mm512_set1_epi64(1);
+  __m512i bits = widen(exponent);
+  __m512d f = _mm512_set1_pd(1.0);
+  __m512d base = _mm512_add_pd(_mm512_set1_pd(1.0), r);
+  while (_mm512_test_epi64_mask(bits, bits) != 0) {
+    const __mmask8 take = _mm512_test_epi64_mask(bits, one);
+    f = _mm512_mask_mul_pd(f, take, f, base);
+    base = _mm512_mul_pd(base, base);
+    bits = _mm512_maskz_srli_epi64(kAllLanes, bits, 1);
+  }
+  return f;
+}
+
+void payments(const double* principal, const double* annual_rate,
+              const std::int32_t* term, double* payment, std::size_t n) {
+  const __m512d twelve = _mm512_set1_pd(12.0);
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d zero = _mm512_setzero_pd();
+  std::size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const __m512d p = _mm512_loadu_pd(principal + i);
+    const __m512d r = _mm512_div_pd(_mm512_loadu_pd(annual_rate + i), twelve);
+    const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(term + i));
+    const __m512d f = growth(r, e);
+    const __m512d amortizing =
+        _mm512_div_pd(_mm512_mul_pd(_mm512_mul_pd(p, r), f), _mm512_sub_pd(f, one));
+    const __m512d straight = _mm512_div_pd(p, to_double(e));
+    const __mmask8 is_zero = _mm512_cmp_pd_mask(r, zero, _CMP_EQ_OQ);
+    _mm512_storeu_pd(payment + i, _mm512_mask_blend_pd(is_zero, amortizing, straight));
+  }
+  for (; i < n; ++i) payment[i] = level_payment(principal[i], annual_rate[i], term[i]);
+}
+
+void balances(const double* principal, const double* annual_rate,
+              const std::int32_t* term, const double* payment,
+              const std::int32_t* elapsed, double* balance, std::size_t n) {
+  const __m512d twelve = _mm512_set1_pd(12.0);
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d zero = _mm512_setzero_pd();
+  std::size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const __m512d p = _mm512_loadu_pd(principal + i);
+    const __m512d a = _mm512_loadu_pd(payment + i);
+    const __m512d r = _mm512_div_pd(_mm512_loadu_pd(annual_rate + i), twelve);
+    const __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(elapsed + i));
+    const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(term + i));
+    const __m512d f = growth(r, k);
+    const __m512d amortizing = _mm512_sub_pd(
+        _mm512_mul_pd(p, f),
+        _mm512_div_pd(_mm512_mul_pd(a, _mm512_sub_pd(f, one)), r));
+    const __m512d straight = _mm512_sub_pd(p, _mm512_mul_pd(a, to_double(k)));
+    const __mmask8 is_zero = _mm512_cmp_pd_mask(r, zero, _CMP_EQ_OQ);
+    const __mmask8 live = _mm512_cmp_epi64_mask(widen(t), widen(k), _MM_CMPINT_GT);
+    const __m512d b = _mm512_mask_blend_pd(is_zero, amortizing, straight);
+    _mm512_storeu_pd(balance + i, _mm512_maskz_mov_pd(live, b));
+  }
+  for (; i < n; ++i) {
+    balance[i] = remaining_balance(principal[i], annual_rate[i], term[i], payment[i], elapsed[i]);
+  }
+}
+
+}  // namespace
+
+const PaymentKernel avx512_payment_kernel{payments, balances};
+
+}  // namespace loansim::detail
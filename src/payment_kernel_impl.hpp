@@ -0,0 +1,59 @@
+#pragma once
+
+// Internal to the payment kernel translation units. The ISA-specific files
+// include this for the shared scalar math used on their remainder loops; it
+// must stay free of FMA-contractible expressions so every tier rounds the
+// same way (those files are built with -ffp-contract=off).
+
+#include <cstddef>
+#include <cstdint>
+
+namespace loansim::detail {
+
+struct PaymentKernel {
+  void (*payments)(const double* principal, const double* annual_rate,
+                   const std::int32_t* term, double* payment, std::size_t n);
+  void (*balances)(const double* principal, const double* annual_rate,
+                   const std::int32_t* term, const double* payment,
+                   const std::int32_t* elapsed, double* balance, std::size_t n);
+};
+
+extern const PaymentKernel scalar_payment_kernel;
+#if defined(LOANSIM_HAVE_AVX2)
+extern const PaymentKernel avx2_payment_kernel;
+#endif
+#if defined(LOANSIM_HAVE_AVX512)
+extern const PaymentKernel avx512_payment_kernel;
+#endif
+
+/// (1 + r)^e by square-and-multiply over the bits of e, lowest bit first.
+/// The SIMD kernels replay exactly this sequence of products per lane.
+inline double growth_factor(double r, std::int32_t e) noexcept {
+  double f = 1.0;
+  double base = 1.0 + r;
+  for (auto bits = static_cast<std::uint32_t>(e); bits != 0; bits >>= 1) {
+    if (bits & 1u) f = f * base;
+    base = base * base;
+  }
+  return f;
+}
+
+inline double level_payment(double principal, double annual_rate,
+                            std::int32_t term) noexcept {
+  const double r = annual_rate / 12.0;
+  if (r == 0.0) return principal / static_cast<double>(term);
+  const double f = growth_factor(r, term);
+  return principal * r * f / (f - 1.0);
+}
+
+inline double remaining_balance(double principal, double annual_rate,
+                                std::int32_t term, double payment,
+                                std::int32_t elapsed) noexcept {
+  if (elapsed >= term) return 0.0;
+  const double r = annual_rate / 12.0;
+  if (r == 0.0) return principal - payment * static_cast<double>(elapsed);
+  const double f = growth_factor(r, elapsed);
+  return principal * f - payment * (f - 1.0) / r;
+}
+
+}  // namespace loansim::detail
@@ -0,0 +1,138 @@
+#pragma once
+
+// Internal: per-lane price moments accumulated while a block is stepped,
+// and the batched Newton solve that turns them into yield, duration and
+// convexity without revisiting the cash flows.
+//
+// For a loan with cash flows cf at times τ (years) and a base rate u0
+// (continuously compounded, fixed before the pass), the moments are
+//
+//   S_j = Σ τ^j · cf · e^(-u0 τ),   j = 0 .. kPriceMoments - 1.
+//
+// The price at any other rate u = u0 - δ is then the series
+// P(δ) = Σ S_j δ^j / j!, and its δ-derivatives are the same series shifted
+// by one or two moments, so yield, duration and convexity all come from the
+// moments alone. The series is truncated, so accuracy falls off with the
+// distance between the yield and u0: with eight moments, 30-year loans
+// priced 10 points off par (yields ~250bp from u0) still solve to within
+// 1e-7 in yield and 1e-5 years in duration.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "loansim/analytics.hpp"
+
+namespace loansim::detail {
+
+inline constexpr std::size_t kPriceMoments = 8;
+
+/// Newton steps taken by every lane; the solve is branch-free across lanes.
+inline constexpr int kYieldIterations = 8;
+
+/// Largest |δ| a Newton step may reach; beyond it the series is no longer
+/// a usable price, so the iterate is clamped instead of diverging.
+inline constexpr double kMaxRateShift = 0.5;
+
+/// Periods of discounted flows buffered per lane before they are folded
+/// into the moments, so each moment is loaded and stored once per group
+/// rather than once per period.
+inline constexpr std::size_t kMomentGroup = 4;
+
+/// τ^0 .. τ^(kPriceMoments-1) for period `t` (paid at the end of month t + 1).
+inline void time_powers(std::int32_t t, double* out) noexcept {
+  const double tau = (t + 1) / 12.0;
+  double p = 1.0;
+  for (std::size_t j = 0; j < kPriceMoments; ++j) {
+    out[j] = p;
+    p *= tau;
+  }
+}
+
+/// Folds one group of buffered flows into `moments`. `pv` holds
+/// kMomentGroup rows of `stride` lanes (cash flows already discounted at
+/// each lane's base rate; rows past the last period are zero) and `tpow`
+/// the matching kMomentGroup rows of time_powers(). `moments` is
+/// moment-major with `stride` lanes per moment.
+inline void add_moments(const double* tpow, const double* pv, double* moments,
+                        std::size_t stride, std::size_t padded) noexcept {
+  for (std::size_t k = 0; k < padded; ++k) {
+    double acc[kPriceMoments];
+    for (std::size_t j = 0; j < kPriceMoments; ++j) acc[j] = moments[j * stride + k];
+    for (std::size_t g = 0; g < kMomentGroup; ++g) {
+      const double x = pv[g * stride + k];
+      for (std::size_t j = 0; j < kPriceMoments; ++j) acc[j] += x * tpow[g * kPriceMoments + j];
+    }
+    for (std::size_t j = 0; j < kPriceMoments; ++j) moments[j * stride + k] = acc[j];
+  }
+}
+
+/// Σ_{i ≥ 0} S_{i+Shift} δ^i / i! for one lane, by Horner's rule. `Shift`
+/// is a template argument so the loop has a fixed trip count and unrolls,
+/// leaving the per-lane callers branch-free.
+template <std::size_t Shift>
+double moment_series(const double* moments, std::size_t stride, std::size_t lane,
+                     double delta) noexcept {
+  constexpr auto inverse = [] {
+    std::array<double, kPriceMoments> r{};
+    for (std::size_t i = 1; i < kPriceMoments; ++i) r[i] = 1.0 / static_cast<double>(i);
+    return r;
+  }();
+  double acc = moments[(kPriceMoments - 1) * stride + lane];
+  for (std::size_t i = kPriceMoments - 1 - Shift; i > 0; --i) {
+    acc = moments[(i - 1 + Shift) * stride + lane] + acc * (delta * inverse[i]);
+  }
+  return acc;
+}
+
+/// Solves every lane of a block for the yield at which it is worth
+/// `price * face[k]` and writes lanes [0, n) to `out` starting at `offset`.
+/// `base` is each lane's u0 and `life` its sum of monthly opening balances,
+/// which over `face` gives the WAL. `delta` is `padded`-sized scratch.
+/// Zero-face lanes report zeros for every measure.
+inline void solve_yields(const double* moments, std::size_t stride, const double* base,
+                         const double* face, double price, const double* life, double* delta,
+                         std::size_t n, std::size_t padded, LoanAnalytics& out,
+                         std::size_t offset) noexcept {
+  std::fill_n(delta, padded, 0.0);
+  for (int it = 0; it < kYieldIterations; ++it) {
+    for (std::size_t k = 0; k < padded; ++k) {
+      const double d = delta[k];
+      const double f = moment_series<0>(moments, stride, k, d) - price * face[k];
+      const double slope = moment_series<1>(moments, stride, k, d);
+      // Padding lanes have f = slope = 0; the smallest normal keeps them at
+      // 0 / tiny = 0 without a guard, which would stop the loop vectorizing.
+      // For real lanes it is far below one ulp of the slope.
+      const double next = d - f / (slope + std::numeric_limits<double>::min());
+      const double lo = next > -kMaxRateShift ? next : -kMaxRateShift;
+      delta[k] = lo < kMaxRateShift ? lo : kMaxRateShift;
+    }
+  }
+  for (std::size_t k = 0; k < n; ++k) {
+    const std::size_t i = offset + k;
+    if (face[k] == 0.0) {
+      // Nothing to price: report zeros, as analyze_cash_flows() does for
+      // a stream with no principal, rather than dividing by the face.
+      out.yield[i] = out.macaulay_duration[i] = out.modified_duration[i] = 0.0;
+      out.convexity[i] = out.wal[i] = 0.0;
+      continue;
+    }
+    const double d = delta[k];
+    const double p0 = moment_series<0>(moments, stride, k, d);
+    const double p1 = moment_series<1>(moments, stride, k, d);
+    const double p2 = moment_series<2>(moments, stride, k, d);
+    const double monthly = std::expm1((base[k] - d) / 12.0);
+    const double growth = 1.0 + monthly;
+    out.yield[i] = 12.0 * monthly;
+    out.macaulay_duration[i] = p1 / p0;
+    out.modified_duration[i] = p1 / p0 / growth;
+    // d²P/dy² / P with y the monthly-compounded annual yield.
+    out.convexity[i] = (p2 + p1 / 12.0) / p0 / (growth * growth);
+    out.wal[i] = life[k] / (12.0 * face[k]);
+  }
+}
+
+}  // namespace loansim::detail
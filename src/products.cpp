@@ -0,0 +1,369 @@
+#include "loansim/products.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "loansim/instrument.hpp"
+#include "loansim/parallel.hpp"
+#include "loansim/payment_kernel.hpp"
+#include "loansim/schedule.hpp"
+
+#include "amortize_block.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::AmortizeBlock;
+using detail::kAmortizeBlock;
+
+void check_loan(double principal, double annual_rate, std::int32_t term_months) {
+  const LoanColumns one{{&principal, 1}, {&annual_rate, 1}, {&term_months, 1}};
+  one.validate();
+}
+
+/// Interest-only: no principal is due before period `io`, and the level
+/// payment amortizes over the term left after it.
+class InterestOnlyPolicy {
+ public:
+  /// The block holds group loans `begin + rows[k]`; `s` is freshly loaded.
+  InterestOnlyPolicy(AmortizeBlock& s, const InterestOnlyLoans& group, std::size_t begin,
+                     std::span<const std::uint32_t> rows) {
+    alignas(64) std::array<double, kAmortizeBlock> annual{};
+    alignas(64) std::array<std::int32_t, kAmortizeBlock> amortizing{};
+    const std::size_t n = s.n;
+    for (std::size_t k = 0; k < n; ++k) {
+      const std::size_t i = begin + rows[k];
+      io_[k] = group.io_months[i];
+      annual[k] = group.loans.annual_rate[i];
+      amortizing[k] = group.loans.term_months[i] - group.io_months[i];
+    }
+    const LoanColumns block{{s.bal.data(), n}, {annual.data(), n}, {amortizing.data(), n}};
+    level_payments(block, std::span<double>(s.level.data(), n));
+  }
+
+  void before_period(AmortizeBlock&, std::int32_t) {}
+  [[nodiscard]] double principal(std::size_t k, double t, double scheduled) const {
+    return t < io_[k] ? 0.0 : scheduled;
+  }
+
+ private:
+  alignas(64) std::array<double, kAmortizeBlock> io_{};
+};
+
+/// Adjustable rate: ahead of any period in which some loan in the block
+/// resets, every lane computes its capped new rate and the block's payments
+/// are recast with the SIMD level-payment kernel; selects keep the lanes
+/// that do not reset unchanged.
+class ArmPolicy {
+ public:
+  /// The block holds group loans `begin + rows[k]`.
+  ArmPolicy(AmortizeBlock& s, const ArmLoans& group, std::size_t begin,
+            std::span<const std::uint32_t> rows, std::span<const double> index_path)
+      : index_path_(index_path) {
+    next_reset_.fill(-1.0);  // padding lanes never reset
+    for (std::size_t k = 0; k < s.n; ++k) {
+      const std::size_t i = begin + rows[k];
+      annual_[k] = group.loans.annual_rate[i];
+      next_reset_[k] = group.first_reset[i];
+      reset_months_[k] = group.reset_months[i];
+      margin_[k] = group.margin[i];
+      periodic_cap_[k] = group.periodic_cap[i];
+      lifetime_cap_[k] = group.lifetime_cap[i];
+      floor_[k] = group.floor[i];
+    }
+    next_any_ = s.n == 0 ? 0.0 : *std::min_element(next_reset_.begin(), next_reset_.begin() + s.n);
+  }
+
+  void before_period(AmortizeBlock& s, std::int32_t t) {
+    const double now = t;
+    if (now < next_any_) return;
+
+    const auto at = std::min(static_cast<std::size_t>(t), index_path_.size() - 1);
+    const double index = index_path_[at];
+    // Operands are loaded into locals so min/max/select compile to blends
+    // rather than conditional loads, and the pass vectorizes.
+    for (std::size_t k = 0; k < s.padded; ++k) {
+      const double prev = annual_[k];
+      const double cap = periodic_cap_[k];
+      const double floor = floor_[k];
+      const double ceiling = lifetime_cap_[k];
+      const double target = index + margin_[k];
+      const double lo = floor > prev - cap ? floor : prev - cap;
+      const double hi = ceiling < prev + cap ? ceiling : prev + cap;
+      const double bounded = target > lo ? target : lo;
+      const double next = bounded < hi ? bounded : hi;
+      const double due = next_reset_[k];
+      const bool reset = due == now;
+      annual_[k] = reset ? next : prev;
+      next_reset_[k] = reset ? due + reset_months_[k] : due;
+      recast_[k] = reset ? 1.0 : 0.0;
+    }
+    next_any_ = next_reset_[0];
+    for (std::size_t k = 0; k < s.n; ++k) {
+      s.rate[k] = annual_[k] / 12.0;
+      remaining_[k] = std::max(1, static_cast<std::int32_t>(s.term[k]) - t);
+      next_any_ = std::min(next_any_, next_reset_[k]);
+    }
+    const std::size_t n = s.n;
+    level_payments(LoanColumns{{s.bal.data(), n}, {annual_.data(), n}, {remaining_.data(), n}},
+                   std::span<double>(payment_.data(), n));
+    for (std::size_t k = 0; k < n; ++k) {
+      const double recast = payment_[k];
+      const double level = s.level[k];
+      s.level[k] = recast_[k] != 0.0 ? recast : level;
+    }
+  }
+
+  [[nodiscard]] double principal(std::size_t, double, double scheduled) const {
+    return scheduled;
+  }
+
+ private:
+  std::span<const double> index_path_;
+  double next_any_ = 0.0;  // earliest reset in the block; skips the pass until then
+  alignas(64) std::array<double, kAmortizeBlock> annual_{};
+  alignas(64) std::array<double, kAmortizeBlock> next_reset_{};
+  alignas(64) std::array<double, kAmortizeBlock> reset_months_{};
+  alignas(64) std::array<double, kAmortizeBlock> margin_{};
+  alignas(64) std::array<double, kAmortizeBlock> periodic_cap_{};
+  alignas(64) std::array<double, kAmortizeBlock> lifetime_cap_{};
+  alignas(64) std::array<double, kAmortizeBlock> floor_{};
+  alignas(64) std::array<double, kAmortizeBlock> recast_{};
+  alignas(64) std::array<double, kAmortizeBlock> payment_{};
+  alignas(64) std::array<std::int32_t, kAmortizeBlock> remaining_{};
+};
+
+const LoanPool& group_loans(const ProductBook& book, Product product) {
+  switch (product) {
+    case Product::fixed: return book.fixed();
+    case Product::interest_only: return book.interest_only().loans;
+    case Product::arm: return book.arm().loans;
+  }
+  throw std::invalid_argument("unknown product");
+}
+
+/// Adds the scheduled totals of `book`'s `P` loans [begin, end) into `out`.
+template <Product P>
+void accumulate_group(const ProductBook& book, std::size_t begin, std::size_t end,
+                      std::span<const double> index_path, ScheduledTotals& out) {
+  const LoanColumns loans = group_loans(book, P).columns().slice(begin, end);
+  AmortizeBlock s;
+  detail::for_each_block(loans.term_months, [&](std::span<const std::uint32_t> rows) {
+    s = {};
+    s.load(loans, rows);
+    if constexpr (P == Product::fixed) {
+      detail::LevelPolicy policy;
+      detail::amortize_block(s, policy, out);
+    } else if constexpr (P == Product::interest_only) {
+      InterestOnlyPolicy policy(s, book.interest_only(), begin, rows);
+      detail::amortize_block(s, policy, out);
+    } else {
+      ArmPolicy policy(s, book.arm(), begin, rows, index_path);
+      detail::amortize_block(s, policy, out);
+    }
+  });
+}
+
+struct GroupChunk {
+  Product product;
+  std::size_t begin;
+  std::size_t end;
+  std::span<const double> index_path;  // read by ARM chunks only
+};
+
+/// Appends `product`'s chunks to `chunks`, all on `index_path`, and returns
+/// the group's longest term.
+std::size_t add_chunks(const ProductBook& book, Product product,
+                       std::span<const double> index_path, std::vector<GroupChunk>& chunks) {
+  const LoanColumns loans = group_loans(book, product).columns();
+  for (std::size_t begin = 0; begin < loans.size(); begin += kAggregateChunkLoans) {
+    chunks.push_back(
+        {product, begin, std::min(begin + kAggregateChunkLoans, loans.size()), index_path});
+  }
+  return max_term(loans);
+}
+
+/// Reduces `chunks` in parallel and adds their totals to `total` in chunk
+/// order. `partial` holds the per-chunk totals and is reused across calls.
+void reduce_chunks(const ProductBook& book, std::span<const GroupChunk> chunks,
+                   std::size_t periods, unsigned threads,
+                   std::pmr::vector<ScheduledTotals>& partial, ScheduledTotals& total) {
+  // Partials are sized up front on this thread so workers never allocate.
+  while (partial.size() < chunks.size()) {
+    partial.emplace_back(partial.get_allocator().resource());
+  }
+  for (std::size_t c = 0; c < chunks.size(); ++c) {
+    partial[c].resize(0);
+    partial[c].resize(periods);
+  }
+  parallel_for(chunks.size(), threads, [&](std::size_t task, unsigned) {
+    const GroupChunk& c = chunks[task];
+    switch (c.product) {
+      case Product::fixed:
+        accumulate_group<Product::fixed>(book, c.begin, c.end, c.index_path, partial[task]);
+        break;
+      case Product::interest_only:
+        accumulate_group<Product::interest_only>(book, c.begin, c.end, c.index_path,
+                                                 partial[task]);
+        break;
+      case Product::arm:
+        accumulate_group<Product::arm>(book, c.begin, c.end, c.index_path, partial[task]);
+        break;
+    }
+  });
+  for (std::size_t c = 0; c < chunks.size(); ++c) total.add(partial[c]);
+}
+
+}  // namespace
+
+const char* to_string(Product product) noexcept {
+  switch (product) {
+    case Product::fixed: return "fixed";
+    case Product::interest_only: return "io";
+    case Product::arm: return "arm";
+  }
+  return "unknown";
+}
+
+Product parse_product(std::string_view name) {
+  if (name == "fixed") return Product::fixed;
+  if (name == "io" || name == "interest_only") return Product::interest_only;
+  if (name == "arm") return Product::arm;
+  throw std::invalid_argument("unknown product '" + std::string(name) + "'");
+}
+
+void ArmTerms::validate() const {
+  if (first_reset < 0 || reset_months <= 0) {
+    throw std::invalid_argument("ArmTerms: invalid reset schedule");
+  }
+  if (!std::isfinite(margin)) throw std::invalid_argument("ArmTerms: margin");
+  if (!(periodic_cap >= 0.0)) throw std::invalid_argument("ArmTerms: periodic_cap");
+  if (!(floor >= 0.0 && floor <= lifetime_cap)) {
+    throw std::invalid_argument("ArmTerms: floor must be in [0, lifetime_cap]");
+  }
+}
+
+void ProductBook::add_fixed(double principal, double annual_rate, std::int32_t term_months) {
+  check_loan(principal, annual_rate, term_months);
+  fixed_.push_back(principal, annual_rate, term_months);
+}
+
+void ProductBook::add_interest_only(double principal, double annual_rate,
+                                    std::int32_t term_months, std::int32_t io_months) {
+  check_loan(principal, annual_rate, term_months);
+  if (io_months < 0 || io_months >= term_months) {
+    throw std::invalid_argument("ProductBook: io_months must be in [0, term_months)");
+  }
+  interest_only_.loans.push_back(principal, annual_rate, term_months);
+  interest_only_.io_months.push_back(io_months);
+}
+
+void ProductBook::add_arm(double principal, double annual_rate, std::int32_t term_months,
+                          const ArmTerms& terms) {
+  check_loan(principal, annual_rate, term_months);
+  terms.validate();
+  arm_.loans.push_back(principal, annual_rate, term_months);
+  arm_.first_reset.push_back(terms.first_reset);
+  arm_.reset_months.push_back(terms.reset_months);
+  arm_.margin.push_back(terms.margin);
+  arm_.periodic_cap.push_back(terms.periodic_cap);
+  arm_.lifetime_cap.push_back(terms.lifetime_cap);
+  arm_.floor.push_back(terms.floor);
+}
+
+std::size_t ProductBook::size(Product product) const noexcept {
+  switch (product) {
+    case Product::fixed: return fixed_.size();
+    case Product::interest_only: return interest_only_.size();
+    case Product::arm: return arm_.size();
+  }
+  return 0;
+}
+
+PoolCashFlows aggregate_book(const ProductBook& book, const CashFlowAssumptions& assumptions,
+                             std::span<const double> index_path, unsigned threads,
+                             RunArenas* arenas) {
+  assumptions.validate();
+  if (book.size(Product::arm) != 0 && index_path.empty()) {
+    throw std::invalid_argument("aggregate_book: ARM loans need an index path");
+  }
+  const StageScope scope(Stage::aggregate, book.size(), arenas);
+
+  std::vector<GroupChunk> chunks;
+  std::size_t periods = 0;
+  for (const Product product : {Product::fixed, Product::interest_only, Product::arm}) {
+    periods = std::max(periods, add_chunks(book, product, index_path, chunks));
+  }
+  std::pmr::vector<ScheduledTotals> partial(shared_resource(arenas));
+  ScheduledTotals total(shared_resource(arenas));
+  total.resize(periods);
+  reduce_chunks(book, chunks, periods, threads, partial, total);
+  return apply_assumptions(total, assumptions);
+}
+
+PoolCashFlows aggregate_book_paths(const ProductBook& book,
+                                   const CashFlowAssumptions& assumptions,
+                                   const RatePaths& rates, double index_spread,
+                                   unsigned threads, RunArenas* arenas) {
+  assumptions.validate();
+  if (rates.paths() == 0 || rates.periods() == 0) {
+    throw std::invalid_argument("aggregate_book_paths: no rate paths");
+  }
+  if (!std::isfinite(index_spread)) {
+    throw std::invalid_argument("aggregate_book_paths: index_spread must be finite");
+  }
+  const StageScope scope(Stage::aggregate, book.size(), arenas);
+  if (threads == 0) threads = default_thread_count();
+
+  // Fixed and interest-only loans never see the index: reduced once.
+  std::vector<GroupChunk> chunks;
+  std::size_t periods = 0;
+  for (const Product product : {Product::fixed, Product::interest_only}) {
+    periods = std::max(periods, add_chunks(book, product, {}, chunks));
+  }
+  std::pmr::vector<ScheduledTotals> partial(shared_resource(arenas));
+  ScheduledTotals total(shared_resource(arenas));
+  total.resize(std::max(periods, max_term(book.arm().loans.columns())));
+  reduce_chunks(book, chunks, total.periods(), threads, partial, total);
+
+  // ARMs run once per path, paths in waves wide enough to fill the
+  // workers. The fold is in (path, chunk) order whatever the wave width.
+  // Constant assumptions act linearly on scheduled totals, so averaging
+  // the totals averages the flows.
+  if (book.size(Product::arm) != 0) {
+    std::vector<GroupChunk> arm_chunks;
+    add_chunks(book, Product::arm, {}, arm_chunks);
+    const std::size_t wave = std::clamp<std::size_t>(4 * threads / arm_chunks.size(), 1,
+                                                     rates.paths());
+    const std::size_t length = rates.periods();
+    std::vector<double> index(wave * length);
+    ScheduledTotals arm(shared_resource(arenas));
+    arm.resize(total.periods());
+    for (std::size_t first = 0; first < rates.paths(); first += wave) {
+      const std::size_t count = std::min(wave, rates.paths() - first);
+      chunks.clear();
+      for (std::size_t k = 0; k < count; ++k) {
+        const std::span<const double> path = rates.path(first + k);
+        double* out = index.data() + k * length;
+        for (std::size_t t = 0; t < length; ++t) out[t] = path[t] + index_spread;
+        for (GroupChunk c : arm_chunks) {
+          c.index_path = std::span<const double>(out, length);
+          chunks.push_back(c);
+        }
+      }
+      reduce_chunks(book, chunks, arm.periods(), threads, partial, arm);
+    }
+    const double scale = 1.0 / static_cast<double>(rates.paths());
+    for (std::pmr::vector<double>* v :
+         {&arm.interest, &arm.principal, &arm.opening_balance, &arm.closing_balance}) {
+      for (double& x : *v) x *= scale;
+    }
+    total.add(arm);
+  }
+  return apply_assumptions(total, assumptions);
+}
+
+}  // namespace loansim
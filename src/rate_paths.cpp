@@ -0,0 +1,166 @@
+#include "loansim/rate_paths.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "loansim/parallel.hpp"
+#include "loansim/rng.hpp"
+
+#include "lane_sum.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::kLanes;
+
+constexpr double kMonth = 1.0 / 12.0;
+// Rate shocks use stream ids with the top bit set; simulate_pool()'s factor
+// streams are indexed by draw and never reach it.
+constexpr std::uint64_t kRateStream = std::uint64_t{1} << 63;
+// Paths per RatePaths task.
+constexpr std::size_t kPathsPerTask = 64;
+
+/// Steps kLanes paths through every period. `z[t * kLanes + j]` is lane
+/// j's shock into period t + 1; `rates[t * kLanes + j]` receives its rate
+/// in period t.
+void step_lanes(const ShortRateModel& m, std::size_t periods, const double* z, double* rates) {
+  std::array<double, kLanes> r;
+  r.fill(m.initial);
+  if (periods == 0) return;
+  for (std::size_t j = 0; j < kLanes; ++j) rates[j] = m.initial;
+  const double theta = m.long_run;
+  if (m.kind == RateModel::hull_white) {
+    // Exact: r' = theta + (r - theta) e^{-a dt} + sigma sqrt((1 - e^{-2a dt}) / 2a) z.
+    const double a = m.mean_reversion;
+    const double decay = std::exp(-a * kMonth);
+    const double sd = a > 0.0 ? m.volatility * std::sqrt(-std::expm1(-2.0 * a * kMonth) / (2.0 * a))
+                              : m.volatility * std::sqrt(kMonth);
+    for (std::size_t t = 1; t < periods; ++t) {
+      const double* zt = z + (t - 1) * kLanes;
+      double* out = rates + t * kLanes;
+      for (std::size_t j = 0; j < kLanes; ++j) {
+        r[j] = theta + (r[j] - theta) * decay + sd * zt[j];
+        out[j] = r[j];
+      }
+    }
+    return;
+  }
+  // Full truncation: drift and diffusion see max(r, 0); the state may dip
+  // below zero but the rate reported never does.
+  const double drift = m.mean_reversion * kMonth;
+  const double sd = m.volatility * std::sqrt(kMonth);
+  for (std::size_t t = 1; t < periods; ++t) {
+    const double* zt = z + (t - 1) * kLanes;
+    double* out = rates + t * kLanes;
+    for (std::size_t j = 0; j < kLanes; ++j) {
+      const double positive = r[j] > 0.0 ? r[j] : 0.0;
+      r[j] = r[j] + drift * (theta - positive) + sd * std::sqrt(positive) * zt[j];
+      out[j] = r[j] > 0.0 ? r[j] : 0.0;
+    }
+  }
+}
+
+}  // namespace
+
+const char* to_string(RateModel model) noexcept {
+  switch (model) {
+    case RateModel::none: return "none";
+    case RateModel::hull_white: return "hull_white";
+    case RateModel::cir: return "cir";
+  }
+  return "unknown";
+}
+
+RateModel parse_rate_model(std::string_view name) {
+  if (name == "none") return RateModel::none;
+  if (name == "hull_white" || name == "hw") return RateModel::hull_white;
+  if (name == "cir") return RateModel::cir;
+  throw std::invalid_argument("unknown rate model '" + std::string(name) + "'");
+}
+
+void ShortRateModel::validate() const {
+  const auto fail = [](const char* what) {
+    throw std::invalid_argument(std::string("ShortRateModel: ") + what);
+  };
+  if (!std::isfinite(initial) || !std::isfinite(long_run)) fail("rates must be finite");
+  if (!(mean_reversion >= 0.0) || !std::isfinite(mean_reversion)) {
+    fail("mean_reversion must be non-negative");
+  }
+  if (!(volatility >= 0.0) || !std::isfinite(volatility)) fail("volatility must be non-negative");
+  if (kind == RateModel::cir && (initial < 0.0 || long_run < 0.0)) {
+    fail("CIR rates must be non-negative");
+  }
+}
+
+std::size_t rate_path_scratch(std::size_t periods) noexcept { return 2 * periods * kLanes; }
+
+void generate_rate_paths(const ShortRateModel& model, std::uint64_t seed, std::size_t first,
+                         std::size_t count, std::size_t periods, bool antithetic,
+                         std::span<double> out, std::span<double> scratch) {
+  if (out.size() < count * periods) {
+    throw std::invalid_argument("generate_rate_paths: output span too small");
+  }
+  if (scratch.size() < rate_path_scratch(periods)) {
+    throw std::invalid_argument("generate_rate_paths: scratch span too small");
+  }
+  if (periods == 0) return;
+  // Shocks and rates of one lane batch, period-major so the step loop runs
+  // across lanes.
+  double* z = scratch.data();
+  double* rates = z + periods * kLanes;
+  std::fill(z, rates, 0.0);
+  for (std::size_t begin = 0; begin < count; begin += kLanes) {
+    const std::size_t lanes = std::min(kLanes, count - begin);
+    for (std::size_t j = 0; j < lanes; ++j) {
+      const std::size_t path = first + begin + j;
+      const std::size_t draw = antithetic ? path / 2 : path;
+      const double sign = antithetic && path % 2 == 1 ? -1.0 : 1.0;
+      const NormalStream stream(seed, kRateStream | draw);
+      for (std::size_t t = 0; t + 1 < periods; t += 2) {
+        const auto [a, b] = stream.pair(t / 2);
+        z[t * kLanes + j] = sign * a;
+        if (t + 2 < periods) z[(t + 1) * kLanes + j] = sign * b;
+      }
+    }
+    step_lanes(model, periods, z, rates);
+    for (std::size_t j = 0; j < lanes; ++j) {
+      double* row = out.data() + (begin + j) * periods;
+      for (std::size_t t = 0; t < periods; ++t) row[t] = rates[t * kLanes + j];
+    }
+  }
+}
+
+RatePaths::RatePaths(const ShortRateModel& model, std::uint64_t seed, std::size_t paths,
+                     std::size_t periods, unsigned threads)
+    : paths_(paths), periods_(periods), rates_(paths * periods) {
+  model.validate();
+  if (!model.enabled()) throw std::invalid_argument("RatePaths: no rate model");
+  const std::size_t tasks = (paths + kPathsPerTask - 1) / kPathsPerTask;
+  const unsigned workers = threads == 0 ? default_thread_count() : threads;
+  const std::size_t need = rate_path_scratch(periods);
+  std::vector<double> scratch(workers * need);
+  parallel_for(tasks, workers, [&](std::size_t task, unsigned worker) {
+    const std::size_t begin = task * kPathsPerTask;
+    const std::size_t count = std::min(kPathsPerTask, paths - begin);
+    generate_rate_paths(model, seed, begin, count, periods, false,
+                        std::span<double>(rates_).subspan(begin * periods, count * periods),
+                        std::span<double>(scratch).subspan(worker * need, need));
+  });
+}
+
+std::vector<double> RatePaths::mean() const {
+  std::vector<double> m(periods_, 0.0);
+  for (std::size_t p = 0; p < paths_; ++p) {
+    const std::span<const double> row = path(p);
+    for (std::size_t t = 0; t < periods_; ++t) m[t] += row[t];
+  }
+  if (paths_ > 0) {
+    for (double& x : m) x /= static_cast<double>(paths_);
+  }
+  return m;
+}
+
+}  // namespace loansim
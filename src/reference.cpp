@@ -0,0 +1,218 @@
+#include "loansim/reference.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "loansim/rate_paths.hpp"
+#include "loansim/rng.hpp"
+#include "loansim/schedule.hpp"
+
+namespace loansim {
+namespace {
+
+using Real = long double;
+// On targets where long double is double (MSVC, AArch64 Apple) the
+// reference would only repeat the engines' rounding.
+static_assert(std::numeric_limits<Real>::digits > std::numeric_limits<double>::digits,
+              "the reference needs a long double wider than double");
+
+/// 1 - (1 - annual)^(1/12).
+Real monthly_rate(double annual) { return 1.0L - std::pow(1.0L - Real{annual}, 1.0L / 12.0L); }
+
+/// One period of one loan.
+struct Period {
+  Real defaults = 0.0L;
+  Real payment = 0.0L;
+  Real interest = 0.0L;
+  Real principal = 0.0L;
+  Real prepayment = 0.0L;
+  Real balance = 0.0L;  // performing, end of period
+};
+
+/// Walks one loan through its term, calling `visit(t, period)` for each
+/// period. `accrual` is empty or holds one factor per period.
+template <class Visit>
+void walk_loan(double principal, double annual_rate, std::int32_t term,
+               std::span<const double> accrual, Real smm, Real mdr, Visit&& visit) {
+  const Real rate = Real{annual_rate} / 12.0L;
+  Real balance = principal;
+  Real payment = reference_level_payment(principal, annual_rate, term);
+  for (std::int32_t t = 0; t < term; ++t) {
+    const auto p = static_cast<std::size_t>(t);
+    Period period;
+    period.defaults = balance * mdr;
+    const Real alive = balance - period.defaults;
+    payment *= 1.0L - mdr;
+    period.interest = alive * rate * (accrual.empty() ? 1.0L : Real{accrual[p]});
+    period.principal = t + 1 == term ? alive : std::min(payment - period.interest, alive);
+    const Real after = alive - period.principal;
+    period.prepayment = after * smm;
+    period.payment = period.interest + period.principal;
+    balance = after - period.prepayment;
+    period.balance = balance;
+    payment *= 1.0L - smm;
+    visit(p, period);
+  }
+}
+
+ReferenceFlows pool_flows(const LoanColumns& loans, const LoanAccrual* accrual,
+                          const CashFlowAssumptions& assumptions) {
+  loans.validate();
+  assumptions.validate();
+  const std::size_t periods = max_term(loans);
+  if (accrual != nullptr) accrual->validate(loans.size(), periods);
+  const Real smm = monthly_rate(assumptions.cpr);
+  const Real mdr = monthly_rate(assumptions.cdr);
+  const Real severity = assumptions.severity;
+
+  ReferenceFlows flows;
+  for (auto* v : {&flows.interest, &flows.scheduled_principal, &flows.prepayment,
+                  &flows.defaults, &flows.loss, &flows.balance}) {
+    v->assign(periods, 0.0L);
+  }
+  for (std::size_t i = 0; i < loans.size(); ++i) {
+    std::span<const double> factors;
+    if (accrual != nullptr) factors = accrual->tables->accrual(accrual->table[i]);
+    walk_loan(loans.principal[i], loans.annual_rate[i], loans.term_months[i], factors, smm, mdr,
+              [&](std::size_t t, const Period& p) {
+                flows.interest[t] += p.interest;
+                flows.scheduled_principal[t] += p.principal;
+                flows.prepayment[t] += p.prepayment;
+                flows.defaults[t] += p.defaults;
+                flows.loss[t] += p.defaults * severity;
+                flows.balance[t] += p.balance;
+              });
+  }
+  return flows;
+}
+
+}  // namespace
+
+long double reference_level_payment(double principal, double annual_rate,
+                                    std::int32_t term) noexcept {
+  const Real p = principal;
+  const Real n = term;
+  if (annual_rate == 0.0) return p / n;
+  const Real r = Real{annual_rate} / 12.0L;
+  return p * r / (1.0L - std::pow(1.0L + r, -n));
+}
+
+ReferenceSchedule reference_schedule(double principal, double annual_rate, std::int32_t term,
+                                     std::span<const double> accrual) {
+  ReferenceSchedule s;
+  const auto periods = static_cast<std::size_t>(std::max(term, 0));
+  for (auto* v : {&s.payment, &s.interest, &s.principal, &s.balance}) v->resize(periods);
+  walk_loan(principal, annual_rate, term, accrual, 0.0L, 0.0L,
+            [&](std::size_t t, const Period& p) {
+              s.payment[t] = p.payment;
+              s.interest[t] = p.interest;
+              s.principal[t] = p.principal;
+              s.balance[t] = p.balance;
+            });
+  return s;
+}
+
+ReferenceFlows reference_cash_flows(const LoanColumns& loans,
+                                    const CashFlowAssumptions& assumptions) {
+  return pool_flows(loans, nullptr, assumptions);
+}
+
+ReferenceFlows reference_cash_flows(const LoanColumns& loans, const LoanAccrual& accrual,
+                                    const CashFlowAssumptions& assumptions) {
+  return pool_flows(loans, &accrual, assumptions);
+}
+
+ReferencePath reference_path(const LoanColumns& loans, const MonteCarloConfig& config,
+                             std::size_t path) {
+  loans.validate();
+  config.validate();
+  if (config.sampler != Sampler::pseudo_random) {
+    throw std::invalid_argument("reference_path: only the pseudo-random sampler is replayed");
+  }
+  if (path >= config.paths) throw std::invalid_argument("reference_path: path out of range");
+  const std::size_t periods = max_term(loans);
+
+  // The path's economy, drawn exactly as simulate_pool() draws it.
+  const NormalStream stream(config.seed, config.antithetic ? path / 2 : path);
+  const Real sign = config.antithetic && path % 2 == 1 ? -1.0L : 1.0L;
+  std::vector<double> rates;
+  if (config.rates.enabled()) {
+    rates.resize(periods);
+    std::vector<double> scratch(rate_path_scratch(periods));
+    generate_rate_paths(config.rates, config.seed, path, 1, periods, config.antithetic, rates,
+                        scratch);
+  }
+
+  // Per-period speed multiplier, default rate and discount factor.
+  const Real phi = config.factor_persistence;
+  const Real shock = std::sqrt(1.0L - phi * phi);
+  const Real mdr0 = monthly_rate(config.base_cdr);
+  const Real cpr_vol = config.cpr_volatility;
+  const Real cdr_vol = config.cdr_volatility;
+  std::vector<Real> speed(periods), mdr(periods), discount(periods);
+  Real speed_x = 0.0L;
+  Real default_x = 0.0L;
+  Real df = 1.0L;
+  for (std::size_t t = 0; t < periods; ++t) {
+    const auto [z_speed, z_default] = stream.pair(t);
+    speed_x = t == 0 ? sign * z_speed : phi * speed_x + shock * sign * z_speed;
+    default_x = t == 0 ? sign * z_default : phi * default_x + shock * sign * z_default;
+    Real rate_factor = 1.0L;
+    Real move = 0.0L;
+    if (!rates.empty()) {
+      move = Real{rates[t]} - Real{config.rates.initial};
+      rate_factor = std::exp(-Real{config.refi_sensitivity} * move);
+    }
+    df /= 1.0L + (Real{config.discount_rate} + move) / 12.0L;
+    speed[t] = std::exp(cpr_vol * speed_x - 0.5L * cpr_vol * cpr_vol) * rate_factor;
+    mdr[t] = std::min(1.0L, mdr0 * std::exp(cdr_vol * default_x - 0.5L * cdr_vol * cdr_vol));
+    discount[t] = df;
+  }
+
+  ReferencePath out;
+  ReferenceFlows& flows = out.flows;
+  for (auto* v : {&flows.interest, &flows.scheduled_principal, &flows.prepayment,
+                  &flows.defaults, &flows.loss, &flows.balance}) {
+    v->assign(periods, 0.0L);
+  }
+  for (std::size_t i = 0; i < loans.size(); ++i) {
+    const std::int32_t term = loans.term_months[i];
+    const Real rate = Real{loans.annual_rate[i]} / 12.0L;
+    const Real level = reference_level_payment(loans.principal[i], loans.annual_rate[i], term);
+    const Real incentive = Real{loans.annual_rate[i]} - Real{config.market_rate};
+    const Real cpr = std::min(Real{config.base_cpr} * std::exp(config.refi_sensitivity * incentive),
+                              0.99L);
+    const Real smm0 = 1.0L - std::pow(1.0L - cpr, 1.0L / 12.0L);
+    // The scheduled (no-prepay) balance and the fraction of it performing.
+    Real balance = loans.principal[i];
+    Real performing = 1.0L;
+    for (std::int32_t t = 0; t < term; ++t) {
+      const auto p = static_cast<std::size_t>(t);
+      const Real interest = balance * rate;
+      const Real principal = t + 1 == term ? balance : std::min(level - interest, balance);
+      const Real after = balance - principal;
+      const Real alive = performing * (1.0L - mdr[p]);
+      const Real smm = std::min(smm0 * speed[p], 1.0L);
+      flows.defaults[p] += balance * performing * mdr[p];
+      flows.interest[p] += interest * alive;
+      flows.scheduled_principal[p] += principal * alive;
+      flows.prepayment[p] += after * alive * smm;
+      performing = alive * (1.0L - smm);
+      flows.balance[p] += after * performing;
+      balance = after;
+    }
+  }
+  const Real severity = config.severity;
+  for (std::size_t t = 0; t < periods; ++t) {
+    flows.loss[t] = flows.defaults[t] * severity;
+    out.present_value += discount[t] * (flows.interest[t] + flows.scheduled_principal[t] +
+                                        flows.prepayment[t] + flows.defaults[t] - flows.loss[t]);
+    out.total_loss += flows.loss[t];
+  }
+  return out;
+}
+
+}  // namespace loansim
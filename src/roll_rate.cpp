@@ -0,0 +1,315 @@
+#include "loansim/roll_rate.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/instrument.hpp"
+#include "loansim/mapped_file.hpp"
+#include "loansim/parallel.hpp"
+#include "loansim/schedule.hpp"
+
+#include "lane_sum.hpp"
+#include "text_fields.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::kLanes;
+using detail::lane_sum;
+using detail::parse_error;
+using detail::split_fields;
+using detail::trim;
+
+constexpr const char* kStateNames[kDelinquencyStates] = {"current", "dpd30",   "dpd60",
+                                                         "dpd90",   "default", "prepaid"};
+
+/// A run of loans (indices into the group-sorted order) reduced as one task.
+struct Task {
+  std::size_t group;
+  std::size_t begin;
+  std::size_t end;
+};
+
+}  // namespace
+
+const char* to_string(DelinquencyState state) noexcept {
+  const auto i = static_cast<std::size_t>(state);
+  return i < kDelinquencyStates ? kStateNames[i] : "unknown";
+}
+
+DelinquencyState parse_delinquency_state(std::string_view name) {
+  for (std::size_t i = 0; i < kDelinquencyStates; ++i) {
+    if (name == kStateNames[i]) return static_cast<DelinquencyState>(i);
+  }
+  if (name == "0") return DelinquencyState::current;
+  if (name == "30") return DelinquencyState::dpd30;
+  if (name == "60") return DelinquencyState::dpd60;
+  if (name == "90") return DelinquencyState::dpd90;
+  throw std::invalid_argument("unknown delinquency state '" + std::string(name) + "'");
+}
+
+void TransitionMatrix::validate() const {
+  for (std::size_t from = 0; from < kLiveStates; ++from) {
+    double sum = 0.0;
+    for (const double p : rows[from]) {
+      if (!(p >= 0.0 && p <= 1.0)) {
+        throw std::invalid_argument("TransitionMatrix: probability outside [0, 1]");
+      }
+      sum += p;
+    }
+    if (std::abs(sum - 1.0) > 1e-9) {
+      throw std::invalid_argument(std::string("TransitionMatrix: row ") + kStateNames[from] +
+                                  " does not sum to one");
+    }
+  }
+}
+
+void RollRateConfig::validate() const {
+  if (matrices.empty()) throw std::invalid_argument("RollRateConfig: no matrices");
+  for (const TransitionMatrix& m : matrices) m.validate();
+  if (!(severity >= 0.0 && severity <= 1.0)) {
+    throw std::invalid_argument("RollRateConfig: severity");
+  }
+}
+
+RollRateResult run_roll_rates(const LoanColumns& loans, std::span<const std::uint32_t> cohorts,
+                              std::span<const DelinquencyState> initial,
+                              const RollRateConfig& config, RunArenas* arenas) {
+  loans.validate();
+  config.validate();
+  const std::size_t n = loans.size();
+  if ((!cohorts.empty() && cohorts.size() != n) || (!initial.empty() && initial.size() != n)) {
+    throw std::invalid_argument("run_roll_rates: cohorts or initial states differ from loans");
+  }
+  const StageScope scope(Stage::aggregate, n, arenas);
+  const unsigned threads = config.threads == 0 ? default_thread_count() : config.threads;
+  std::pmr::memory_resource* shared = shared_resource(arenas);
+
+  // Counting sort of loans by group key, cohort * kLiveStates + state, so
+  // each group is a run of `order` in tape order.
+  const std::size_t keys = config.matrices.size() * kLiveStates;
+  const auto key_of = [&](std::size_t i) {
+    const std::size_t cohort = cohorts.empty() ? 0 : cohorts[i];
+    const auto state = static_cast<std::size_t>(initial.empty() ? DelinquencyState::current
+                                                                : initial[i]);
+    if (cohort >= config.matrices.size()) {
+      throw std::invalid_argument("run_roll_rates: cohort without a matrix");
+    }
+    if (state >= kLiveStates) {
+      throw std::invalid_argument("run_roll_rates: initial state is not live");
+    }
+    return cohort * kLiveStates + state;
+  };
+  std::vector<std::size_t> start(keys + 1, 0);
+  for (std::size_t i = 0; i < n; ++i) ++start[key_of(i) + 1];
+  for (std::size_t k = 0; k < keys; ++k) start[k + 1] += start[k];
+  std::vector<std::size_t> order(n);
+  {
+    std::vector<std::size_t> next(start.begin(), start.end() - 1);
+    for (std::size_t i = 0; i < n; ++i) order[next[key_of(i)]++] = i;
+  }
+
+  std::vector<std::size_t> group_key;
+  std::vector<Task> tasks;
+  for (std::size_t k = 0; k < keys; ++k) {
+    if (start[k] == start[k + 1]) continue;
+    for (std::size_t b = start[k]; b < start[k + 1]; b += kAggregateChunkLoans) {
+      tasks.push_back({group_key.size(), b, std::min(b + kAggregateChunkLoans, start[k + 1])});
+    }
+    group_key.push_back(k);
+  }
+  const std::size_t groups = group_key.size();
+  const std::size_t padded = detail::pad_to_lanes(groups);
+  const std::size_t periods = max_term(loans);
+
+  // Scheduled totals of each group, reduced per task and folded in task
+  // order, so results do not depend on the thread count.
+  std::pmr::vector<ScheduledTotals> partial(shared);
+  partial.reserve(tasks.size());
+  for (std::size_t t = 0; t < tasks.size(); ++t) partial.emplace_back(shared).resize(periods);
+  std::vector<LoanPool> buffers(threads);
+  parallel_for(tasks.size(), threads, [&](std::size_t task, unsigned worker) {
+    const Task& work = tasks[task];
+    LoanPool& pool = buffers[worker];
+    const std::size_t count = work.end - work.begin;
+    pool.principal.resize(count);
+    pool.annual_rate.resize(count);
+    pool.term_months.resize(count);
+    for (std::size_t j = 0; j < count; ++j) {
+      const std::size_t i = order[work.begin + j];
+      pool.principal[j] = loans.principal[i];
+      pool.annual_rate[j] = loans.annual_rate[i];
+      pool.term_months[j] = loans.term_months[i];
+    }
+    accumulate_scheduled(pool.columns(), partial[task]);
+  });
+
+  // Period-major group arrays ([t * padded + g]); padding groups stay zero.
+  std::pmr::vector<double> opening(periods * padded, 0.0, shared);
+  std::pmr::vector<double> interest(periods * padded, 0.0, shared);
+  std::pmr::vector<double> principal(periods * padded, 0.0, shared);
+  std::pmr::vector<double> closing(periods * padded, 0.0, shared);
+  for (std::size_t task = 0; task < tasks.size(); ++task) {
+    const std::size_t g = tasks[task].group;
+    const ScheduledTotals& p = partial[task];
+    for (std::size_t t = 0; t < periods; ++t) {
+      opening[t * padded + g] += p.opening_balance[t];
+      interest[t * padded + g] += p.interest[t];
+      principal[t * padded + g] += p.principal[t];
+      closing[t * padded + g] += p.closing_balance[t];
+    }
+  }
+
+  // Matrices as [(from * kDelinquencyStates + to) * padded + g] and state
+  // vectors as [state * padded + g], so the step is unit-stride in groups.
+  std::pmr::vector<double> matrix(kLiveStates * kDelinquencyStates * padded, 0.0, shared);
+  std::pmr::vector<double> state(kLiveStates * padded, 0.0, shared);
+  for (std::size_t g = 0; g < groups; ++g) {
+    const TransitionMatrix& m = config.matrices[group_key[g] / kLiveStates];
+    for (std::size_t from = 0; from < kLiveStates; ++from) {
+      for (std::size_t to = 0; to < kDelinquencyStates; ++to) {
+        matrix[(from * kDelinquencyStates + to) * padded + g] = m.rows[from][to];
+      }
+    }
+    state[(group_key[g] % kLiveStates) * padded + g] = 1.0;
+  }
+
+  RollRateResult result;
+  result.flows.resize(periods);
+  for (std::vector<double>& v : result.state_balance) v.assign(periods, 0.0);
+  // Per-group flows of the current period, lane-summed into the pool.
+  std::pmr::vector<double> out(9 * padded, 0.0, shared);
+  double* const out_interest = out.data();
+  double* const out_sched = out_interest + padded;
+  double* const out_prepay = out_sched + padded;
+  double* const out_default = out_prepay + padded;
+  double* const out_balance = out_default + padded;
+  double* const out_state = out_balance + padded;  // kLiveStates x padded
+  const double* m = matrix.data();
+  double* p = state.data();
+  for (std::size_t t = 0; t < periods; ++t) {
+    const double* s = &opening[t * padded];
+    const double* in = &interest[t * padded];
+    const double* sp = &principal[t * padded];
+    const double* c = &closing[t * padded];
+    // Groups are stepped kLanes at a time: q = p M for the batch into a
+    // local array first, then the flows and the new state from it, so
+    // every loop is unit-stride over groups and free of aliasing.
+    for (std::size_t g0 = 0; g0 < padded; g0 += kLanes) {
+      double q[kDelinquencyStates][kLanes];
+      for (std::size_t to = 0; to < kDelinquencyStates; ++to) {
+        for (std::size_t j = 0; j < kLanes; ++j) {
+          const std::size_t g = g0 + j;
+          double sum = 0.0;
+          for (std::size_t from = 0; from < kLiveStates; ++from) {
+            sum += p[from * padded + g] * m[(from * kDelinquencyStates + to) * padded + g];
+          }
+          q[to][j] = sum;
+        }
+      }
+      for (std::size_t j = 0; j < kLanes; ++j) {
+        const std::size_t g = g0 + j;
+        const double live = q[0][j] + q[1][j] + q[2][j] + q[3][j];
+        const double defaulted = q[static_cast<std::size_t>(DelinquencyState::defaulted)][j];
+        const double prepaid = q[static_cast<std::size_t>(DelinquencyState::prepaid)][j];
+        // Loans that prepay this month still make the scheduled payment first.
+        out_interest[g] = (live + prepaid) * in[g];
+        out_sched[g] = (live + prepaid) * sp[g];
+        out_prepay[g] = prepaid * c[g];
+        out_default[g] = defaulted * s[g];
+        out_balance[g] = live * c[g];
+      }
+      for (std::size_t k = 0; k < kLiveStates; ++k) {
+        for (std::size_t j = 0; j < kLanes; ++j) {
+          out_state[k * padded + g0 + j] = q[k][j] * c[g0 + j];
+          p[k * padded + g0 + j] = q[k][j];
+        }
+      }
+    }
+    PoolCashFlows& f = result.flows;
+    f.interest[t] = lane_sum(out_interest, padded);
+    f.scheduled_principal[t] = lane_sum(out_sched, padded);
+    f.prepayment[t] = lane_sum(out_prepay, padded);
+    f.defaults[t] = lane_sum(out_default, padded);
+    f.loss[t] = f.defaults[t] * config.severity;
+    f.balance[t] = lane_sum(out_balance, padded);
+    for (std::size_t k = 0; k < kLiveStates; ++k) {
+      result.state_balance[k][t] = lane_sum(out_state + k * padded, padded);
+    }
+  }
+  return result;
+}
+
+std::vector<TransitionMatrix> read_transition_matrices(const std::string& path) {
+  const MappedFile file = MappedFile::open(path);
+  std::string_view text(reinterpret_cast<const char*>(file.bytes().data()), file.size());
+  std::vector<std::string_view> fields;
+  std::vector<TransitionMatrix> matrices;
+  std::vector<std::array<bool, kLiveStates>> seen;
+  // Every cohort needs all its live rows, which bounds how many the file
+  // can hold and so how large a cohort number can be.
+  const std::size_t max_cohorts =
+      (static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n')) + 1) / kLiveStates;
+  for (std::size_t line_no = 1; !text.empty(); ++line_no) {
+    const std::size_t nl = text.find('\n');
+    const std::string_view line = text.substr(0, nl);
+    text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+    if (trim(line).empty()) continue;
+    split_fields(line, ',', fields);
+    for (std::string_view& f : fields) f = trim(f);
+    if (line_no == 1) {
+      static constexpr std::string_view kHeader[] = {"cohort", "from",  "current", "dpd30",
+                                                     "dpd60",  "dpd90", "default", "prepaid"};
+      if (!std::equal(fields.begin(), fields.end(), std::begin(kHeader), std::end(kHeader))) {
+        parse_error(path, line_no, "expected header cohort,from,current,dpd30,dpd60,dpd90,"
+                                   "default,prepaid");
+      }
+      continue;
+    }
+    if (fields.size() != 2 + kDelinquencyStates) parse_error(path, line_no, "expected 8 fields");
+    std::uint32_t cohort = 0;
+    const auto [end, ec] =
+        std::from_chars(fields[0].data(), fields[0].data() + fields[0].size(), cohort);
+    if (ec != std::errc{} || end != fields[0].data() + fields[0].size()) {
+      parse_error(path, line_no, "malformed cohort");
+    }
+    DelinquencyState from{};
+    try {
+      from = parse_delinquency_state(fields[1]);
+    } catch (const std::invalid_argument&) {
+      parse_error(path, line_no, "unknown from state");
+    }
+    const auto row = static_cast<std::size_t>(from);
+    if (row >= kLiveStates) parse_error(path, line_no, "from state must be live");
+    if (cohort >= max_cohorts) parse_error(path, line_no, "cohort out of range for the file");
+    if (cohort >= matrices.size()) {
+      matrices.resize(cohort + 1);
+      seen.resize(cohort + 1);
+    }
+    if (seen[cohort][row]) parse_error(path, line_no, "duplicate row");
+    seen[cohort][row] = true;
+    for (std::size_t to = 0; to < kDelinquencyStates; ++to) {
+      const std::string_view f = fields[2 + to];
+      double& x = matrices[cohort].rows[row][to];
+      const auto [stop, error] = std::from_chars(f.data(), f.data() + f.size(), x);
+      if (error != std::errc{} || stop != f.data() + f.size()) {
+        parse_error(path, line_no, "malformed probability");
+      }
+    }
+  }
+  for (std::size_t c = 0; c < seen.size(); ++c) {
+    if (std::find(seen[c].begin(), seen[c].end(), false) != seen[c].end()) {
+      throw std::runtime_error(path + ": cohort " + std::to_string(c) + " is missing rows");
+    }
+  }
+  if (matrices.empty()) throw std::runtime_error(path + ": no matrices");
+  for (const TransitionMatrix& m : matrices) m.validate();
+  return matrices;
+}
+
+}  // namespace loansim
@@ -0,0 +1,331 @@
+#include "loansim/scenario_grid.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#include "loansim/instrument.hpp"
+#include "loansim/parallel.hpp"
+#include "loansim/payment_kernel.hpp"
+#include "loansim/schedule.hpp"
+
+#include "lane_sum.hpp"
+#include "price_moments.hpp"
+
+namespace loansim {
+namespace {
+
+using detail::kMomentGroup;
+using detail::kPriceMoments;
+using detail::lane_sum;
+
+constexpr std::size_t kBlock = 256;
+constexpr std::size_t kChunkLoans = 16'384;
+// Chunk partials are folded a wave at a time, in chunk order, which bounds
+// their memory and keeps results independent of the thread count.
+constexpr std::size_t kChunksPerWave = 32;
+
+/// Per-scenario constants for one run.
+struct ScenarioTerms {
+  double cpr_scale;  // multiplies exp(refi_sensitivity * note_rate)
+  double mdr;        // monthly default rate
+  double recovery;   // 1 - severity
+};
+
+double monthly_rate(double annual) { return -std::expm1(std::log1p(-annual) / 12.0); }
+
+/// One worker's block-sized working buffers, allocated from its arena once
+/// per run and reused for every block the worker processes. The analytics
+/// buffers stay empty unless loan analytics were requested.
+struct BlockScratch {
+  BlockScratch(std::size_t batch, bool analytics, std::pmr::memory_resource* r)
+      : rate(kBlock, r), level(kBlock, r), term(kBlock, r), bal(kBlock, r),
+        opening(kBlock, r), interest(kBlock, r), principal(kBlock, r), incentive(kBlock, r),
+        out_a(kBlock, r), out_b(kBlock, r), out_c(kBlock, r), out_d(kBlock, r),
+        out_e(kBlock, r), survival(batch * kBlock, r), smm(batch * kBlock, r),
+        base(analytics ? batch * kBlock : 0, r), base_df(analytics ? batch * kBlock : 0, r),
+        df(analytics ? batch * kBlock : 0, r), life(analytics ? batch * kBlock : 0, r),
+        face(analytics ? kBlock : 0, r), delta(analytics ? kBlock : 0, r),
+        pv(analytics ? batch * kMomentGroup * kBlock : 0, r),
+        moments(analytics ? batch * kPriceMoments * kBlock : 0, r) {}
+
+  std::pmr::vector<double> rate, level, term;
+  std::pmr::vector<double> bal, opening, interest, principal, incentive;
+  std::pmr::vector<double> out_a, out_b, out_c, out_d, out_e;
+  std::pmr::vector<double> survival;  // batch x kBlock
+  std::pmr::vector<double> smm;       // batch x kBlock
+  // Loan analytics. Base rates, discount factors and balance-life sums are
+  // batch x kBlock; buffered flows batch x kMomentGroup x kBlock; moments
+  // batch x kPriceMoments x kBlock.
+  std::pmr::vector<double> base, base_df, df, life;
+  std::pmr::vector<double> face, delta;
+  std::pmr::vector<double> pv;
+  std::pmr::vector<double> moments;
+};
+
+}  // namespace
+
+void Scenario::validate() const {
+  if (!(speed_multiplier >= 0.0)) throw std::invalid_argument("Scenario: speed_multiplier");
+  if (!(cdr >= 0.0 && cdr < 1.0)) throw std::invalid_argument("Scenario: cdr");
+  if (!(severity >= 0.0 && severity <= 1.0)) throw std::invalid_argument("Scenario: severity");
+  if (!std::isfinite(rate_shock)) throw std::invalid_argument("Scenario: rate_shock");
+}
+
+PreparedPool::PreparedPool(const LoanColumns& loans) {
+  loans.validate();
+  const std::size_t n = loans.size();
+  periods_ = max_term(loans);
+  principal_.assign(loans.principal.begin(), loans.principal.end());
+  note_rate_.assign(loans.annual_rate.begin(), loans.annual_rate.end());
+  level_payment_.resize(n);
+  level_payments(loans, level_payment_);
+  monthly_rate_.resize(n);
+  term_.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    monthly_rate_[i] = note_rate_[i] / 12.0;
+    term_[i] = loans.term_months[i];
+  }
+}
+
+std::vector<ScenarioResult> PreparedPool::run(std::span<const Scenario> scenarios,
+                                              const ScenarioGridConfig& config,
+                                              RunArenas* arenas) const {
+  if (config.scenario_batch == 0) throw std::invalid_argument("ScenarioGridConfig: batch is 0");
+  if (!(config.price > 0.0)) throw std::invalid_argument("ScenarioGridConfig: price must be > 0");
+  for (const Scenario& s : scenarios) s.validate();
+  const std::size_t count = scenarios.size();
+  // Loans are counted once per scenario: the grid's work is loans x scenarios.
+  const StageScope scope(Stage::aggregate, size() * count, arenas);
+  const double beta = config.refi_sensitivity;
+
+  std::vector<ScenarioTerms> terms(count);
+  for (std::size_t s = 0; s < count; ++s) {
+    const double market = config.market_rate + scenarios[s].rate_shock;
+    terms[s] = {config.base_cpr * scenarios[s].speed_multiplier * std::exp(-beta * market),
+                monthly_rate(scenarios[s].cdr), 1.0 - scenarios[s].severity};
+  }
+
+  std::vector<ScenarioResult> results(count);
+  for (std::size_t s = 0; s < count; ++s) {
+    results[s].scenario = scenarios[s];
+    results[s].flows.resize(periods_);
+    if (config.loan_analytics) results[s].loan_analytics.resize(size());
+  }
+  if (count == 0 || size() == 0) return results;
+
+  const std::size_t batch = std::min(config.scenario_batch, count);
+  const bool analytics = config.loan_analytics;
+  const std::size_t chunks = (size() + kChunkLoans - 1) / kChunkLoans;
+
+  // Steps one block through all periods for scenarios [s0, s0 + m), adding
+  // per-period totals into `partial[s0 .. s0 + m)`.
+  const auto run_block = [&](std::size_t begin, std::size_t end, std::size_t s0, std::size_t m,
+                             BlockScratch& w, std::pmr::vector<PoolCashFlows>& partial) {
+    const std::size_t n = end - begin;
+    const std::size_t padded = detail::pad_to_lanes(n);
+    double* rate = w.rate.data();
+    double* level = w.level.data();
+    double* term = w.term.data();
+    // Lanes past `n` are zeroed: no balance, term 0, contributing nothing.
+    for (std::pmr::vector<double>* v : {&w.rate, &w.level, &w.term, &w.bal}) {
+      std::fill(v->begin(), v->end(), 0.0);
+    }
+    std::copy_n(monthly_rate_.data() + begin, n, rate);
+    std::copy_n(level_payment_.data() + begin, n, level);
+    std::copy_n(term_.data() + begin, n, term);
+    std::copy_n(principal_.data() + begin, n, w.bal.begin());
+    std::int32_t longest = 0;
+    for (std::size_t k = 0; k < n; ++k) {
+      longest = std::max(longest, static_cast<std::int32_t>(term[k]));
+      w.incentive[k] = std::exp(beta * note_rate_[begin + k]);
+    }
+    for (std::size_t j = 0; j < m; ++j) {
+      double* q = w.survival.data() + j * kBlock;
+      double* smm = w.smm.data() + j * kBlock;
+      std::fill_n(q, kBlock, 1.0);
+      std::fill_n(smm, kBlock, 0.0);
+      for (std::size_t k = 0; k < n; ++k) {
+        smm[k] = monthly_rate(std::min(terms[s0 + j].cpr_scale * w.incentive[k], 0.99));
+      }
+    }
+    if (analytics) {
+      // Moments are taken about the note rate less the scenario's expected
+      // monthly loss, which is close to the yield near par and keeps the
+      // series short.
+      for (std::size_t j = 0; j < m; ++j) {
+        const double loss = terms[s0 + j].mdr * (1.0 - terms[s0 + j].recovery);
+        double* base = w.base.data() + j * kBlock;
+        double* base_df = w.base_df.data() + j * kBlock;
+        for (std::size_t k = 0; k < kBlock; ++k) {
+          const double expected = rate[k] - loss;
+          base[k] = 12.0 * std::log1p(expected);
+          base_df[k] = 1.0 / (1.0 + expected);
+        }
+      }
+      std::copy(w.bal.begin(), w.bal.end(), w.face.begin());
+      std::fill_n(w.df.begin(), m * kBlock, 1.0);
+      std::fill_n(w.life.begin(), m * kBlock, 0.0);
+      std::fill_n(w.moments.begin(), m * kPriceMoments * kBlock, 0.0);
+    }
+    std::array<double, kMomentGroup * kPriceMoments> tpow{};
+
+    for (std::int32_t t = 0; t < longest; ++t) {
+      // The scheduled amortization is the same in every scenario: step it
+      // once, then let each scenario scale it by its own survival.
+      const double last = t + 1;
+      for (std::size_t k = 0; k < padded; ++k) {
+        const double b = w.bal[k];
+        const double in = b * rate[k];
+        const double due = std::min(level[k] - in, b);
+        const double sp = term[k] == last ? b : due;
+        w.opening[k] = b;
+        w.bal[k] = b - sp;
+        w.interest[k] = in;
+        w.principal[k] = sp;
+      }
+      const auto p = static_cast<std::size_t>(t);
+      const std::size_t g = p % kMomentGroup;
+      const bool flush = g + 1 == kMomentGroup || t + 1 == longest;
+      if (analytics) detail::time_powers(t, tpow.data() + g * kPriceMoments);
+      for (std::size_t j = 0; j < m; ++j) {
+        double* q = w.survival.data() + j * kBlock;
+        const double* smm = w.smm.data() + j * kBlock;
+        const double mdr = terms[s0 + j].mdr;
+        for (std::size_t k = 0; k < padded; ++k) {
+          const double alive = q[k] * (1.0 - mdr);
+          const double prepay = w.bal[k] * alive * smm[k];
+          w.out_a[k] = w.interest[k] * alive;
+          w.out_b[k] = w.principal[k] * alive;
+          w.out_c[k] = prepay;
+          w.out_d[k] = w.opening[k] * q[k];
+          q[k] = alive * (1.0 - smm[k]);
+          w.out_e[k] = w.bal[k] * q[k];
+        }
+        PoolCashFlows& f = partial[s0 + j];
+        f.interest[p] += lane_sum(w.out_a.data(), padded);
+        f.scheduled_principal[p] += lane_sum(w.out_b.data(), padded);
+        f.prepayment[p] += lane_sum(w.out_c.data(), padded);
+        f.defaults[p] += lane_sum(w.out_d.data(), padded) * mdr;
+        f.balance[p] += lane_sum(w.out_e.data(), padded);
+
+        if (!analytics) continue;
+        // The scenario's per-loan flows are still in L1: fold them into the
+        // loan's price moments and principal timing here rather than
+        // storing them for a second pass. WAL needs only the sum of
+        // surviving opening balances (`out_d`): summed by parts, Σ t · paid
+        // equals Σ opening balance.
+        const double recovery = mdr * terms[s0 + j].recovery;
+        double* df = w.df.data() + j * kBlock;
+        double* life = w.life.data() + j * kBlock;
+        const double* base_df = w.base_df.data() + j * kBlock;
+        double* pv = w.pv.data() + j * kMomentGroup * kBlock;
+        double* row = pv + g * kBlock;
+        for (std::size_t k = 0; k < padded; ++k) {
+          const double cash = w.out_a[k] + w.out_b[k] + w.out_c[k] + w.out_d[k] * recovery;
+          df[k] *= base_df[k];
+          row[k] = cash * df[k];
+          life[k] += w.out_d[k];
+        }
+        if (flush) {
+          std::fill(row + kBlock, pv + kMomentGroup * kBlock, 0.0);
+          detail::add_moments(tpow.data(), pv, w.moments.data() + j * kPriceMoments * kBlock,
+                              kBlock, padded);
+        }
+      }
+    }
+
+    if (!analytics) return;
+    for (std::size_t j = 0; j < m; ++j) {
+      detail::solve_yields(w.moments.data() + j * kPriceMoments * kBlock, kBlock,
+                           w.base.data() + j * kBlock, w.face.data(), config.price,
+                           w.life.data() + j * kBlock, w.delta.data(), n, padded,
+                           results[s0 + j].loan_analytics, begin);
+    }
+  };
+
+  const unsigned threads = config.threads == 0 ? default_thread_count() : config.threads;
+  if (arenas != nullptr) arenas->ensure_workers(threads);
+  std::pmr::memory_resource* shared = shared_resource(arenas);
+  std::pmr::vector<BlockScratch> scratch(shared);
+  scratch.reserve(threads);
+  for (unsigned w = 0; w < threads; ++w) scratch.emplace_back(batch, analytics, worker_resource(arenas, w));
+
+  const std::size_t wave_size = std::min(chunks, kChunksPerWave);
+  std::pmr::vector<std::pmr::vector<PoolCashFlows>> wave(shared);
+  wave.reserve(wave_size);
+  for (std::size_t c = 0; c < wave_size; ++c) {
+    std::pmr::vector<PoolCashFlows>& chunk = wave.emplace_back();  // inherits `shared`
+    chunk.reserve(count);
+    for (std::size_t s = 0; s < count; ++s) chunk.emplace_back(periods_, shared);
+  }
+
+  for (std::size_t first = 0; first < chunks; first += kChunksPerWave) {
+    const std::size_t in_wave = std::min(kChunksPerWave, chunks - first);
+    parallel_for(in_wave, threads, [&](std::size_t task, unsigned worker) {
+      std::pmr::vector<PoolCashFlows>& partial = wave[task];
+      for (PoolCashFlows& f : partial) f.clear();
+      const std::size_t chunk_begin = (first + task) * kChunkLoans;
+      const std::size_t chunk_end = std::min(chunk_begin + kChunkLoans, size());
+      for (std::size_t begin = chunk_begin; begin < chunk_end; begin += kBlock) {
+        const std::size_t end = std::min(begin + kBlock, chunk_end);
+        for (std::size_t s0 = 0; s0 < count; s0 += batch) {
+          run_block(begin, end, s0, std::min(batch, count - s0), scratch[worker], partial);
+        }
+      }
+    });
+    for (std::size_t c = 0; c < in_wave; ++c) {
+      for (std::size_t s = 0; s < count; ++s) results[s].flows.add(wave[c][s]);
+    }
+  }
+
+  double total_principal = 0.0;
+  for (const double p : principal_) total_principal += p;
+  std::vector<double> cash(periods_);
+  std::vector<double> paid(periods_);
+  for (std::size_t s = 0; s < count; ++s) {
+    PoolCashFlows& f = results[s].flows;
+    for (std::size_t t = 0; t < periods_; ++t) f.loss[t] = f.defaults[t] * scenarios[s].severity;
+    const double monthly = 1.0 + (config.market_rate + scenarios[s].rate_shock) / 12.0;
+    double df = 1.0;
+    double pv = 0.0;
+    for (std::size_t t = 0; t < periods_; ++t) {
+      df /= monthly;
+      pv += df * f.total_cash(t);
+    }
+    results[s].present_value = pv;
+
+    for (std::size_t t = 0; t < periods_; ++t) {
+      cash[t] = f.total_cash(t);
+      paid[t] = f.scheduled_principal[t] + f.prepayment[t] + f.defaults[t];
+    }
+    // A pool with no principal has nothing to price; its analytics stay
+    // zero, as a loan's do.
+    const bool priced = total_principal > 0.0 &&
+                        std::any_of(cash.begin(), cash.end(), [](double c) { return c > 0.0; });
+    if (priced) {
+      results[s].analytics = analyze_cash_flows(cash, paid, config.price * total_principal,
+                                                config.market_rate + scenarios[s].rate_shock);
+    }
+  }
+  return results;
+}
+
+std::vector<Scenario> make_scenario_grid(std::span<const double> rate_shocks,
+                                         std::span<const double> speed_multipliers, double cdr,
+                                         double severity) {
+  std::vector<Scenario> grid;
+  grid.reserve(rate_shocks.size() * speed_multipliers.size());
+  for (const double shock : rate_shocks) {
+    for (const double speed : speed_multipliers) {
+      char name[64];
+      std::snprintf(name, sizeof name, "shock=%+.0fbp speed=%.2f", shock * 1e4, speed);
+      grid.push_back(Scenario{name, shock, speed, cdr, severity});
+    }
+  }
+  return grid;
+}
+
+}  // namespace loansim
@@ -0,0 +1,106 @@
+#include "loansim/schedule.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "loansim/instrument.hpp"
+#include "loansim/payment_kernel.hpp"
+
+namespace loansim {
+namespace {
+
+/// build_schedules() with interest accrued by `accrual` when given.
+void fill_schedules(const LoanColumns& loans, const LoanAccrual* accrual, ScheduleBuffers& out,
+                    RunArenas* arenas) {
+  loans.validate();
+  const std::size_t n = loans.size();
+  StageScope scope(Stage::schedule, n, arenas);
+  const std::size_t periods = max_term(loans);
+  if (accrual != nullptr) accrual->validate(n, periods);
+  out.resize(n, periods);
+  // Buffers carved from `arenas` are already counted by the scope's arena
+  // growth; only buffers from elsewhere are added here.
+  if (arenas == nullptr || !arenas->owns(out.resource())) {
+    scope.add_bytes(4 * n * periods * sizeof(double));
+  }
+  if (n == 0) return;
+
+  // Per-loan state, walked with unit stride once per period.
+  std::pmr::memory_resource* scratch = shared_resource(arenas);
+  std::pmr::vector<double> monthly(n, scratch);
+  std::pmr::vector<double> rate(n, scratch);
+  std::pmr::vector<double> level(n, scratch);
+  std::pmr::vector<double> bal(loans.principal.begin(), loans.principal.end(), scratch);
+  std::pmr::vector<std::size_t> offset(accrual != nullptr ? n : 0, scratch);
+  level_payments(loans, level);
+  for (std::size_t i = 0; i < n; ++i) monthly[i] = loans.annual_rate[i] / 12.0;
+  const double* factors = nullptr;
+  if (accrual != nullptr) {
+    factors = accrual->tables->accrual_data().data();
+    const std::size_t stride = accrual->tables->periods();
+    for (std::size_t i = 0; i < n; ++i) offset[i] = accrual->table[i] * stride;
+  } else {
+    rate = monthly;
+  }
+
+  const double* r = rate.data();
+  const double* lvl = level.data();
+  const std::int32_t* term = loans.term_months.data();
+  double* b = bal.data();
+  for (std::size_t t = 0; t < periods; ++t) {
+    if (accrual != nullptr) {
+      // One lookup per loan into the shared tables; no dates are touched.
+      for (std::size_t i = 0; i < n; ++i) {
+        rate[i] = monthly[i] * factors[offset[i] + t];
+      }
+    }
+    double* pay = out.payment(t).data();
+    double* intr = out.interest(t).data();
+    double* prin = out.principal(t).data();
+    double* end_bal = out.balance(t).data();
+    const auto period = static_cast<std::int32_t>(t);
+    for (std::size_t i = 0; i < n; ++i) {
+      // Selects rather than branches: matured loans carry a zero balance and
+      // the last period retires whatever rounding left outstanding.
+      const double active = period < term[i] ? 1.0 : 0.0;
+      const bool last = period + 1 == term[i];
+      const double in = b[i] * r[i];
+      const double sched = std::min(lvl[i] - in, b[i]);
+      const double pr = (last ? b[i] : sched) * active;
+      intr[i] = in * active;
+      prin[i] = pr;
+      pay[i] = in * active + pr;
+      b[i] -= pr;
+      end_bal[i] = b[i];
+    }
+  }
+}
+
+}  // namespace
+
+void ScheduleBuffers::resize(std::size_t loans, std::size_t periods) {
+  loans_ = loans;
+  periods_ = periods;
+  const std::size_t n = loans * periods;
+  payment_.resize(n);
+  interest_.resize(n);
+  principal_.resize(n);
+  balance_.resize(n);
+}
+
+std::size_t max_term(const LoanColumns& loans) noexcept {
+  std::int32_t longest = 0;
+  for (const std::int32_t t : loans.term_months) longest = std::max(longest, t);
+  return static_cast<std::size_t>(longest);
+}
+
+void build_schedules(const LoanColumns& loans, ScheduleBuffers& out, RunArenas* arenas) {
+  fill_schedules(loans, nullptr, out, arenas);
+}
+
+void build_schedules(const LoanColumns& loans, const LoanAccrual& accrual, ScheduleBuffers& out,
+                     RunArenas* arenas) {
+  fill_schedules(loans, &accrual, out, arenas);
+}
+
+}  // namespace loansim
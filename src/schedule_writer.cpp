@@ -0,0 +1,383 @@
+#include "loansim/schedule_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(LOANSIM_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#include "loansim/arena.hpp"
+#include "loansim/instrument.hpp"
+#include "loansim/schedule.hpp"
+
+namespace loansim {
+namespace {
+
+constexpr char kMagic[8] = {'L', 'S', 'I', 'M', 'S', 'C', 'H', 'D'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kEndianMark = 0x01020304u;
+constexpr std::size_t kColumns = 4;  // payment, interest, principal, balance
+
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t endian;
+  std::uint64_t loans;
+  std::uint64_t chunks;
+  std::uint32_t compression;
+  std::uint32_t columns;
+  std::uint64_t chunk_loans;
+  std::uint8_t reserved[16];
+};
+static_assert(sizeof(FileHeader) == 64);
+
+/// Precedes each chunk's columns; `stored[c]` is column c's size on disk.
+struct ChunkHeader {
+  std::uint64_t first_loan;
+  std::uint32_t loans;
+  std::uint32_t periods;
+  std::uint64_t stored[kColumns];
+};
+static_assert(sizeof(ChunkHeader) == 48);
+static_assert(std::endian::native == std::endian::little,
+              "schedule files are little-endian; add byte swapping for this target");
+
+#if defined(LOANSIM_HAVE_ZLIB)
+/// Delta-codes `n` period-major values (`stride` loans per period) by
+/// XOR with the same loan's previous period, then splits the results into
+/// byte planes: plane b of `out` holds byte b of every value.
+void encode_column(const double* in, std::size_t n, std::size_t stride, unsigned char* out) {
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t x = std::bit_cast<std::uint64_t>(in[i]);
+    if (i >= stride) x ^= std::bit_cast<std::uint64_t>(in[i - stride]);
+    for (std::size_t b = 0; b < sizeof x; ++b) out[b * n + i] = static_cast<unsigned char>(x >> (8 * b));
+  }
+}
+
+/// Inverse of encode_column().
+void decode_column(const unsigned char* in, std::size_t n, std::size_t stride, double* out) {
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t x = 0;
+    for (std::size_t b = 0; b < sizeof x; ++b) x |= std::uint64_t{in[b * n + i]} << (8 * b);
+    if (i >= stride) x ^= std::bit_cast<std::uint64_t>(out[i - stride]);
+    out[i] = std::bit_cast<double>(x);
+  }
+}
+#endif
+
+/// Background half of write_schedules(): takes filled buffers in order,
+/// compresses them if asked, and appends them to the file.
+class ChunkWriter {
+ public:
+  ChunkWriter(std::FILE* out, const ScheduleWriterOptions& options)
+      : out_(out), options_(options) {
+#if defined(LOANSIM_HAVE_ZLIB)
+    // Run-length deflate: after delta coding most bytes in the high planes
+    // are runs of zeros, and RLE finds them at several times the speed of
+    // the default match search for almost the same size.
+    if (options_.compression == ScheduleCompression::delta_deflate &&
+        deflateInit2(&zlib_, Z_BEST_SPEED, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK) {
+      throw std::runtime_error("write_schedules: cannot initialize zlib");
+    }
+#endif
+    thread_ = std::thread([this] { run(); });
+  }
+
+  ~ChunkWriter() {
+    {
+      const std::lock_guard lock(mutex_);
+      closing_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+#if defined(LOANSIM_HAVE_ZLIB)
+    if (options_.compression == ScheduleCompression::delta_deflate) deflateEnd(&zlib_);
+#endif
+  }
+
+  /// Blocks until slot `s` is free again, rethrowing any writer failure.
+  ScheduleBuffers& acquire(std::size_t s) {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [&] { return !slots_[s].ready || failure_; });
+    if (failure_) std::rethrow_exception(failure_);
+    return slots_[s].buffers;
+  }
+
+  /// Hands slot `s`, holding loans starting at `first_loan`, to the writer.
+  void submit(std::size_t s, std::size_t first_loan) {
+    {
+      const std::lock_guard lock(mutex_);
+      slots_[s].first_loan = first_loan;
+      slots_[s].ready = true;
+    }
+    changed_.notify_all();
+  }
+
+  /// Waits for every submitted chunk to be written; returns payload bytes.
+  std::uint64_t finish() {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [&] { return (!slots_[0].ready && !slots_[1].ready) || failure_; });
+    if (failure_) std::rethrow_exception(failure_);
+    return raw_bytes_;
+  }
+
+ private:
+  struct Slot {
+    ScheduleBuffers buffers;
+    std::size_t first_loan = 0;
+    bool ready = false;
+  };
+
+  void run() {
+    for (std::size_t next = 0;; next ^= 1) {
+      {
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [&] { return slots_[next].ready || closing_; });
+        if (!slots_[next].ready) return;
+      }
+      try {
+        write_chunk(slots_[next]);
+      } catch (...) {
+        const std::lock_guard lock(mutex_);
+        failure_ = std::current_exception();
+        changed_.notify_all();
+        return;
+      }
+      {
+        const std::lock_guard lock(mutex_);
+        slots_[next].ready = false;
+      }
+      changed_.notify_all();
+    }
+  }
+
+  void write_chunk(const Slot& slot) {
+    const ScheduleBuffers& b = slot.buffers;
+    StageScope scope(Stage::output, b.loans());
+    const std::size_t values = b.loans() * b.periods();
+    const std::size_t held = buffer_bytes();
+    const std::array<std::span<const double>, kColumns> columns = {
+        b.payment_column(), b.interest_column(), b.principal_column(), b.balance_column()};
+
+    ChunkHeader header{slot.first_loan, static_cast<std::uint32_t>(b.loans()),
+                       static_cast<std::uint32_t>(b.periods()), {}};
+    std::array<const void*, kColumns> data{};
+    for (std::size_t c = 0; c < kColumns; ++c) {
+      data[c] = columns[c].data();
+      header.stored[c] = values * sizeof(double);
+    }
+#if defined(LOANSIM_HAVE_ZLIB)
+    if (options_.compression == ScheduleCompression::delta_deflate) {
+      shuffled_.resize(values * sizeof(double));
+      const uLong bound = deflateBound(&zlib_, static_cast<uLong>(shuffled_.size()));
+      for (std::size_t c = 0; c < kColumns; ++c) {
+        packed_[c].resize(bound);
+        encode_column(columns[c].data(), values, b.loans(), shuffled_.data());
+        deflateReset(&zlib_);
+        zlib_.next_in = shuffled_.data();
+        zlib_.next_out = packed_[c].data();
+        // deflate() counts in uInt, so a column past 4 GiB is fed in slices.
+        std::size_t in_left = shuffled_.size();
+        std::size_t out_left = bound;
+        int status = Z_OK;
+        while (status == Z_OK) {
+          zlib_.avail_in = static_cast<uInt>(std::min<std::size_t>(in_left, UINT_MAX));
+          zlib_.avail_out = static_cast<uInt>(std::min<std::size_t>(out_left, UINT_MAX));
+          in_left -= zlib_.avail_in;
+          out_left -= zlib_.avail_out;
+          status = deflate(&zlib_, in_left == 0 ? Z_FINISH : Z_NO_FLUSH);
+          in_left += zlib_.avail_in;
+          out_left += zlib_.avail_out;
+        }
+        if (status != Z_STREAM_END) throw std::runtime_error("write_schedules: deflate failed");
+        data[c] = packed_[c].data();
+        header.stored[c] = zlib_.total_out;
+      }
+    }
+#endif
+    bool ok = std::fwrite(&header, sizeof header, 1, out_) == 1;
+    for (std::size_t c = 0; c < kColumns; ++c) {
+      ok = ok && std::fwrite(data[c], 1, header.stored[c], out_) == header.stored[c];
+    }
+    if (!ok) throw std::runtime_error("write_schedules: write failed");
+    raw_bytes_ += kColumns * values * sizeof(double);
+    scope.add_bytes(buffer_bytes() - held);
+  }
+
+  /// Compression buffers kept across chunks; they only ever grow.
+  [[nodiscard]] std::size_t buffer_bytes() const noexcept {
+    std::size_t n = shuffled_.capacity();
+    for (const auto& p : packed_) n += p.capacity();
+    return n;
+  }
+
+  std::FILE* out_;
+  ScheduleWriterOptions options_;
+  std::array<Slot, 2> slots_;
+  std::vector<unsigned char> shuffled_;
+  std::array<std::vector<unsigned char>, kColumns> packed_;
+#if defined(LOANSIM_HAVE_ZLIB)
+  z_stream zlib_{};
+#endif
+  std::uint64_t raw_bytes_ = 0;  // touched only by the writer until finish()
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::exception_ptr failure_;
+  bool closing_ = false;
+  std::thread thread_;  // started last, once everything above is built
+};
+
+}  // namespace
+
+const char* to_string(ScheduleCompression compression) noexcept {
+  switch (compression) {
+    case ScheduleCompression::none: return "none";
+    case ScheduleCompression::delta_deflate: return "delta-deflate";
+  }
+  return "unknown";
+}
+
+bool compression_supported(ScheduleCompression compression) noexcept {
+  switch (compression) {
+    case ScheduleCompression::none: return true;
+    case ScheduleCompression::delta_deflate:
+#if defined(LOANSIM_HAVE_ZLIB)
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+void ScheduleWriterOptions::validate() const {
+  if (chunk_loans == 0 || chunk_loans > UINT32_MAX) {
+    throw std::invalid_argument("ScheduleWriterOptions: chunk_loans");
+  }
+  if (!compression_supported(compression)) {
+    throw std::invalid_argument(std::string("ScheduleWriterOptions: ") + to_string(compression) +
+                                " is not supported by this build");
+  }
+}
+
+ScheduleWriteStats write_schedules(const LoanColumns& loans, const std::string& path,
+                                   const ScheduleWriterOptions& options) {
+  loans.validate();
+  options.validate();
+  std::FILE* out = std::fopen(path.c_str(), "wb");
+  if (out == nullptr) throw std::runtime_error("cannot create " + path);
+
+  ScheduleWriteStats stats;
+  stats.loans = loans.size();
+  stats.chunks = (loans.size() + options.chunk_loans - 1) / options.chunk_loans;
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof kMagic);
+  header.version = kVersion;
+  header.endian = kEndianMark;
+  header.loans = stats.loans;
+  header.chunks = stats.chunks;
+  header.compression = static_cast<std::uint32_t>(options.compression);
+  header.columns = kColumns;
+  header.chunk_loans = options.chunk_loans;
+
+  try {
+    if (std::fwrite(&header, sizeof header, 1, out) != 1) {
+      throw std::runtime_error("write_schedules: write failed");
+    }
+    RunArenas arenas;  // build scratch, reset per chunk
+    ChunkWriter writer(out, options);
+    for (std::size_t c = 0; c < stats.chunks; ++c) {
+      const std::size_t begin = c * options.chunk_loans;
+      const std::size_t end = std::min(begin + options.chunk_loans, loans.size());
+      ScheduleBuffers& buffers = writer.acquire(c % 2);
+      arenas.reset();
+      build_schedules(loans.slice(begin, end), buffers, &arenas);
+      writer.submit(c % 2, begin);
+    }
+    stats.raw_bytes = writer.finish();
+  } catch (...) {
+    std::fclose(out);
+    std::remove(path.c_str());
+    throw;
+  }
+  const long size = std::ftell(out);
+  if (std::fclose(out) != 0 || size < 0) throw std::runtime_error("error writing " + path);
+  stats.stored_bytes = static_cast<std::uint64_t>(size);
+  return stats;
+}
+
+ScheduleFileReader::ScheduleFileReader(const std::string& path)
+    : path_(path), file_(MappedFile::open(path)) {
+  FileHeader h{};
+  if (file_.size() < sizeof h) throw std::runtime_error(path + ": truncated schedule header");
+  std::memcpy(&h, file_.bytes().data(), sizeof h);
+  if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0) {
+    throw std::runtime_error(path + ": not a schedule file");
+  }
+  if (h.version != kVersion || h.endian != kEndianMark || h.columns != kColumns) {
+    throw std::runtime_error(path + ": unsupported schedule version or byte order");
+  }
+  compression_ = static_cast<ScheduleCompression>(h.compression);
+  if (h.compression > 1 || !compression_supported(compression_)) {
+    throw std::runtime_error(path + ": unsupported schedule compression");
+  }
+  loans_ = static_cast<std::size_t>(h.loans);
+  chunks_ = static_cast<std::size_t>(h.chunks);
+}
+
+void ScheduleFileReader::for_each_chunk(
+    const std::function<void(const ScheduleChunk& chunk)>& fn) const {
+  const std::span<const std::byte> bytes = file_.bytes();
+  std::size_t offset = sizeof(FileHeader);
+  std::array<std::vector<double>, kColumns> inflated;
+  [[maybe_unused]] std::vector<unsigned char> shuffled;
+  for (std::size_t c = 0; c < chunks_; ++c) {
+    ChunkHeader h{};
+    if (bytes.size() - offset < sizeof h) throw std::runtime_error(path_ + ": truncated chunk");
+    std::memcpy(&h, bytes.data() + offset, sizeof h);
+    offset += sizeof h;
+    const std::size_t values = std::size_t{h.loans} * h.periods;
+    std::array<std::span<const double>, kColumns> columns;
+    for (std::size_t k = 0; k < kColumns; ++k) {
+      if (bytes.size() - offset < h.stored[k]) throw std::runtime_error(path_ + ": truncated chunk");
+      const std::byte* data = bytes.data() + offset;
+      offset += h.stored[k];
+      if (compression_ == ScheduleCompression::none) {
+        if (h.stored[k] != values * sizeof(double)) {
+          throw std::runtime_error(path_ + ": corrupt chunk");
+        }
+        columns[k] = {reinterpret_cast<const double*>(data), values};
+        continue;
+      }
+#if defined(LOANSIM_HAVE_ZLIB)
+      shuffled.resize(values * sizeof(double));
+      uLongf size = static_cast<uLongf>(shuffled.size());
+      if (uncompress(shuffled.data(), &size, reinterpret_cast<const Bytef*>(data),
+                     static_cast<uLong>(h.stored[k])) != Z_OK ||
+          size != shuffled.size()) {
+        throw std::runtime_error(path_ + ": corrupt compressed chunk");
+      }
+      inflated[k].resize(values);
+      decode_column(shuffled.data(), values, h.loans, inflated[k].data());
+      columns[k] = inflated[k];
+#endif
+    }
+    fn(ScheduleChunk{static_cast<std::size_t>(h.first_loan), h.loans, h.periods, columns[0],
+                     columns[1], columns[2], columns[3]});
+  }
+}
+
+}  // namespace loansim
@@ -0,0 +1,423 @@
+#include "loansim/service.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include "loansim/arena.hpp"
+#include "loansim/parallel.hpp"
+
+#include "errno_error.hpp"
+
+namespace loansim {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using detail::throw_errno;
+
+// Longest request line accepted; a client sending more is disconnected.
+constexpr std::size_t kMaxRequestLine = 64 * 1024;
+// Pause before accepting again when out of descriptors, memory or threads.
+constexpr std::chrono::milliseconds kAcceptBackoff{50};
+
+/// Closes the descriptor on scope exit.
+struct FdGuard {
+  int fd;
+  ~FdGuard() {
+    if (fd >= 0) ::close(fd);
+  }
+};
+
+sockaddr_un socket_address(const std::string& path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof addr.sun_path) {
+    throw std::invalid_argument("socket path must be 1.." +
+                                std::to_string(sizeof addr.sun_path - 1) + " bytes");
+  }
+  std::memcpy(addr.sun_path, path.data(), path.size());
+  return addr;
+}
+
+/// Writes all of `data`; false if the peer has gone away.
+bool send_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data.remove_prefix(static_cast<std::size_t>(n));
+  }
+  return true;
+}
+
+/// Whitespace-separated words of a request line.
+std::vector<std::string_view> split_words(std::string_view line) {
+  std::vector<std::string_view> words;
+  std::size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+    const std::size_t start = i;
+    while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') ++i;
+    if (i > start) words.push_back(line.substr(start, i - start));
+  }
+  return words;
+}
+
+double parse_number(std::string_view key, std::string_view text) {
+  try {
+    std::size_t used = 0;
+    const double value = std::stod(std::string(text), &used);
+    if (used == text.size()) return value;
+  } catch (const std::exception&) {
+  }
+  throw std::invalid_argument("bad value for " + std::string(key) + ": '" + std::string(text) +
+                              "'");
+}
+
+/// A positive integer; anything else (signs, fractions, exponents, zero)
+/// gets parse_number()'s error.
+std::size_t parse_count(std::string_view key, std::string_view text) {
+  std::size_t value = 0;
+  const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (ec == std::errc() && end == text.data() + text.size() && value > 0) return value;
+  throw std::invalid_argument("bad value for " + std::string(key) + ": '" + std::string(text) +
+                              "'");
+}
+
+std::vector<double> parse_list(std::string_view key, std::string_view text) {
+  std::vector<double> out;
+  while (!text.empty()) {
+    const std::size_t cut = text.find(',');
+    out.push_back(parse_number(key, text.substr(0, cut)));
+    text = cut == std::string_view::npos ? std::string_view{} : text.substr(cut + 1);
+  }
+  return out;
+}
+
+/// A `grid` request: scenarios plus per-request model overrides.
+struct GridRequest {
+  std::vector<Scenario> scenarios;
+  ScenarioGridConfig config;
+};
+
+GridRequest parse_grid(const std::vector<std::string_view>& words,
+                       const ScenarioGridConfig& defaults) {
+  GridRequest request{{}, defaults};
+  std::vector<double> shocks = {0.0};
+  std::vector<double> speeds = {1.0};
+  double cdr = 0.0;
+  double severity = 0.0;
+  for (std::size_t i = 1; i < words.size(); ++i) {
+    const std::size_t eq = words[i].find('=');
+    if (eq == std::string_view::npos) {
+      throw std::invalid_argument("expected key=value, got '" + std::string(words[i]) + "'");
+    }
+    const std::string_view key = words[i].substr(0, eq);
+    const std::string_view value = words[i].substr(eq + 1);
+    ScenarioGridConfig& c = request.config;
+    if (key == "shocks") {
+      shocks = parse_list(key, value);
+      for (double& bp : shocks) bp *= 1e-4;
+    } else if (key == "speeds") {
+      speeds = parse_list(key, value);
+    } else if (key == "cdr") {
+      cdr = parse_number(key, value);
+    } else if (key == "severity") {
+      severity = parse_number(key, value);
+    } else if (key == "price") {
+      c.price = parse_number(key, value);
+    } else if (key == "base_cpr") {
+      c.base_cpr = parse_number(key, value);
+    } else if (key == "refi_sensitivity") {
+      c.refi_sensitivity = parse_number(key, value);
+    } else if (key == "market_rate") {
+      c.market_rate = parse_number(key, value);
+    } else if (key == "batch") {
+      c.scenario_batch = parse_count(key, value);
+    } else {
+      throw std::invalid_argument("unknown grid key '" + std::string(key) + "'");
+    }
+  }
+  request.scenarios = make_scenario_grid(shocks, speeds, cdr, severity);
+  return request;
+}
+
+std::string format(const char* fmt, auto... args) {
+  char buf[512];
+  const int n = std::snprintf(buf, sizeof buf, fmt, args...);
+  return std::string(buf, static_cast<std::size_t>(std::min<int>(n, sizeof buf - 1)));
+}
+
+}  // namespace
+
+void ServiceConfig::validate() const {
+  (void)socket_address(socket_path);
+  if (!(grid.price > 0.0)) throw std::invalid_argument("ServiceConfig: grid.price must be > 0");
+}
+
+SimulationService::SimulationService(const LoanColumns& loans, ServiceConfig config)
+    : pool_(loans), config_(std::move(config)) {
+  config_.validate();
+  config_.grid.threads = config_.threads_per_request;
+  config_.grid.loan_analytics = false;
+}
+
+SimulationService::~SimulationService() { stop(); }
+
+void SimulationService::stop() noexcept {
+  stopping_.store(true);
+  // Wakes the accept() in serve(); the descriptor is closed there, after
+  // it has been unpublished under the same lock.
+  const std::lock_guard lock(listen_mutex_);
+  if (listen_fd_ >= 0) ::shutdown(listen_fd_, SHUT_RDWR);
+}
+
+ServiceStats SimulationService::stats() const {
+  const std::lock_guard lock(stats_mutex_);
+  return stats_;
+}
+
+void SimulationService::record(const RequestRecord& r) {
+  {
+    const std::lock_guard lock(stats_mutex_);
+    ++stats_.requests;
+    if (!r.ok) ++stats_.failed;
+    stats_.latency.add(r.latency_seconds);
+    stats_.max_latency = std::max(stats_.max_latency, r.latency_seconds);
+  }
+  if (config_.on_request) config_.on_request(r);
+}
+
+std::string SimulationService::handle(std::string_view request, RunArenas& arenas) {
+  RequestRecord record;
+  return respond(request, arenas, record);
+}
+
+std::string SimulationService::respond(std::string_view request, RunArenas& arenas,
+                                       RequestRecord& rec) {
+  const std::vector<std::string_view> words = split_words(request);
+  rec.ok = false;
+  if (words.empty()) return "error empty request\n";
+  rec.command = words[0];
+  try {
+    if (words[0] == "info") {
+      rec.ok = true;
+      return format("ok loans=%zu periods=%zu\n", pool_.size(), pool_.periods());
+    }
+    if (words[0] == "stats") {
+      const ServiceStats s = stats();
+      rec.ok = true;
+      return format("ok requests=%llu failed=%llu mean_ms=%.3f max_ms=%.3f\n",
+                    static_cast<unsigned long long>(s.requests),
+                    static_cast<unsigned long long>(s.failed), s.latency.mean * 1e3,
+                    s.max_latency * 1e3);
+    }
+    if (words[0] == "shutdown") {
+      stop();
+      rec.ok = true;
+      return "ok\n";
+    }
+    if (words[0] == "grid") {
+      const auto start = Clock::now();
+      const GridRequest g = parse_grid(words, config_.grid);
+      arenas.reset();
+      const std::vector<ScenarioResult> results = pool_.run(g.scenarios, g.config, &arenas);
+      std::string reply;
+      for (const ScenarioResult& r : results) {
+        double prepaid = 0.0;
+        double loss = 0.0;
+        for (std::size_t t = 0; t < r.flows.periods(); ++t) {
+          prepaid += r.flows.prepayment[t];
+          loss += r.flows.loss[t];
+        }
+        reply += r.scenario.name;
+        reply += format("\t%.2f\t%.2f\t%.2f\t%.8f\t%.6f\t%.6f\n", r.present_value, prepaid, loss,
+                        r.analytics.yield, r.analytics.modified_duration, r.analytics.wal);
+      }
+      const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+      reply += format("ok scenarios=%zu latency_ms=%.3f\n", results.size(), elapsed * 1e3);
+      rec.scenarios = results.size();
+      rec.ok = true;
+      return reply;
+    }
+    return "error unknown command '" + std::string(words[0]) + "'\n";
+  } catch (const std::exception& e) {
+    std::string what = e.what();
+    for (char& c : what) {
+      if (c == '\n') c = ' ';
+    }
+    return "error " + what + "\n";
+  }
+}
+
+void SimulationService::serve_connection(int fd) {
+  RunArenas arenas;
+  std::string buffer;
+  char chunk[4096];
+  while (true) {
+    const std::size_t eol = buffer.find('\n');
+    if (eol == std::string::npos) {
+      if (buffer.size() > kMaxRequestLine) {
+        (void)send_all(fd, "error request line too long\n");
+        return;
+      }
+      const ssize_t n = ::recv(fd, chunk, sizeof chunk, 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return;  // peer closed, or serve() is shutting down
+      buffer.append(chunk, static_cast<std::size_t>(n));
+      continue;
+    }
+
+    const auto start = Clock::now();
+    const std::string_view line(buffer.data(), eol);
+    RequestRecord r;
+    const std::string reply = respond(line, arenas, r);
+    const bool sent = send_all(fd, reply);
+    r.latency_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    record(r);
+
+    buffer.erase(0, eol + 1);
+    if (!sent) return;
+  }
+}
+
+void SimulationService::serve() {
+  const sockaddr_un addr = socket_address(config_.socket_path);
+  FdGuard listener{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (listener.fd < 0) throw_errno("cannot create socket for", config_.socket_path);
+  // A stale socket from an earlier run is replaced; anything else is left.
+  struct stat existing {};
+  if (::lstat(config_.socket_path.c_str(), &existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      throw std::system_error(EEXIST, std::generic_category(),
+                              config_.socket_path + ": path exists and is not a socket");
+    }
+    ::unlink(config_.socket_path.c_str());
+  } else if (errno != ENOENT) {
+    throw_errno("cannot inspect", config_.socket_path);
+  }
+  if (::bind(listener.fd, reinterpret_cast<const sockaddr*>(&addr), sizeof addr) != 0) {
+    throw_errno("cannot bind", config_.socket_path);
+  }
+  if (::listen(listener.fd, SOMAXCONN) != 0) throw_errno("cannot listen on", config_.socket_path);
+  {
+    const std::lock_guard lock(listen_mutex_);
+    listen_fd_ = listener.fd;
+    // stop() may have run before the descriptor was published.
+    if (stopping_.load()) ::shutdown(listener.fd, SHUT_RDWR);
+  }
+
+  // Descriptors are closed only here, after their thread has been joined,
+  // so shutting one down below can never hit a reused descriptor.
+  struct Connection {
+    int fd = -1;
+    std::atomic<bool> done{false};
+    std::thread thread;
+  };
+  std::list<Connection> connections;
+  const auto reap = [&](bool all) {
+    for (auto it = connections.begin(); it != connections.end();) {
+      if (!all && !it->done.load()) {
+        ++it;
+        continue;
+      }
+      it->thread.join();
+      ::close(it->fd);
+      it = connections.erase(it);
+    }
+  };
+  // Runs on every way out of serve(): a joinable thread left in
+  // `connections` would terminate the process when the list is destroyed.
+  const auto close_all = [&] {
+    {
+      const std::lock_guard lock(listen_mutex_);
+      listen_fd_ = -1;
+    }
+    // Ends each connection's wait for its next request; one mid-request
+    // finishes and sends its reply first.
+    for (Connection& c : connections) ::shutdown(c.fd, SHUT_RD);
+    reap(true);
+    ::unlink(config_.socket_path.c_str());
+  };
+  try {
+    while (!stopping_.load()) {
+      const int fd = ::accept4(listener.fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (stopping_.load()) break;
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+          // Out of descriptors or memory, e.g. under a burst of clients:
+          // finishing connections free some, so wait and retry.
+          reap(false);
+          std::this_thread::sleep_for(kAcceptBackoff);
+          continue;
+        }
+        throw_errno("accept failed on", config_.socket_path);
+      }
+      reap(false);
+      Connection& c = connections.emplace_back();
+      c.fd = fd;
+      try {
+        c.thread = std::thread([this, &c] {
+          serve_connection(c.fd);
+          c.done.store(true);
+        });
+      } catch (const std::system_error&) {
+        // No thread to spare: turn this client away and retry later.
+        (void)send_all(fd, "error service busy\n");
+        ::close(fd);
+        connections.pop_back();
+        std::this_thread::sleep_for(kAcceptBackoff);
+      }
+    }
+  } catch (...) {
+    close_all();
+    throw;
+  }
+  close_all();
+}
+
+std::string service_request(const std::string& socket_path, std::string_view request) {
+  const sockaddr_un addr = socket_address(socket_path);
+  const FdGuard fd{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+  if (fd.fd < 0) throw_errno("cannot create socket for", socket_path);
+  if (::connect(fd.fd, reinterpret_cast<const sockaddr*>(&addr), sizeof addr) != 0) {
+    throw_errno("cannot connect to", socket_path);
+  }
+  std::string line(request);
+  line += '\n';
+  if (!send_all(fd.fd, line)) throw_errno("cannot send to", socket_path);
+
+  // The reply ends with the first line starting with "ok" or "error".
+  std::string reply;
+  std::size_t line_start = 0;
+  char chunk[4096];
+  while (true) {
+    for (std::size_t eol; (eol = reply.find('\n', line_start)) != std::string::npos;) {
+      const std::string_view last(reply.data() + line_start, eol - line_start);
+      line_start = eol + 1;
+      if (last.starts_with("ok") || last.starts_with("error")) return reply;
+    }
+    const ssize_t n = ::recv(fd.fd, chunk, sizeof chunk, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) throw_errno("cannot read from", socket_path);
+    if (n == 0) throw std::runtime_error("service at " + socket_path + " closed the connection");
+    reply.append(chunk, static_cast<std::size_t>(n));
+  }
+}
+
+}  // namespace loansim
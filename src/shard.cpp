@@ -0,0 +1,187 @@
+#include "loansim/shard.hpp"
+
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "loansim/mapped_file.hpp"
+#include "loansim/rng.hpp"
+
+namespace loansim {
+namespace {
+
+constexpr char kMagic[8] = {'L', 'S', 'I', 'M', 'P', 'A', 'R', 'T'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kEndianMark = 0x01020304u;
+constexpr std::uint32_t kHashKey = 0x5AA2'D5EDu;
+
+/// File layout: this header, the scheduled totals (four series of
+/// `scheduled_periods`), the Monte Carlo flow sums (six series of
+/// `flow_periods`), then `paths` PathValues.
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t endian;
+  std::uint64_t loans;
+  std::uint64_t settings;
+  std::uint64_t scheduled_periods;
+  std::uint64_t flow_periods;
+  std::uint64_t paths;
+  std::uint8_t reserved[8];
+};
+static_assert(sizeof(FileHeader) == 64);
+static_assert(sizeof(PathValues) == 4 * sizeof(double));
+static_assert(std::endian::native == std::endian::little,
+              "shard files are little-endian; add byte swapping for this target");
+
+template <class Totals>
+auto scheduled_series(Totals& s) {
+  return std::array{&s.interest, &s.principal, &s.opening_balance, &s.closing_balance};
+}
+
+template <class Flows>
+auto flow_series(Flows& f) {
+  return std::array{&f.interest, &f.scheduled_principal, &f.prepayment,
+                    &f.defaults, &f.loss,                &f.balance};
+}
+
+}  // namespace
+
+const char* to_string(ShardKey key) noexcept {
+  switch (key) {
+    case ShardKey::range: return "range";
+    case ShardKey::hash: return "hash";
+  }
+  return "unknown";
+}
+
+ShardKey parse_shard_key(std::string_view name) {
+  if (name == "range") return ShardKey::range;
+  if (name == "hash") return ShardKey::hash;
+  throw std::invalid_argument("unknown shard key '" + std::string(name) + "'");
+}
+
+std::vector<LoanPool> partition_pool(const LoanColumns& loans, std::size_t shards, ShardKey key) {
+  if (shards == 0) throw std::invalid_argument("partition_pool: shards must be positive");
+  loans.validate();
+  std::vector<LoanPool> out(shards);
+  const std::size_t n = loans.size();
+  if (key == ShardKey::range) {
+    for (std::size_t s = 0; s < shards; ++s) {
+      const std::size_t begin = n * s / shards;
+      const std::size_t end = n * (s + 1) / shards;
+      out[s].reserve(end - begin);
+      for (std::size_t i = begin; i < end; ++i) {
+        out[s].push_back(loans.principal[i], loans.annual_rate[i], loans.term_months[i]);
+      }
+    }
+    return out;
+  }
+  for (LoanPool& pool : out) pool.reserve(n / shards + n / shards / 8 + 16);
+  const Philox4x32 gen(kHashKey);
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto word = gen({static_cast<std::uint32_t>(i),
+                           static_cast<std::uint32_t>(std::uint64_t{i} >> 32), 0, 0})[0];
+    out[word % shards].push_back(loans.principal[i], loans.annual_rate[i], loans.term_months[i]);
+  }
+  return out;
+}
+
+ShardResult run_shard(const LoanColumns& loans, const MonteCarloConfig& config,
+                      RunArenas* arenas) {
+  ShardResult result;
+  result.loans = loans.size();
+  result.scheduled = scheduled_totals(loans, config.threads, arenas);
+  result.monte_carlo = simulate_partial(loans, config, arenas);
+  return result;
+}
+
+void write_shard_result(const ShardResult& result, const std::string& path) {
+  const MonteCarloPartial& mc = result.monte_carlo;
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof kMagic);
+  header.version = kVersion;
+  header.endian = kEndianMark;
+  header.loans = result.loans;
+  header.settings = mc.settings;
+  header.scheduled_periods = result.scheduled.periods();
+  header.flow_periods = mc.sum.periods();
+  header.paths = mc.paths.size();
+
+  std::FILE* out = std::fopen(path.c_str(), "wb");
+  if (out == nullptr) throw std::runtime_error("cannot create " + path);
+  bool ok = std::fwrite(&header, sizeof header, 1, out) == 1;
+  for (const std::pmr::vector<double>* v : scheduled_series(result.scheduled)) {
+    ok = ok && std::fwrite(v->data(), sizeof(double), v->size(), out) == v->size();
+  }
+  for (const std::pmr::vector<double>* v : flow_series(mc.sum)) {
+    ok = ok && std::fwrite(v->data(), sizeof(double), v->size(), out) == v->size();
+  }
+  ok = ok && std::fwrite(mc.paths.data(), sizeof(PathValues), mc.paths.size(), out) ==
+                 mc.paths.size();
+  if (std::fclose(out) != 0 || !ok) {
+    std::remove(path.c_str());
+    throw std::runtime_error("error writing " + path);
+  }
+}
+
+ShardResult read_shard_result(const std::string& path) {
+  const MappedFile file = MappedFile::open(path);
+  std::span<const std::byte> bytes = file.bytes();
+  FileHeader h{};
+  if (bytes.size() < sizeof h) throw std::runtime_error(path + ": truncated shard result");
+  std::memcpy(&h, bytes.data(), sizeof h);
+  if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0) {
+    throw std::runtime_error(path + ": not a shard result");
+  }
+  if (h.version != kVersion || h.endian != kEndianMark) {
+    throw std::runtime_error(path + ": unsupported shard result version or byte order");
+  }
+  const std::uint64_t expected = sizeof h + 4 * h.scheduled_periods * sizeof(double) +
+                                 6 * h.flow_periods * sizeof(double) +
+                                 h.paths * sizeof(PathValues);
+  if (bytes.size() != expected) throw std::runtime_error(path + ": truncated shard result");
+  bytes = bytes.subspan(sizeof h);
+
+  ShardResult result;
+  result.loans = h.loans;
+  result.monte_carlo.settings = h.settings;
+  const auto read = [&](std::pmr::vector<double>& v, std::uint64_t n) {
+    v.resize(n);
+    std::memcpy(v.data(), bytes.data(), n * sizeof(double));
+    bytes = bytes.subspan(n * sizeof(double));
+  };
+  for (std::pmr::vector<double>* v : scheduled_series(result.scheduled)) {
+    read(*v, h.scheduled_periods);
+  }
+  for (std::pmr::vector<double>* v : flow_series(result.monte_carlo.sum)) {
+    read(*v, h.flow_periods);
+  }
+  result.monte_carlo.paths.resize(h.paths);
+  std::memcpy(result.monte_carlo.paths.data(), bytes.data(), h.paths * sizeof(PathValues));
+  return result;
+}
+
+MergedResult merge_shards(std::span<const ShardResult> shards,
+                          const CashFlowAssumptions& assumptions,
+                          const MonteCarloConfig& config) {
+  assumptions.validate();
+  if (shards.empty()) throw std::invalid_argument("merge_shards: no shards");
+  MergedResult merged;
+  ScheduledTotals total;
+  std::vector<MonteCarloPartial> parts;
+  parts.reserve(shards.size());
+  for (const ShardResult& s : shards) {
+    merged.loans += s.loans;
+    total.add(s.scheduled);
+    parts.push_back(s.monte_carlo);
+  }
+  merged.cash_flows = apply_assumptions(total, assumptions);
+  merged.monte_carlo = merge_partials(parts, config);
+  return merged;
+}
+
+}  // namespace loansim
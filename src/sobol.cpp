@@ -0,0 +1,86 @@
+#include "loansim/sobol.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "loansim/rng.hpp"
+
+namespace loansim {
+namespace {
+
+/// a * b mod p over GF(2); `p` has degree `d`, a and b are reduced.
+std::uint32_t mulmod(std::uint32_t a, std::uint32_t b, std::uint32_t p, int d) noexcept {
+  std::uint32_t r = 0;
+  for (; b != 0; b >>= 1) {
+    if (b & 1u) r ^= a;
+    a <<= 1;
+    if (a >> d) a ^= p;
+  }
+  return r;
+}
+
+/// x^e mod p.
+std::uint32_t powmod(std::uint64_t e, std::uint32_t p, int d) noexcept {
+  std::uint32_t result = 1;
+  std::uint32_t base = d == 1 ? (2u ^ p) : 2u;
+  for (; e != 0; e >>= 1) {
+    if (e & 1u) result = mulmod(result, base, p, d);
+    base = mulmod(base, base, p, d);
+  }
+  return result;
+}
+
+/// True if `p` (degree `d`, constant term set) is primitive: x has order
+/// exactly 2^d - 1 modulo p.
+bool is_primitive(std::uint32_t p, int d) {
+  const std::uint64_t order = (std::uint64_t{1} << d) - 1;
+  if (powmod(order, p, d) != 1) return false;
+  std::uint64_t rest = order;
+  for (std::uint64_t q = 3; q * q <= rest; q += 2) {
+    if (rest % q != 0) continue;
+    if (powmod(order / q, p, d) == 1) return false;
+    while (rest % q == 0) rest /= q;
+  }
+  return rest == 1 || rest == order || powmod(order / rest, p, d) != 1;
+}
+
+}  // namespace
+
+SobolSequence::SobolSequence(std::size_t dimensions)
+    : dimensions_(dimensions), directions_(dimensions * 32) {
+  if (dimensions == 0 || dimensions > kMaxDimensions) {
+    throw std::invalid_argument("SobolSequence: dimensions must be in [1, " +
+                                std::to_string(kMaxDimensions) + "]");
+  }
+  for (int k = 0; k < 32; ++k) directions_[k] = 1u << (31 - k);
+
+  const Philox4x32 gen(0x50B0'1D1Eu);
+  std::size_t dim = 1;
+  for (int d = 1; dim < dimensions; ++d) {
+    for (std::uint32_t low = 0; low < (1u << (d - 1)) && dim < dimensions; ++low) {
+      const std::uint32_t p = (1u << d) | (low << 1) | 1u;
+      if (!is_primitive(p, d)) continue;
+      // m_1 .. m_d odd with m_k < 2^k; the rest follow the recurrence
+      // m_k = m_{k-d} ^ (m_{k-d} << d) ^ sum_i a_i (m_{k-i} << i), where
+      // a_i is the coefficient of x^(d-i).
+      std::uint64_t m[33] = {};
+      for (int k = 1; k <= d; ++k) {
+        const std::uint32_t h =
+            gen({static_cast<std::uint32_t>(dim), static_cast<std::uint32_t>(k), 0x50B0u, 0})[0];
+        m[k] = k == 1 ? 1 : ((std::uint64_t{h} >> (33 - k)) << 1) | 1;
+      }
+      for (int k = d + 1; k <= 32; ++k) {
+        std::uint64_t v = m[k - d] ^ (m[k - d] << d);
+        for (int i = 1; i < d; ++i) {
+          if ((p >> (d - i)) & 1u) v ^= m[k - i] << i;
+        }
+        m[k] = v;
+      }
+      std::uint32_t* out = &directions_[dim * 32];
+      for (int k = 1; k <= 32; ++k) out[k - 1] = static_cast<std::uint32_t>(m[k] << (32 - k));
+      ++dim;
+    }
+  }
+}
+
+}  // namespace loansim
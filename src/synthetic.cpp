@@ -0,0 +1,30 @@
+#include "loansim/synthetic.hpp"
+
+#include <array>
+#include <cmath>
+
+#include "loansim/rng.hpp"
+
+namespace loansim {
+
+LoanPool make_synthetic_pool(std::size_t loans, std::uint64_t seed) {
+  static constexpr std::array<std::int32_t, 8> kTerms = {360, 360, 360, 360, 360, 180, 240, 120};
+  const Philox4x32 gen(seed);
+  LoanPool pool;
+  pool.reserve(loans);
+  for (std::size_t i = 0; i < loans; ++i) {
+    const auto words = gen({static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(i >> 32),
+                            0x5EED0001u, 0});
+    const double u_balance = to_unit_interval(words[0], words[1]);
+    const double u_rate = to_unit_interval(words[1], words[2]);
+    const std::int32_t original = kTerms[words[3] % kTerms.size()];
+    const auto age = static_cast<std::int32_t>((words[3] >> 8) % 61);
+
+    const double balance = std::round((50'000.0 + 900'000.0 * u_balance) * 100.0) / 100.0;
+    const double rate = (2.5 + std::floor(u_rate * 44.0) * 0.125) / 100.0;
+    pool.push_back(balance, rate, original - age);
+  }
+  return pool;
+}
+
+}  // namespace loansim
@@ -0,0 +1,42 @@
+#pragma once
+
+// Internal: field splitting and error reporting shared by the text readers.
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace loansim::detail {
+
+/// Throws std::runtime_error for `path`:`line`.
+[[noreturn]] inline void parse_error(const std::string& path, std::size_t line, const char* what) {
+  throw std::runtime_error(path + ":" + std::to_string(line) + ": " + what);
+}
+
+/// `s` without surrounding blanks, tabs and quotes, or a trailing '\r'.
+inline std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '"' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '"' || s.back() == '\t' ||
+                        s.back() == '\r')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+/// Splits `line` on `delim` into `fields`, untrimmed, reusing its storage.
+inline void split_fields(std::string_view line, char delim,
+                         std::vector<std::string_view>& fields) {
+  fields.clear();
+  for (;;) {
+    const std::size_t cut = line.find(delim);
+    fields.push_back(line.substr(0, cut));
+    if (cut == std::string_view::npos) return;
+    line.remove_prefix(cut + 1);
+  }
+}
+
+}  // namespace loansim::detail
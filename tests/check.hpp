@@ -0,0 +1,36 @@
+#pragma once
+
+// Minimal assertions for the ctest checks: a failed CHECK prints the
+// expression and its location, and finish() turns any failure into a
+// non-zero exit.
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace loansim::test {
+
+inline int failures = 0;
+
+inline void check(bool ok, const char* what, const char* file, int line) {
+  if (ok) return;
+  ++failures;
+  std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, what);
+}
+
+/// True if the two series have the same length and the same bits.
+template <class A, class B>
+bool same_bits(const A& a, const B& b) {
+  return a.size() == b.size() &&
+         (a.size() == 0 || std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+}
+
+inline int finish() {
+  if (failures != 0) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
+
+}  // namespace loansim::test
+
+#define LOANSIM_CHECK(cond) \
+  ::loansim::test::check(static_cast<bool>(cond), #cond, __FILE__, __LINE__)
@@ -0,0 +1,74 @@
+#pragma once
+
+// Bitwise and relative comparisons of engine results for the ctest checks.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "check.hpp"
+
+#include "loansim/aggregate.hpp"
+#include "loansim/cash_flows.hpp"
+#include "loansim/monte_carlo.hpp"
+
+namespace loansim::test {
+
+inline bool same_totals(const ScheduledTotals& a, const ScheduledTotals& b) {
+  return same_bits(a.interest, b.interest) && same_bits(a.principal, b.principal) &&
+         same_bits(a.opening_balance, b.opening_balance) &&
+         same_bits(a.closing_balance, b.closing_balance);
+}
+
+inline bool same_flows(const PoolCashFlows& a, const PoolCashFlows& b) {
+  return same_bits(a.interest, b.interest) &&
+         same_bits(a.scheduled_principal, b.scheduled_principal) &&
+         same_bits(a.prepayment, b.prepayment) && same_bits(a.defaults, b.defaults) &&
+         same_bits(a.loss, b.loss) && same_bits(a.balance, b.balance);
+}
+
+inline bool same_stats(const RunningStats& a, const RunningStats& b) {
+  return std::memcmp(&a, &b, sizeof a) == 0;
+}
+
+inline bool same_estimate(const Estimate& a, const Estimate& b) {
+  return std::memcmp(&a.mean, &b.mean, sizeof a.mean) == 0 &&
+         std::memcmp(&a.std_error, &b.std_error, sizeof a.std_error) == 0 &&
+         a.samples == b.samples;
+}
+
+inline bool same_result(const MonteCarloResult& a, const MonteCarloResult& b) {
+  return a.paths == b.paths && same_flows(a.mean, b.mean) &&
+         same_stats(a.present_value, b.present_value) && same_stats(a.total_loss, b.total_loss) &&
+         same_estimate(a.present_value_estimate, b.present_value_estimate) &&
+         same_estimate(a.total_loss_estimate, b.total_loss_estimate);
+}
+
+/// True if `a` and `b` agree to `tolerance` relative to the larger of
+/// their magnitudes.
+inline bool near(double a, double b, double tolerance) {
+  return std::abs(a - b) <= tolerance * std::max(std::abs(a), std::abs(b));
+}
+
+/// True if every period of every series agrees to `tolerance` relative to
+/// the series' largest value.
+inline bool near_flows(const PoolCashFlows& a, const PoolCashFlows& b, double tolerance) {
+  if (a.periods() != b.periods()) return false;
+  const auto series = [](const PoolCashFlows& f) {
+    return std::array{&f.interest, &f.scheduled_principal, &f.prepayment,
+                      &f.defaults, &f.loss,                &f.balance};
+  };
+  const auto x = series(a);
+  const auto y = series(b);
+  for (std::size_t s = 0; s < x.size(); ++s) {
+    double scale = 0.0;
+    for (const double v : *x[s]) scale = std::max(scale, std::abs(v));
+    for (std::size_t t = 0; t < a.periods(); ++t) {
+      if (std::abs((*x[s])[t] - (*y[s])[t]) > tolerance * scale) return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace loansim::test
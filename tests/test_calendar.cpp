@@ -0,0 +1,60 @@
+// 30/360 accrual: whole-month periods accrue exactly 1 for every day of
+// origination, so dated tables reproduce the undated schedule bit for bit.
+
+#include "results.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/schedule.hpp"
+#include "loansim/synthetic.hpp"
+
+using loansim::test::same_flows;
+using loansim::test::same_totals;
+
+namespace {
+
+loansim::Date date(int y, unsigned m, unsigned d) {
+  return loansim::Date{std::chrono::year{y} / std::chrono::month{m} / std::chrono::day{d}};
+}
+
+}  // namespace
+
+int main() {
+  constexpr auto kThirty360 = loansim::DayCount::thirty_360;
+  LOANSIM_CHECK(loansim::accrual_months(date(2023, 1, 28), date(2023, 2, 28), kThirty360) == 1.0);
+  LOANSIM_CHECK(loansim::accrual_months(date(2024, 1, 31), date(2024, 3, 31), kThirty360) == 2.0);
+  LOANSIM_CHECK(loansim::accrual_months(date(2024, 1, 30), date(2024, 3, 31), kThirty360) == 2.0);
+  LOANSIM_CHECK(loansim::accrual_months(date(2024, 1, 15), date(2024, 1, 31), kThirty360) ==
+                16.0 / 30.0);
+
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(6'200, 17);
+  loansim::AccrualTables tables(loansim::max_term(pool.columns()));
+  // Every day of the month, originated in a leap and in a common year.
+  std::vector<std::uint32_t> ids;
+  for (const int year : {2023, 2024}) {
+    for (unsigned day = 1; day <= 31; ++day) {
+      ids.push_back(tables.intern(date(year, 1, day), loansim::AccrualConvention{}));
+    }
+  }
+  bool whole_months = true;
+  for (const std::uint32_t id : ids) {
+    for (const double factor : tables.accrual(id)) whole_months &= factor == 1.0;
+  }
+  LOANSIM_CHECK(whole_months);
+
+  std::vector<std::uint32_t> table(pool.size());
+  for (std::size_t i = 0; i < table.size(); ++i) table[i] = ids[i % ids.size()];
+  const loansim::LoanAccrual accrual{&tables, table};
+  for (const unsigned threads : {1u, 4u}) {
+    LOANSIM_CHECK(same_totals(loansim::scheduled_totals(pool.columns(), accrual, threads),
+                              loansim::scheduled_totals(pool.columns(), threads)));
+  }
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  LOANSIM_CHECK(same_flows(loansim::aggregate_pool(pool.columns(), accrual, assumptions),
+                           loansim::aggregate_pool(pool.columns(), assumptions)));
+  return loansim::test::finish();
+}
@@ -0,0 +1,76 @@
+// simulate_pool(): a run killed after a checkpoint and resumed, at another
+// thread count, is bit-identical to an uninterrupted run.
+
+#include "results.hpp"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "loansim/monte_carlo.hpp"
+#include "loansim/synthetic.hpp"
+
+namespace {
+
+/// Runs `config` in a child process and kills it once its first snapshot
+/// is on disk. Returns false if the child finished first.
+bool interrupt_after_snapshot(const loansim::LoanColumns& loans,
+                              const loansim::MonteCarloConfig& config) {
+  const pid_t child = ::fork();
+  if (child < 0) return false;
+  if (child == 0) {
+    (void)loansim::simulate_pool(loans, config);
+    std::_Exit(0);
+  }
+  bool killed = false;
+  for (;;) {
+    if (std::filesystem::exists(config.checkpoint_path)) {
+      ::kill(child, SIGKILL);
+      killed = true;
+      break;
+    }
+    if (::waitpid(child, nullptr, WNOHANG) == child) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  int status = 0;
+  ::waitpid(child, &status, 0);
+  return killed && WIFSIGNALED(status);
+}
+
+}  // namespace
+
+int main() {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(64, 3);
+  loansim::MonteCarloConfig config;
+  config.paths = 8'192;
+  config.seed = 42;
+  config.threads = 1;
+  config.control_variate = true;
+  const loansim::MonteCarloResult whole = loansim::simulate_pool(pool.columns(), config);
+
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / ("loansim_ckpt_" + std::to_string(::getpid()));
+  std::filesystem::create_directories(dir);
+  config.checkpoint_path = (dir / "run.ckpt").string();
+  config.checkpoint_interval = 0.0;
+
+  // One thread makes four-block waves, so the first snapshot lands 1/32 of
+  // the way through the run.
+  LOANSIM_CHECK(interrupt_after_snapshot(pool.columns(), config));
+  LOANSIM_CHECK(std::filesystem::exists(config.checkpoint_path));
+
+  config.threads = 3;
+  const loansim::MonteCarloResult resumed = loansim::simulate_pool(pool.columns(), config);
+  LOANSIM_CHECK(loansim::test::same_result(resumed, whole));
+  LOANSIM_CHECK(!std::filesystem::exists(config.checkpoint_path));
+
+  std::filesystem::remove_all(dir);
+  return loansim::test::finish();
+}
@@ -0,0 +1,34 @@
+// IncrementalPool: patched totals are bit-identical to a full rerun.
+
+#include "results.hpp"
+
+#include "loansim/aggregate.hpp"
+#include "loansim/incremental.hpp"
+#include "loansim/synthetic.hpp"
+
+using loansim::test::same_bits;
+using loansim::test::same_totals;
+
+int main() {
+  const loansim::LoanPool base = loansim::make_synthetic_pool(40'000, 11);
+  loansim::IncrementalPool pool(base.columns(), 2);
+  LOANSIM_CHECK(same_totals(pool.scheduled(), loansim::scheduled_totals(base.columns(), 1)));
+
+  pool.modify(5, 250'000.0, 0.0625, 480);
+  pool.modify(20'000, 0.0, 0.0, 12);
+  pool.pay_off(39'999);
+  pool.add(1'000'000.0, 0.03, 120);
+  LOANSIM_CHECK(pool.dirty_chunks() == 3);
+  const loansim::ScheduledTotals& patched = pool.scheduled();
+  LOANSIM_CHECK(pool.dirty_chunks() == 0);
+  for (const unsigned threads : {1u, 4u}) {
+    LOANSIM_CHECK(
+        same_totals(patched, loansim::scheduled_totals(pool.loans().columns(), threads)));
+  }
+
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  const loansim::PoolCashFlows flows = pool.cash_flows(assumptions);
+  const loansim::PoolCashFlows full = loansim::aggregate_pool(pool.loans().columns(), assumptions);
+  LOANSIM_CHECK(same_bits(flows.balance, full.balance) && same_bits(flows.loss, full.loss));
+  return loansim::test::finish();
+}
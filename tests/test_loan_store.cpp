@@ -0,0 +1,65 @@
+// LoanStore cold columns: identifiers keep their text (zero-padded IDs and
+// ZIP codes, long numbers), decimals read back as numbers with blanks
+// missing, and the hot set decodes to the tape's loans.
+
+#include "check.hpp"
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "loansim/loan_store.hpp"
+
+namespace {
+
+using Kind = loansim::ColdColumn::Kind;
+
+bool text_column(const loansim::ColdColumn* c) {
+  return c != nullptr && (c->kind() == Kind::category || c->kind() == Kind::text);
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path path = std::filesystem::temp_directory_path() /
+                                     ("loansim_store_" + std::to_string(::getpid()) + ".csv");
+  {
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    LOANSIM_CHECK(out != nullptr);
+    std::fputs("loan_id,principal,annual_rate,term_months,zip,state,fico,account,ltv\n"
+               "000123,250000.00,0.0625,360,02134,MA,720,12345678901234567890,0.8\n"
+               "000124,125000.50,0.0450,180,10001,NY,,12345678901234567891,1e-1\n",
+               out);
+    std::fclose(out);
+  }
+  const loansim::LoanStore store = loansim::LoanStore::read_csv(path.string());
+  std::filesystem::remove(path);
+
+  LOANSIM_CHECK(store.size() == 2);
+  const loansim::LoanPool loans = store.decode_all();
+  LOANSIM_CHECK(loans.principal[1] == 125000.50 && loans.annual_rate[0] == 0.0625 &&
+                loans.term_months[1] == 180);
+
+  const loansim::ColdColumn* id = store.cold("loan_id");
+  LOANSIM_CHECK(text_column(id) && id->text(0) == "000123" && id->text(1) == "000124");
+  const loansim::ColdColumn* zip = store.cold("zip");
+  LOANSIM_CHECK(text_column(zip) && zip->text(0) == "02134" && zip->text(1) == "10001");
+  const loansim::ColdColumn* account = store.cold("account");
+  LOANSIM_CHECK(text_column(account) && account->text(1) == "12345678901234567891");
+  const loansim::ColdColumn* ltv = store.cold("ltv");  // an exponent keeps the text
+  LOANSIM_CHECK(text_column(ltv) && ltv->text(1) == "1e-1");
+
+  const loansim::ColdColumn* state = store.cold("state");
+  LOANSIM_CHECK(state != nullptr && state->kind() == Kind::category);
+  LOANSIM_CHECK(state->categories().size() == 2 && state->text(1) == "NY" &&
+                state->categories()[state->code(0)] == "MA");
+
+  const loansim::ColdColumn* fico = store.cold("fico");
+  LOANSIM_CHECK(fico != nullptr && fico->kind() == Kind::number);
+  LOANSIM_CHECK(fico->number(0) == 720.0 && !fico->missing(0));
+  LOANSIM_CHECK(fico->missing(1) && std::isnan(fico->number(1)));
+  return loansim::test::finish();
+}
@@ -0,0 +1,58 @@
+// Scenario grids: a pool with no principal runs and reports zero analytics,
+// and zero-principal loans leave a priced pool's results unchanged.
+
+#include "results.hpp"
+
+#include <vector>
+
+#include "loansim/scenario_grid.hpp"
+
+namespace {
+
+bool zero(const loansim::CashFlowAnalytics& a) {
+  return a.yield == 0.0 && a.macaulay_duration == 0.0 && a.modified_duration == 0.0 &&
+         a.convexity == 0.0 && a.wal == 0.0;
+}
+
+bool same_analytics(const loansim::CashFlowAnalytics& a, const loansim::CashFlowAnalytics& b) {
+  return a.yield == b.yield && a.macaulay_duration == b.macaulay_duration &&
+         a.modified_duration == b.modified_duration && a.convexity == b.convexity &&
+         a.wal == b.wal;
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<double> shocks = {-0.01, 0.0, 0.01};
+  const std::vector<double> speeds = {0.5, 1.0};
+  const std::vector<loansim::Scenario> grid =
+      loansim::make_scenario_grid(shocks, speeds, 0.01, 0.35);
+  loansim::ScenarioGridConfig config;
+  config.loan_analytics = true;
+
+  loansim::LoanPool empty;
+  empty.push_back(0.0, 0.05, 360);
+  empty.push_back(0.0, 0.0, 120);
+  const loansim::PreparedPool none(empty.columns());
+  for (const loansim::ScenarioResult& r : none.run(grid, config)) {
+    LOANSIM_CHECK(r.present_value == 0.0);
+    LOANSIM_CHECK(zero(r.analytics));
+    LOANSIM_CHECK(r.loan_analytics.yield[0] == 0.0 && r.loan_analytics.wal[1] == 0.0);
+  }
+
+  loansim::LoanPool priced;
+  priced.push_back(250'000.0, 0.06, 360);
+  priced.push_back(120'000.0, 0.045, 180);
+  loansim::LoanPool mixed = priced;
+  mixed.push_back(0.0, 0.05, 240);
+  const std::vector<loansim::ScenarioResult> a =
+      loansim::PreparedPool(priced.columns()).run(grid, config);
+  const std::vector<loansim::ScenarioResult> b =
+      loansim::PreparedPool(mixed.columns()).run(grid, config);
+  for (std::size_t s = 0; s < grid.size(); ++s) {
+    LOANSIM_CHECK(a[s].analytics.yield > 0.0);
+    LOANSIM_CHECK(same_analytics(a[s].analytics, b[s].analytics));
+    LOANSIM_CHECK(b[s].loan_analytics.yield[2] == 0.0);
+  }
+  return loansim::test::finish();
+}
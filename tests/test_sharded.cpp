@@ -0,0 +1,93 @@
+// Sharded and merged runs: one part reproduces simulate_pool() and
+// aggregate_pool() bit for bit, and several parts agree with them up to
+// loan summation order, deterministically.
+
+#include "results.hpp"
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "loansim/monte_carlo.hpp"
+#include "loansim/shard.hpp"
+#include "loansim/synthetic.hpp"
+
+using loansim::test::near;
+using loansim::test::near_flows;
+using loansim::test::same_flows;
+using loansim::test::same_result;
+
+namespace {
+
+constexpr double kOrderTolerance = 1e-12;
+
+std::vector<loansim::ShardResult> run_shards(const std::vector<loansim::LoanPool>& pools,
+                                             const loansim::MonteCarloConfig& config) {
+  std::vector<loansim::ShardResult> shards;
+  for (const loansim::LoanPool& pool : pools) {
+    shards.push_back(loansim::run_shard(pool.columns(), config));
+  }
+  return shards;
+}
+
+}  // namespace
+
+int main() {
+  const loansim::LoanPool pool = loansim::make_synthetic_pool(600, 5);
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+  loansim::MonteCarloConfig config;
+  config.paths = 256;
+  config.seed = 9;
+  config.antithetic = true;
+  config.control_variate = true;
+  config.threads = 1;
+  const loansim::MonteCarloResult whole = loansim::simulate_pool(pool.columns(), config);
+  const loansim::PoolCashFlows flows = loansim::aggregate_pool(pool.columns(), assumptions);
+
+  // One part: merge_partials() and merge_shards() give the single-run bits.
+  for (const unsigned threads : {1u, 4u}) {
+    config.threads = threads;
+    const loansim::MonteCarloPartial part = loansim::simulate_partial(pool.columns(), config);
+    LOANSIM_CHECK(same_result(loansim::merge_partials({&part, 1}, config), whole));
+    const loansim::ShardResult shard = loansim::run_shard(pool.columns(), config);
+    const loansim::MergedResult merged = loansim::merge_shards({&shard, 1}, assumptions, config);
+    LOANSIM_CHECK(same_result(merged.monte_carlo, whole));
+    LOANSIM_CHECK(same_flows(merged.cash_flows, flows));
+  }
+
+  const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / ("loansim_shard_" + std::to_string(::getpid()));
+  std::filesystem::create_directories(dir);
+  for (const loansim::ShardKey key : {loansim::ShardKey::range, loansim::ShardKey::hash}) {
+    const std::vector<loansim::LoanPool> pools = loansim::partition_pool(pool.columns(), 4, key);
+    config.threads = 1;
+    const std::vector<loansim::ShardResult> shards = run_shards(pools, config);
+    const loansim::MergedResult merged = loansim::merge_shards(shards, assumptions, config);
+    LOANSIM_CHECK(merged.loans == pool.size());
+
+    // Several parts: the same bits at any thread count and through the
+    // shard files, and the single run's values up to summation order.
+    config.threads = 4;
+    std::vector<loansim::ShardResult> reread;
+    for (const loansim::ShardResult& shard : run_shards(pools, config)) {
+      const std::string path = (dir / ("shard-" + std::to_string(reread.size()))).string();
+      loansim::write_shard_result(shard, path);
+      reread.push_back(loansim::read_shard_result(path));
+    }
+    const loansim::MergedResult again = loansim::merge_shards(reread, assumptions, config);
+    LOANSIM_CHECK(same_result(again.monte_carlo, merged.monte_carlo));
+    LOANSIM_CHECK(same_flows(again.cash_flows, merged.cash_flows));
+
+    LOANSIM_CHECK(near_flows(merged.cash_flows, flows, kOrderTolerance));
+    LOANSIM_CHECK(near_flows(merged.monte_carlo.mean, whole.mean, kOrderTolerance));
+    LOANSIM_CHECK(near(merged.monte_carlo.present_value.mean, whole.present_value.mean,
+                       kOrderTolerance));
+    LOANSIM_CHECK(near(merged.monte_carlo.total_loss_estimate.mean, whole.total_loss_estimate.mean,
+                       kOrderTolerance));
+  }
+
+  std::filesystem::remove_all(dir);
+  return loansim::test::finish();
+}
@@ -0,0 +1,67 @@
+// Term kernels: totals are bit-identical with the kernels on and off and
+// at any thread count, for level, dated and mixed-product books.
+
+#include "results.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/products.hpp"
+#include "loansim/schedule.hpp"
+#include "loansim/synthetic.hpp"
+
+using loansim::test::same_flows;
+using loansim::test::same_totals;
+
+int main() {
+  // A seasoned, interleaved pool, plus a run of 360-month loans so whole
+  // blocks take the compile-time kernel.
+  loansim::LoanPool pool = loansim::make_synthetic_pool(50'000, 23);
+  for (std::size_t i = 0; i < 3'000; ++i) pool.push_back(200'000.0 + i, 0.05, 360);
+  const loansim::LoanColumns loans = pool.columns();
+
+  loansim::AccrualTables tables(loansim::max_term(loans));
+  std::vector<std::uint32_t> table(loans.size());
+  for (std::size_t i = 0; i < table.size(); ++i) {
+    const auto day = static_cast<unsigned>(1 + i % 28);
+    const loansim::Date origination{std::chrono::year{2024} / 3 / std::chrono::day{day}};
+    table[i] = tables.intern(origination, {loansim::DayCount::actual_360,
+                                           loansim::BusinessDayRule::modified_following});
+  }
+  const loansim::LoanAccrual accrual{&tables, table};
+
+  loansim::ProductBook book;
+  for (std::size_t i = 0; i < loans.size(); ++i) {
+    switch (i % 3) {
+      case 0: book.add_fixed(loans.principal[i], loans.annual_rate[i], loans.term_months[i]); break;
+      case 1:
+        book.add_interest_only(loans.principal[i], loans.annual_rate[i], loans.term_months[i],
+                               loans.term_months[i] / 4);
+        break;
+      default:
+        book.add_arm(loans.principal[i], loans.annual_rate[i], loans.term_months[i], {});
+        break;
+    }
+  }
+  const std::vector<double> index_path(360, 0.03);
+  const loansim::CashFlowAssumptions assumptions{0.08, 0.01, 0.35};
+
+  loansim::set_term_kernels(true);
+  const loansim::ScheduledTotals plain = loansim::scheduled_totals(loans, 1);
+  const loansim::ScheduledTotals dated = loansim::scheduled_totals(loans, accrual, 1);
+  const loansim::PoolCashFlows mixed = loansim::aggregate_book(book, assumptions, index_path, 1);
+  for (const bool kernels : {true, false}) {
+    loansim::set_term_kernels(kernels);
+    for (const unsigned threads : {1u, 4u}) {
+      LOANSIM_CHECK(same_totals(loansim::scheduled_totals(loans, threads), plain));
+      LOANSIM_CHECK(same_totals(loansim::scheduled_totals(loans, accrual, threads), dated));
+      LOANSIM_CHECK(
+          same_flows(loansim::aggregate_book(book, assumptions, index_path, threads), mixed));
+    }
+  }
+  loansim::set_term_kernels(true);
+  return loansim::test::finish();
+}
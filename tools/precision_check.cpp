@@ -0,0 +1,138 @@
+// Accuracy harness for reduced-precision Monte Carlo paths.
+//
+// Runs simulate_pool() in float64 and float32 on the same seeds and checks
+// that mean present value, mean loss and every period's mean cash flows
+// agree to within kFloat32Tolerance. Exits 1 if any seed exceeds it.
+//
+//   precision_check [--loans N] [--paths N] [--seeds N] [--tape file]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "loansim/loan_tape.hpp"
+#include "loansim/monte_carlo.hpp"
+#include "loansim/synthetic.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::size_t loans = 5'000;
+  std::size_t paths = 256;
+  std::size_t seeds = 3;
+  std::string tape;
+};
+
+Options parse(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i += 2) {
+    const std::string_view flag = argv[i];
+    if (i + 1 >= argc) throw std::invalid_argument("missing value for " + std::string(flag));
+    const std::string value = argv[i + 1];
+    if (flag == "--loans") {
+      o.loans = std::stoull(value);
+    } else if (flag == "--paths") {
+      o.paths = std::stoull(value);
+    } else if (flag == "--seeds") {
+      o.seeds = std::stoull(value);
+    } else if (flag == "--tape") {
+      o.tape = value;
+    } else {
+      throw std::invalid_argument("unknown flag " + std::string(flag));
+    }
+  }
+  return o;
+}
+
+double relative(double a, double b) {
+  const double scale = std::max(std::abs(a), std::abs(b));
+  return scale == 0.0 ? 0.0 : std::abs(a - b) / scale;
+}
+
+/// Largest relative difference over the periods of one series, skipping
+/// periods below 1e-6 of the series' largest flow.
+double worst_period(const std::pmr::vector<double>& a, const std::pmr::vector<double>& b) {
+  double peak = 0.0;
+  for (const double x : a) peak = std::max(peak, std::abs(x));
+  double worst = 0.0;
+  for (std::size_t t = 0; t < a.size(); ++t) {
+    if (std::abs(a[t]) < 1e-6 * peak) continue;
+    worst = std::max(worst, relative(a[t], b[t]));
+  }
+  return worst;
+}
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int run(const Options& o) {
+  loansim::LoanPool pool;
+  loansim::LoanTape tape;
+  loansim::LoanColumns loans;
+  if (o.tape.empty()) {
+    pool = loansim::make_synthetic_pool(o.loans, 7);
+    loans = pool.columns();
+  } else {
+    tape = loansim::LoanTape::open(o.tape);
+    loans = tape.columns();
+  }
+
+  std::printf("loans %zu, paths %zu, tolerance %.1e\n", loans.size(), o.paths,
+              loansim::kFloat32Tolerance);
+  std::printf("%6s %12s %12s %12s %10s %10s\n", "seed", "pv", "loss", "flows", "f64 s",
+              "f32 s");
+  double worst = 0.0;
+  for (std::uint64_t seed = 1; seed <= o.seeds; ++seed) {
+    loansim::MonteCarloConfig config;
+    config.paths = o.paths;
+    config.seed = seed;
+
+    auto start = Clock::now();
+    const loansim::MonteCarloResult wide = loansim::simulate_pool(loans, config);
+    const double wide_s = seconds_since(start);
+    config.precision = loansim::Precision::float32;
+    start = Clock::now();
+    const loansim::MonteCarloResult narrow = loansim::simulate_pool(loans, config);
+    const double narrow_s = seconds_since(start);
+
+    const double pv = relative(wide.present_value.mean, narrow.present_value.mean);
+    const double loss = relative(wide.total_loss.mean, narrow.total_loss.mean);
+    double flows = 0.0;
+    const auto& a = wide.mean;
+    const auto& b = narrow.mean;
+    for (const auto member : {&loansim::PoolCashFlows::interest,
+                              &loansim::PoolCashFlows::scheduled_principal,
+                              &loansim::PoolCashFlows::prepayment,
+                              &loansim::PoolCashFlows::defaults, &loansim::PoolCashFlows::loss,
+                              &loansim::PoolCashFlows::balance}) {
+      flows = std::max(flows, worst_period(a.*member, b.*member));
+    }
+    std::printf("%6llu %12.3e %12.3e %12.3e %10.3f %10.3f\n",
+                static_cast<unsigned long long>(seed), pv, loss, flows, wide_s, narrow_s);
+    worst = std::max({worst, pv, loss, flows});
+  }
+
+  const bool ok = worst <= loansim::kFloat32Tolerance;
+  std::printf("worst %.3e: %s\n", worst, ok ? "ok" : "EXCEEDS TOLERANCE");
+  return ok ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    return run(parse(argc, argv));
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "precision_check: %s\n", e.what());
+    return 2;
+  }
+}
@@ -0,0 +1,481 @@
+// Differential harness: the fast engines against the extended-precision
+// reference (loansim/reference.hpp).
+//
+// Each iteration draws a random pool (size, terms, rates, zero-rate loans,
+// one-term pools that take the term kernels) and random speeds, then checks
+// to the cent:
+//
+//   payments   level_payments() on every SIMD tier this CPU runs
+//   balances   remaining_balances() at random ages
+//   schedules  build_schedules() loan by loan
+//   aggregate  aggregate_pool() on 1 and 4 threads, term kernels on and off
+//   dated      the schedules and aggregate_pool() with random accrual tables
+//   mc         simulate_pool() mean flows and totals, and simulate_partial()
+//              path by path, on random model settings (antithetic, rate paths)
+//   sharded    merge_partials() and merge_shards() over range and hash parts
+//   mc f32     simulate_pool() in float32, relative to the reference
+//
+// The Monte Carlo checks run on the first kMonteCarloLoans loans: each
+// path's economy is fixed by the seed, so reference_path() replays it and
+// the float64 run must match to the cent too. Exits 1 if any value differs
+// from the reference by a cent or more, or float32 by more than
+// kFloat32Tolerance, and prints the seed and iteration that reproduce it.
+//
+//   reference_check [--iterations N] [--loans N] [--seed N]
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "loansim/aggregate.hpp"
+#include "loansim/calendar.hpp"
+#include "loansim/payment_kernel.hpp"
+#include "loansim/reference.hpp"
+#include "loansim/monte_carlo.hpp"
+#include "loansim/rng.hpp"
+#include "loansim/schedule.hpp"
+#include "loansim/shard.hpp"
+
+namespace {
+
+constexpr double kCent = 0.01;
+// Loans per iteration whose schedules are compared one by one.
+constexpr std::size_t kScheduleSample = 64;
+// Loans and paths per iteration of the Monte Carlo checks.
+constexpr std::size_t kMonteCarloLoans = 256;
+constexpr std::size_t kMonteCarloPaths = 130;
+
+struct Options {
+  std::size_t iterations = 40;
+  std::size_t loans = 5'000;
+  std::uint64_t seed = 1;
+};
+
+Options parse(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i += 2) {
+    const std::string_view flag = argv[i];
+    if (i + 1 >= argc) throw std::invalid_argument("missing value for " + std::string(flag));
+    const std::string value = argv[i + 1];
+    if (flag == "--iterations") {
+      o.iterations = std::stoull(value);
+    } else if (flag == "--loans") {
+      o.loans = std::stoull(value);
+    } else if (flag == "--seed") {
+      o.seed = std::stoull(value);
+    } else {
+      throw std::invalid_argument("unknown flag " + std::string(flag));
+    }
+  }
+  if (o.loans == 0) throw std::invalid_argument("--loans must be positive");
+  return o;
+}
+
+/// Uniform draws for one iteration, addressed by (stream, index).
+class Draws {
+ public:
+  Draws(std::uint64_t seed, std::uint64_t iteration) : gen_(seed), iteration_(iteration) {}
+
+  [[nodiscard]] std::array<std::uint32_t, 4> words(std::uint32_t stream, std::size_t i) const {
+    return gen_({static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(i >> 32),
+                 static_cast<std::uint32_t>(iteration_), stream});
+  }
+  [[nodiscard]] double unit(std::uint32_t stream, std::size_t i) const {
+    const auto w = words(stream, i);
+    return loansim::to_unit_interval(w[0], w[1]);
+  }
+
+ private:
+  loansim::Philox4x32 gen_;
+  std::uint64_t iteration_;
+};
+
+enum Shape { kMixed, kTerm180, kTerm360, kSeasoned, kShapes };
+constexpr std::array<const char*, kShapes> kShapeNames = {"mixed", "180", "360", "seasoned"};
+
+/// A random pool: balances of $1K-$2M in cents, rates of 0-15% (one loan in
+/// ten at zero), and terms by `shape`.
+loansim::LoanPool random_pool(const Draws& d, std::size_t max_loans, Shape shape) {
+  static constexpr std::array<std::int32_t, 4> kOriginal = {360, 180, 240, 120};
+  const std::size_t n = 1 + d.words(0, 0)[0] % max_loans;
+  loansim::LoanPool pool;
+  pool.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto w = d.words(1, i);
+    const double balance =
+        std::round((1'000.0 + 1'999'000.0 * loansim::to_unit_interval(w[0], w[1])) * 100.0) /
+        100.0;
+    const double rate = w[3] % 10 == 0 ? 0.0 : 0.15 * loansim::to_unit_interval(w[1], w[2]);
+    std::int32_t term = 0;
+    switch (shape) {
+      case kMixed: term = 1 + static_cast<std::int32_t>(w[2] % 480); break;
+      case kTerm180: term = 180; break;
+      case kTerm360: term = 360; break;
+      default:
+        term = kOriginal[(w[3] >> 4) % kOriginal.size()] -
+               static_cast<std::int32_t>((w[3] >> 8) % 61);
+        break;
+    }
+    pool.push_back(balance, rate, term);
+  }
+  return pool;
+}
+
+/// Every Jan 1, Jul 4 and Dec 25 from 1995 to 2075.
+loansim::BusinessCalendar holidays() {
+  std::vector<loansim::Date> days;
+  for (int y = 1995; y <= 2075; ++y) {
+    const std::chrono::year year{y};
+    days.emplace_back(year / 1 / 1);
+    days.emplace_back(year / 7 / 4);
+    days.emplace_back(year / 12 / 25);
+  }
+  return loansim::BusinessCalendar(std::move(days));
+}
+
+/// Largest |fast - reference| over a series.
+template <class Fast>
+double worst(const Fast& fast, const std::vector<long double>& ref) {
+  double w = 0.0;
+  for (std::size_t t = 0; t < ref.size(); ++t) {
+    w = std::max(w, static_cast<double>(std::abs(static_cast<long double>(fast[t]) - ref[t])));
+  }
+  return w;
+}
+
+double worst_flows(const loansim::PoolCashFlows& fast, const loansim::ReferenceFlows& ref) {
+  if (fast.periods() != ref.periods()) return INFINITY;
+  return std::max({worst(fast.interest, ref.interest),
+                   worst(fast.scheduled_principal, ref.scheduled_principal),
+                   worst(fast.prepayment, ref.prepayment), worst(fast.defaults, ref.defaults),
+                   worst(fast.loss, ref.loss), worst(fast.balance, ref.balance)});
+}
+
+/// Loan i's row of every schedule field against its reference schedule.
+double worst_schedule(const loansim::ScheduleBuffers& fast, std::size_t i,
+                      const loansim::ReferenceSchedule& ref) {
+  double w = 0.0;
+  for (std::size_t t = 0; t < fast.periods(); ++t) {
+    const bool live = t < ref.periods();
+    const auto diff = [&](double x, const std::vector<long double>& r) {
+      return static_cast<double>(std::abs(x - (live ? r[t] : 0.0L)));
+    };
+    w = std::max({w, diff(fast.payment(t)[i], ref.payment),
+                  diff(fast.interest(t)[i], ref.interest),
+                  diff(fast.principal(t)[i], ref.principal),
+                  diff(fast.balance(t)[i], ref.balance)});
+  }
+  return w;
+}
+
+/// Random model settings: speeds, volatilities, persistence, severity and
+/// discounting, antithetic pairs on one run in two and a Hull-White rate
+/// path on one in three.
+loansim::MonteCarloConfig random_config(const Draws& d) {
+  const auto w = d.words(5, 0);
+  loansim::MonteCarloConfig config;
+  config.paths = kMonteCarloPaths;
+  config.seed = w[0];
+  config.antithetic = w[1] % 2 == 0;
+  config.control_variate = w[2] % 2 == 0;
+  config.threads = 4;
+  config.base_cpr = 0.01 + 0.3 * d.unit(6, 0);
+  config.refi_sensitivity = 50.0 * d.unit(6, 1);
+  config.market_rate = 0.1 * d.unit(6, 2);
+  config.cpr_volatility = d.unit(6, 3);
+  config.base_cdr = 0.1 * d.unit(6, 4);
+  config.cdr_volatility = d.unit(6, 5);
+  config.factor_persistence = 0.99 * d.unit(6, 6);
+  config.severity = d.unit(6, 7);
+  config.discount_rate = 0.1 * d.unit(6, 8);
+  if (w[3] % 3 == 0) {
+    config.rates.kind = loansim::RateModel::hull_white;
+    config.rates.initial = config.market_rate;
+    config.rates.volatility = 0.02 * d.unit(6, 9);
+  }
+  return config;
+}
+
+/// Every path of `config` replayed by reference_path().
+struct ReferenceRun {
+  loansim::ReferenceFlows mean;  ///< Averaged over paths.
+  long double present_value = 0.0L;
+  long double total_loss = 0.0L;
+  std::vector<long double> path_pv;  ///< Indexed by path.
+  std::vector<long double> path_loss;
+};
+
+ReferenceRun replay(const loansim::LoanColumns& loans, const loansim::MonteCarloConfig& config) {
+  static constexpr std::array kSeries = {
+      &loansim::ReferenceFlows::interest,   &loansim::ReferenceFlows::scheduled_principal,
+      &loansim::ReferenceFlows::prepayment, &loansim::ReferenceFlows::defaults,
+      &loansim::ReferenceFlows::loss,       &loansim::ReferenceFlows::balance};
+  ReferenceRun run;
+  for (std::size_t p = 0; p < config.paths; ++p) {
+    const loansim::ReferencePath path = loansim::reference_path(loans, config, p);
+    if (p == 0) {
+      run.mean = path.flows;
+    } else {
+      for (const auto member : kSeries) {
+        for (std::size_t t = 0; t < path.flows.periods(); ++t) {
+          (run.mean.*member)[t] += (path.flows.*member)[t];
+        }
+      }
+    }
+    run.present_value += path.present_value;
+    run.total_loss += path.total_loss;
+    run.path_pv.push_back(path.present_value);
+    run.path_loss.push_back(path.total_loss);
+  }
+  const auto paths = static_cast<long double>(config.paths);
+  for (const auto member : kSeries) {
+    for (long double& x : run.mean.*member) x /= paths;
+  }
+  run.present_value /= paths;
+  run.total_loss /= paths;
+  return run;
+}
+
+/// A Monte Carlo result's mean flows and totals against the replay, in dollars.
+double worst_run(const loansim::MonteCarloResult& fast, const ReferenceRun& ref) {
+  return std::max({worst_flows(fast.mean, ref.mean),
+                   static_cast<double>(std::abs(fast.present_value.mean - ref.present_value)),
+                   static_cast<double>(std::abs(fast.total_loss.mean - ref.total_loss))});
+}
+
+long double relative(long double fast, long double ref) {
+  const long double scale = std::max(std::abs(fast), std::abs(ref));
+  return scale == 0.0L ? 0.0L : std::abs(fast - ref) / scale;
+}
+
+/// Largest relative difference over one series, skipping periods below
+/// 1e-6 of the reference's largest flow (as tools/precision_check does).
+template <class Fast>
+double worst_relative(const Fast& fast, const std::vector<long double>& ref) {
+  long double peak = 0.0L;
+  for (const long double x : ref) peak = std::max(peak, std::abs(x));
+  long double w = 0.0L;
+  for (std::size_t t = 0; t < ref.size(); ++t) {
+    if (std::abs(ref[t]) < 1e-6L * peak) continue;
+    w = std::max(w, relative(fast[t], ref[t]));
+  }
+  return static_cast<double>(w);
+}
+
+/// worst_run() as a relative difference.
+double relative_run(const loansim::MonteCarloResult& fast, const ReferenceRun& ref) {
+  if (fast.mean.periods() != ref.mean.periods()) return INFINITY;
+  const loansim::PoolCashFlows& f = fast.mean;
+  const loansim::ReferenceFlows& r = ref.mean;
+  return std::max({worst_relative(f.interest, r.interest),
+                   worst_relative(f.scheduled_principal, r.scheduled_principal),
+                   worst_relative(f.prepayment, r.prepayment),
+                   worst_relative(f.defaults, r.defaults), worst_relative(f.loss, r.loss),
+                   worst_relative(f.balance, r.balance),
+                   static_cast<double>(relative(fast.present_value.mean, ref.present_value)),
+                   static_cast<double>(relative(fast.total_loss.mean, ref.total_loss))});
+}
+
+struct Worst {
+  double payments = 0.0;
+  double balances = 0.0;
+  double schedules = 0.0;
+  double aggregate = 0.0;
+  double dated = 0.0;
+  double monte_carlo = 0.0;
+  double sharded = 0.0;
+  double float32 = 0.0;  ///< Relative, against kFloat32Tolerance.
+
+  [[nodiscard]] double max() const {
+    return std::max({payments, balances, schedules, aggregate, dated, monte_carlo, sharded});
+  }
+  [[nodiscard]] bool ok() const {
+    return max() < kCent && float32 <= loansim::kFloat32Tolerance;
+  }
+};
+
+/// The Monte Carlo engines, their partial and sharded reductions and
+/// float32 against reference_path() on `loans`.
+void check_monte_carlo(const Draws& d, const loansim::LoanColumns& loans,
+                       const loansim::CashFlowAssumptions& assumptions, Worst& w) {
+  loansim::MonteCarloConfig config = random_config(d);
+  const ReferenceRun ref = replay(loans, config);
+
+  w.monte_carlo = worst_run(loansim::simulate_pool(loans, config), ref);
+  const loansim::MonteCarloPartial partial = loansim::simulate_partial(loans, config);
+  for (std::size_t p = 0; p < config.paths; ++p) {
+    w.monte_carlo = std::max(
+        {w.monte_carlo,
+         static_cast<double>(std::abs(partial.paths[p].present_value - ref.path_pv[p])),
+         static_cast<double>(std::abs(partial.paths[p].total_loss - ref.path_loss[p]))});
+  }
+
+  // Range parts through merge_partials(), hash shards through merge_shards().
+  const std::size_t parts = 1 + d.words(5, 1)[0] % 4;
+  std::vector<loansim::MonteCarloPartial> partials;
+  for (const loansim::LoanPool& part :
+       loansim::partition_pool(loans, parts, loansim::ShardKey::range)) {
+    partials.push_back(loansim::simulate_partial(part.columns(), config));
+  }
+  w.sharded = worst_run(loansim::merge_partials(partials, config), ref);
+  std::vector<loansim::ShardResult> shards;
+  for (const loansim::LoanPool& part :
+       loansim::partition_pool(loans, parts, loansim::ShardKey::hash)) {
+    shards.push_back(loansim::run_shard(part.columns(), config));
+  }
+  const loansim::MergedResult merged = loansim::merge_shards(shards, assumptions, config);
+  w.sharded = std::max({w.sharded, worst_run(merged.monte_carlo, ref),
+                        worst_flows(merged.cash_flows,
+                                    loansim::reference_cash_flows(loans, assumptions))});
+
+  config.precision = loansim::Precision::float32;
+  w.float32 = relative_run(loansim::simulate_pool(loans, config), ref);
+}
+
+Worst check(const Draws& d, const loansim::LoanColumns& loans, bool dated) {
+  Worst w;
+  const std::size_t n = loans.size();
+  const loansim::CashFlowAssumptions assumptions{0.3 * d.unit(2, 0), 0.1 * d.unit(2, 1),
+                                                 d.unit(2, 2)};
+
+  // Level payments, on every tier available.
+  const loansim::SimdLevel previous = loansim::simd_level();
+  std::vector<double> payment(n);
+  for (const auto level : {loansim::SimdLevel::scalar, loansim::SimdLevel::avx2,
+                           loansim::SimdLevel::avx512}) {
+    try {
+      loansim::set_simd_level(level);
+    } catch (const std::invalid_argument&) {
+      continue;
+    }
+    loansim::level_payments(loans, payment);
+    for (std::size_t i = 0; i < n; ++i) {
+      const long double ref = loansim::reference_level_payment(
+          loans.principal[i], loans.annual_rate[i], loans.term_months[i]);
+      w.payments = std::max(w.payments, static_cast<double>(std::abs(payment[i] - ref)));
+    }
+  }
+  loansim::set_simd_level(previous);
+
+  // Closed-form balances and full schedules on a sample of loans.
+  const loansim::LoanColumns sample = loans.slice(0, std::min(n, kScheduleSample));
+  std::vector<loansim::ReferenceSchedule> refs;
+  for (std::size_t i = 0; i < sample.size(); ++i) {
+    refs.push_back(loansim::reference_schedule(sample.principal[i], sample.annual_rate[i],
+                                               sample.term_months[i]));
+  }
+  std::vector<std::int32_t> elapsed(sample.size());
+  std::vector<double> balance(sample.size());
+  for (std::size_t i = 0; i < sample.size(); ++i) {
+    const auto ages = static_cast<std::uint32_t>(sample.term_months[i]) + 1;
+    elapsed[i] = static_cast<std::int32_t>(d.words(3, i)[0] % ages);
+  }
+  loansim::remaining_balances(sample, std::span<const double>(payment).first(sample.size()),
+                              elapsed, balance);
+  for (std::size_t i = 0; i < sample.size(); ++i) {
+    const auto k = static_cast<std::size_t>(elapsed[i]);
+    const long double ref = k == 0 ? static_cast<long double>(sample.principal[i])
+                                   : refs[i].balance[k - 1];
+    w.balances = std::max(w.balances, static_cast<double>(std::abs(balance[i] - ref)));
+  }
+  loansim::ScheduleBuffers schedules;
+  loansim::build_schedules(sample, schedules);
+  for (std::size_t i = 0; i < sample.size(); ++i) {
+    w.schedules = std::max(w.schedules, worst_schedule(schedules, i, refs[i]));
+  }
+
+  // Pool totals across thread counts and kernels.
+  const loansim::ReferenceFlows ref = loansim::reference_cash_flows(loans, assumptions);
+  const bool term_kernels = loansim::term_kernels();
+  for (const bool kernels : {false, true}) {
+    loansim::set_term_kernels(kernels);
+    for (const unsigned threads : {1u, 4u}) {
+      w.aggregate = std::max(
+          w.aggregate, worst_flows(loansim::aggregate_pool(loans, assumptions, threads), ref));
+    }
+  }
+  loansim::set_term_kernels(term_kernels);
+
+  check_monte_carlo(d, loans.slice(0, std::min(n, kMonteCarloLoans)), assumptions, w);
+  if (!dated) return w;
+
+  // Dated accrual: random origination days and conventions.
+  loansim::AccrualTables tables(loansim::max_term(loans), holidays());
+  std::vector<std::uint32_t> table(n);
+  const loansim::Date first = loansim::parse_date("2000-01-01");
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto u = d.words(4, i);
+    const loansim::AccrualConvention convention{static_cast<loansim::DayCount>(u[1] % 4),
+                                                static_cast<loansim::BusinessDayRule>(u[2] % 4)};
+    table[i] = tables.intern(first + std::chrono::days{u[0] % 7'300}, convention);
+  }
+  const loansim::LoanAccrual accrual{&tables, table};
+  const loansim::LoanAccrual sample_accrual = accrual.slice(0, sample.size());
+  loansim::build_schedules(sample, sample_accrual, schedules);
+  for (std::size_t i = 0; i < sample.size(); ++i) {
+    const loansim::ReferenceSchedule r =
+        loansim::reference_schedule(sample.principal[i], sample.annual_rate[i],
+                                    sample.term_months[i], tables.accrual(table[i]));
+    w.dated = std::max(w.dated, worst_schedule(schedules, i, r));
+  }
+  const loansim::ReferenceFlows dated_ref =
+      loansim::reference_cash_flows(loans, accrual, assumptions);
+  w.dated = std::max(w.dated,
+                     worst_flows(loansim::aggregate_pool(loans, accrual, assumptions), dated_ref));
+  return w;
+}
+
+int run(const Options& o) {
+  std::printf("iterations %zu, up to %zu loans, seed %llu, tolerance $%.2f\n", o.iterations,
+              o.loans, static_cast<unsigned long long>(o.seed), kCent);
+  std::printf("%5s %8s %9s %10s %10s %10s %10s %10s %10s %10s %10s\n", "iter", "loans",
+              "shape", "payments", "balances", "schedules", "aggregate", "mc", "sharded",
+              "mc f32", "dated");
+  double worst = 0.0;
+  double worst_float32 = 0.0;
+  std::size_t failed = 0;
+  for (std::size_t it = 0; it < o.iterations; ++it) {
+    const Draws d(o.seed, it);
+    const auto shape = static_cast<Shape>(it % kShapes);
+    const bool dated = it % 2 == 1;
+    const loansim::LoanPool pool = random_pool(d, o.loans, shape);
+    const Worst w = check(d, pool.columns(), dated);
+    std::printf("%5zu %8zu %9s %10.2e %10.2e %10.2e %10.2e %10.2e %10.2e %10.2e", it,
+                pool.size(), kShapeNames[shape], w.payments, w.balances, w.schedules,
+                w.aggregate, w.monte_carlo, w.sharded, w.float32);
+    if (dated) {
+      std::printf(" %10.2e\n", w.dated);
+    } else {
+      std::printf(" %10s\n", "-");
+    }
+    if (!w.ok()) {
+      ++failed;
+      std::printf("  FAILED: reproduce with --seed %llu (iteration %zu)\n",
+                  static_cast<unsigned long long>(o.seed), it);
+    }
+    worst = std::max(worst, w.max());
+    worst_float32 = std::max(worst_float32, w.float32);
+  }
+  std::printf("worst $%.3e, float32 %.3e: %s\n", worst, worst_float32,
+              failed == 0 ? "ok" : "EXCEEDS TOLERANCE");
+  return failed == 0 ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    return run(parse(argc, argv));
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "reference_check: %s\n", e.what());
+    return 2;
+  }
+}